@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Restart the estimator repeatedly while a bag plays, report time to first pose.
+
+vins_node is started on the given config and the bag is played. After a warmup,
+std_msgs/Bool true is published on /vins_restart every --period seconds. For every
+restart the estimator logs "[Init] first pose <ms>ms after restart" once it is
+initialized again, measured from clearState. Restarts that get no pose before the
+next one are counted as failed.
+
+Needs a running roscore.
+
+Example:
+    rosrun vins restart_benchmark.py --config config/fisheye_ptgrey_n3/fisheye_cpu.yaml \\
+        --bag seq.bag --period 8 --warmup 15
+"""
+
+import argparse
+import re
+import signal
+import subprocess
+import sys
+import threading
+import time
+
+import rospy
+from std_msgs.msg import Bool
+
+FIRST_POSE = re.compile(r"\[Init\] first pose ([0-9.]+)ms after restart")
+
+
+def percentile(values, p):
+    values = sorted(values)
+    rank = max(0, min(len(values) - 1, int(round(p * (len(values) - 1)))))
+    return values[rank]
+
+
+def read_first_poses(stream, poses, log):
+    #(wall time, ms) of every first pose line
+    for line in iter(stream.readline, ""):
+        if log is not None:
+            log.write(line)
+        m = FIRST_POSE.search(line)
+        if m:
+            poses.append((time.time(), float(m.group(1))))
+
+
+def match_restarts(restarts, poses):
+    #First pose after each restart and before the next one
+    samples, failed = [], 0
+    for i, t in enumerate(restarts):
+        t_next = restarts[i + 1] if i + 1 < len(restarts) else float("inf")
+        ms = [p[1] for p in poses if t <= p[0] < t_next]
+        if ms:
+            samples.append(ms[0])
+        else:
+            failed += 1
+    return samples, failed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--config", required=True)
+    parser.add_argument("--bag", required=True)
+    parser.add_argument("--rate", type=float, default=1.0, help="rosbag play rate")
+    parser.add_argument("--period", type=float, default=8.0, help="seconds between restarts")
+    parser.add_argument("--warmup", type=float, default=15.0, help="seconds before the first restart")
+    parser.add_argument("--startup", type=float, default=3.0, help="seconds to wait for vins_node")
+    parser.add_argument("--log", default=None, help="write the vins_node output here")
+    args = parser.parse_args()
+
+    rospy.init_node("restart_benchmark", anonymous=True, disable_signals=True)
+    pub = rospy.Publisher("/vins_restart", Bool, queue_size=10)
+
+    log = open(args.log, "w") if args.log else None
+    node = subprocess.Popen(["rosrun", "vins", "vins_node", "_config_file:=%s" % args.config],
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    poses = []
+    reader = threading.Thread(target=read_first_poses, args=(node.stdout, poses, log))
+    reader.daemon = True
+    reader.start()
+
+    restarts = []
+    try:
+        time.sleep(args.startup)
+        bag = subprocess.Popen(["rosbag", "play", "-q", "-r", str(args.rate), args.bag],
+                               stdout=subprocess.DEVNULL)
+        next_restart = time.time() + args.warmup
+        while bag.poll() is None:
+            if time.time() >= next_restart:
+                restarts.append(time.time())
+                pub.publish(Bool(data=True))
+                next_restart += args.period
+            time.sleep(0.05)
+        time.sleep(2.0)
+    finally:
+        node.send_signal(signal.SIGINT)
+        try:
+            node.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            node.kill()
+        reader.join(timeout=2)
+        if log is not None:
+            log.close()
+
+    #The last restart may have been cut short by the end of the bag
+    samples, failed = match_restarts(restarts, poses)
+    print("restarts %d, first pose %d, no pose before next restart %d" % (len(restarts), len(samples), failed))
+    if samples:
+        print("time to first pose ms: mean %.1f p50 %.1f p90 %.1f p99 %.1f min %.1f max %.1f" % (
+            sum(samples) / len(samples), percentile(samples, 0.5), percentile(samples, 0.9),
+            percentile(samples, 0.99), min(samples), max(samples)))
+    return 0 if samples else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
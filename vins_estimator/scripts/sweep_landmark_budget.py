@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""Sweep landmark_budget on one config and bag, report ATE and solve time.
+
+For every budget the config folder is copied, landmark_budget and output_path are
+rewritten, vins_node is started on the copy and the bag is played once. ATE is the
+RMSE of vio.csv positions against the ground truth after a rigid (SE3) alignment,
+solve time is read from the "solve" rows of perf.csv.
+
+Needs a running roscore and a build with perf stats (ENABLE_PERF_STATS) and
+enable_perf_output: 1 in the config.
+
+Example:
+    rosrun vins sweep_landmark_budget.py --config config/fisheye_ptgrey_n3/fisheye_cpu.yaml \\
+        --bag seq.bag --gt seq_gt.csv --budgets 0 150 300 600
+"""
+
+import argparse
+import csv
+import os
+import re
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+
+def write_config(src_config, dst_dir, budget):
+    #Calibration files are given relative to the config, so copy the whole folder
+    shutil.copytree(os.path.dirname(os.path.abspath(src_config)), dst_dir)
+    config = os.path.join(dst_dir, os.path.basename(src_config))
+    out_dir = os.path.join(dst_dir, "output")
+    os.makedirs(out_dir)
+    with open(config) as f:
+        text = f.read()
+    for key, value in (("landmark_budget", str(budget)), ("output_path", '"%s"' % out_dir)):
+        text, n = re.subn(r"^%s:.*$" % key, "%s: %s" % (key, value), text, flags=re.M)
+        if n == 0:
+            text += "\n%s: %s\n" % (key, value)
+    with open(config, "w") as f:
+        f.write(text)
+    return config, out_dir
+
+
+def read_stamped_positions(path):
+    #vio.csv and EuRoC style ground truth: stamp,x,y,z,... with stamp in ns or s
+    stamps, positions = [], []
+    with open(path) as f:
+        for row in csv.reader(f):
+            try:
+                values = [float(v) for v in row[:4]]
+            except (ValueError, IndexError):
+                continue
+            stamps.append(values[0])
+            positions.append(values[1:4])
+    stamps = np.array(stamps)
+    if len(stamps) > 0 and stamps.max() > 1e12:
+        stamps = stamps * 1e-9
+    return stamps, np.array(positions)
+
+
+def associate(t_est, t_gt, max_dt):
+    idx = np.clip(np.searchsorted(t_gt, t_est), 1, len(t_gt) - 1)
+    left_closer = np.abs(t_est - t_gt[idx - 1]) < np.abs(t_est - t_gt[idx])
+    idx = idx - left_closer
+    ok = np.abs(t_est - t_gt[idx]) < max_dt
+    return np.nonzero(ok)[0], idx[ok]
+
+
+def align_rigid(est, gt):
+    #Umeyama without scale: R, t minimizing |gt - (R est + t)|
+    mu_e, mu_g = est.mean(0), gt.mean(0)
+    U, _, Vt = np.linalg.svd((gt - mu_g).T @ (est - mu_e))
+    S = np.eye(3)
+    S[2, 2] = np.sign(np.linalg.det(U @ Vt))
+    R = U @ S @ Vt
+    return R, mu_g - R @ mu_e
+
+
+def ate_rmse(est_path, gt_path, max_dt=0.02):
+    t_est, p_est = read_stamped_positions(est_path)
+    t_gt, p_gt = read_stamped_positions(gt_path)
+    if len(t_est) < 3 or len(t_gt) < 2:
+        return float("nan"), 0
+    i_est, i_gt = associate(t_est, t_gt, max_dt)
+    if len(i_est) < 3:
+        return float("nan"), len(i_est)
+    est, gt = p_est[i_est], p_gt[i_gt]
+    R, t = align_rigid(est, gt)
+    err = gt - (est @ R.T + t)
+    return float(np.sqrt((err ** 2).sum(1).mean())), len(i_est)
+
+
+def solve_stats(perf_path):
+    #Rows are per report period: t,stage,count,mean,p50,p95,p99,max
+    count, total, p95, worst = 0, 0.0, [], 0.0
+    if not os.path.exists(perf_path):
+        return float("nan"), float("nan"), float("nan"), 0
+    with open(perf_path) as f:
+        for row in csv.DictReader(f):
+            if row["stage"] != "solve":
+                continue
+            n = int(row["count"])
+            count += n
+            total += n * float(row["mean"])
+            p95.append((float(row["p95"]), n))
+            worst = max(worst, float(row["max"]))
+    if count == 0:
+        return float("nan"), float("nan"), float("nan"), 0
+    p95_weighted = sum(v * n for v, n in p95) / count
+    return total / count, p95_weighted, worst, count
+
+
+def run_once(args, budget, work_dir):
+    config, out_dir = write_config(args.config, os.path.join(work_dir, "budget_%d" % budget), budget)
+    log = open(os.path.join(out_dir, "vins_node.log"), "w")
+    node = subprocess.Popen(["rosrun", "vins", "vins_node", "_config_file:=%s" % config],
+                            stdout=log, stderr=subprocess.STDOUT)
+    try:
+        time.sleep(args.startup)
+        subprocess.check_call(["rosbag", "play", "-q", "-r", str(args.rate), args.bag],
+                              stdout=subprocess.DEVNULL)
+        time.sleep(args.drain)
+    finally:
+        node.send_signal(signal.SIGINT)
+        try:
+            node.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            node.kill()
+        log.close()
+    ate, matched = ate_rmse(os.path.join(out_dir, "vio.csv"), args.gt)
+    mean, p95, worst, solves = solve_stats(os.path.join(out_dir, "perf.csv"))
+    return ate, matched, mean, p95, worst, solves
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--config", required=True, help="estimator yaml, its folder is copied per run")
+    parser.add_argument("--bag", required=True)
+    parser.add_argument("--gt", required=True, help="ground truth csv: stamp,x,y,z,... stamp in s or ns")
+    parser.add_argument("--budgets", type=int, nargs="+", default=[0, 150, 300, 600])
+    parser.add_argument("--rate", type=float, default=1.0, help="rosbag play rate")
+    parser.add_argument("--startup", type=float, default=3.0, help="seconds to wait for vins_node")
+    parser.add_argument("--drain", type=float, default=3.0, help="seconds to wait after the bag ends")
+    parser.add_argument("--work-dir", default=None, help="keep per run configs and outputs here")
+    parser.add_argument("--csv", default=None, help="also write the table to this file")
+    args = parser.parse_args()
+
+    work_dir = args.work_dir or tempfile.mkdtemp(prefix="landmark_budget_")
+    rows = []
+    for budget in args.budgets:
+        print("landmark_budget %d ..." % budget, file=sys.stderr)
+        rows.append((budget,) + run_once(args, budget, work_dir))
+
+    header = ("budget", "ate_rmse_m", "matched", "solve_mean_ms", "solve_p95_ms", "solve_max_ms", "solves")
+    print("%8s %11s %8s %14s %13s %13s %7s" % header)
+    for r in rows:
+        print("%8d %11.4f %8d %14.2f %13.2f %13.2f %7d" % r)
+    if args.csv:
+        with open(args.csv, "w") as f:
+            w = csv.writer(f)
+            w.writerow(header)
+            w.writerows(rows)
+    print("outputs in %s" % work_dir, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
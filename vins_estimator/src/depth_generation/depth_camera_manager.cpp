@@ -3,6 +3,7 @@
 #include <geometry_msgs/PoseStamped.h>
 #include "../utility/tic_toc.h"
 #include "../featureTracker/fisheye_undist.hpp"
+#include <sensor_msgs/image_encodings.h>
 
 using namespace Eigen;
 
@@ -24,7 +25,10 @@ DepthCamManager::DepthCamManager(ros::NodeHandle & _nh, FisheyeUndist * _fisheye
     pub_depthcam_poses.push_back(nh.advertise<geometry_msgs::PoseStamped>("pose_rear", 1));
 
 
-    pcl2depth_map.resize(4);
+    depthmap_index.resize(4);
+    depthmap_msgs.resize(4);
+    depthmap_rois.resize(4);
+    depthmap_steps.resize(4, 1);
 
     pub_camera_up = nh.advertise<sensor_msgs::Image>("/front_stereo/left/image_raw", 1);
     pub_camera_down = nh.advertise<sensor_msgs::Image>("/front_stereo/right/image_raw", 1);
@@ -84,6 +88,18 @@ DepthCamManager::DepthCamManager(ros::NodeHandle & _nh, FisheyeUndist * _fisheye
         depth_cloud_radius = fsSettings["depth_cloud_radius"];
 
         pub_depth_map = (int)fsSettings["pub_depth_map"];
+        //Depth map can be restricted to a ROI [x, y, width, height] and decimated per direction
+        const char * dir_names[] = {"left", "front", "right", "rear"};
+        for (int i = 0; i < 4; i ++) {
+            std::string dir_name(dir_names[i]);
+            if (!fsSettings[dir_name + "_depth_map_roi"].empty()) {
+                fsSettings[dir_name + "_depth_map_roi"] >> depthmap_rois[i];
+            }
+            depthmap_steps[i] = fsSettings[dir_name + "_depth_map_step"];
+            if (depthmap_steps[i] <= 0) {
+                depthmap_steps[i] = 1;
+            }
+        }
         pub_cloud_all =  (int)fsSettings["pub_cloud_all"];
         enable_extrinsic_calib_for_depth = (int)fsSettings["enable_extrinsic_calib"];
         std::string cfg;
@@ -189,9 +205,9 @@ void DepthCamManager::update_pcl_depth_from_image(ros::Time stamp, int direction
         add_pts_point_cloud(pts_3ds[direction], R*ric1, P+R*tic1, stamp, pcl, pub_cloud_step, texture_img);
     }
 
-    if(pub_depth_map) {
-        cv::Mat depthmap = depth_maps[direction];
-        sensor_msgs::ImagePtr depth_img_msg = cv_bridge::CvImage(std_msgs::Header(), "32FC1", depthmap).toImageMsg();
+    if(pub_depth_map && depthmap_msgs[direction]) {
+        //Depth map is generated in place in the message buffer, publish it without copy
+        auto & depth_img_msg = depthmap_msgs[direction];
         depth_img_msg->header.stamp = stamp;
         pub_depth_maps[direction].publish(depth_img_msg);
 
@@ -251,18 +267,14 @@ void DepthCamManager::update_depth_image(int direction, cv::cuda::GpuMat _up_fro
     auto dep_est = deps[direction];
     // ROS_WARN("Dep est %d from %d", dep_est, direction);
     
-    cv::Mat pointcloud_up = dep_est->ComputeDepthCloud<cv::cuda::GpuMat>(up_front, down_front);
+    cv::Mat disparity = dep_est->ComputeDisparity32F<cv::cuda::GpuMat>(up_front, down_front);
 
     if(ENABLE_PERF_OUTPUT) {
-        ROS_INFO("Up to ComputeDepthCloud cost %f", tic_resize.toc());
+        ROS_INFO("Up to ComputeDisparity32F cost %f", tic_resize.toc());
     }
 
-    cv::Mat depthmap;
     if(pub_depth_map) {
-        if (pcl2depth_map[direction].empty()) {
-            pcl2depth_map[direction] = build_pcl2depth_map(pointcloud_up, ric1.transpose()*ric_depth);
-        }
-        depthmap = generate_depthmap(pointcloud_up, pcl2depth_map[direction]);
+        update_depthmap(direction, dep_est, disparity, ric1.transpose()*ric_depth);
     }
 
     if(ENABLE_PERF_OUTPUT) {
@@ -291,8 +303,14 @@ void DepthCamManager::update_depth_image(int direction, cv::cuda::GpuMat _up_fro
         ROS_INFO("Up to save_texture cost %f", tic_resize.toc());
     }
    
-    depth_maps[direction] = depthmap;
-    pts_3ds[direction] = pointcloud_up;
+    //Point cloud is only consumed by the cloud publisher
+    if (pub_cloud_all) {
+        pts_3ds[direction] = dep_est->ReprojectTo3D(disparity);
+    }
+
+    if(ENABLE_PERF_OUTPUT) {
+        ROS_INFO("Up to ReprojectTo3D cost %f", tic_resize.toc());
+    }
 
 #endif
 }
@@ -336,18 +354,14 @@ void DepthCamManager::update_depth_image(int direction, cv::Mat _up_front, cv::M
     auto dep_est = deps[direction];
     // ROS_WARN("Dep est %d from %d", dep_est, direction);
     
-    cv::Mat pointcloud_up = dep_est->ComputeDepthCloud<cv::Mat>(up_front, down_front);
+    cv::Mat disparity = dep_est->ComputeDisparity32F<cv::Mat>(up_front, down_front);
 
     if(ENABLE_PERF_OUTPUT) {
-        ROS_INFO("Up to ComputeDepthCloud cost %f", tic_resize.toc());
+        ROS_INFO("Up to ComputeDisparity32F cost %f", tic_resize.toc());
     }
 
-    cv::Mat depthmap;
     if(pub_depth_map) {
-        if (pcl2depth_map[direction].empty()) {
-            pcl2depth_map[direction] = build_pcl2depth_map(pointcloud_up, ric1.transpose()*ric_depth);
-        }
-        depthmap = generate_depthmap(pointcloud_up, pcl2depth_map[direction]);
+        update_depthmap(direction, dep_est, disparity, ric1.transpose()*ric_depth);
     }
 
     if(ENABLE_PERF_OUTPUT) {
@@ -374,8 +388,14 @@ void DepthCamManager::update_depth_image(int direction, cv::Mat _up_front, cv::M
         ROS_INFO("Up to save_texture cost %f", tic_resize.toc());
     }
    
-    depth_maps[direction] = depthmap;
-    pts_3ds[direction] = pointcloud_up;
+    //Point cloud is only consumed by the cloud publisher
+    if (pub_cloud_all) {
+        pts_3ds[direction] = dep_est->ReprojectTo3D(disparity);
+    }
+
+    if(ENABLE_PERF_OUTPUT) {
+        ROS_INFO("Up to ReprojectTo3D cost %f", tic_resize.toc());
+    }
 
 }
 
@@ -512,32 +532,84 @@ void DepthCamManager::publish_world_point_cloud(const cv::Mat & pts3d, Eigen::Ma
 }
 
 
-cv::Mat DepthCamManager::build_pcl2depth_map(const cv::Mat & pts3d, Eigen::Matrix3d rel_ric_depth) const {
-    cv::Mat pcl2depth_map(depth_cam->imageHeight(), depth_cam->imageWidth(), CV_32FC2);
-    pcl2depth_map.setTo(0);
-    Eigen::Matrix3d cam_mat;
-    for(int v = 0; v < pts3d.rows; v += 1) {
-        for(int u = 0; u < pts3d.cols; u += 1)  
-        {
-            cv::Vec3f vec = pts3d.at<cv::Vec3f>(v, u);
-            Eigen::Vector3d vec3d(vec[0], vec[1], vec[2]);
-            vec3d = rel_ric_depth.transpose()*vec3d;
-            Eigen::Vector2d p_sphere(0, 0);
-            depth_cam->spaceToPlane(vec3d, p_sphere);
-            //Than here is the undist points
-            int px = p_sphere.x();
-            int py = p_sphere.y();
-            if (py < depth_cam->imageHeight() && px < depth_cam->imageWidth() && px > 0 && py > 0) {
-                pcl2depth_map.at<cv::Vec2f>(py, px) = cv::Vec2f(v, u);
+cv::Mat DepthCamManager::depthmap_buffer(int direction, cv::Size size) {
+    auto & msg = depthmap_msgs[direction];
+    //Intra-process subscribers may still hold the last published message; reuse it only when we are the only owner
+    if (!msg || !msg.unique() || (int)msg->width != size.width || (int)msg->height != size.height) {
+        msg = boost::make_shared<sensor_msgs::Image>();
+        msg->encoding = sensor_msgs::image_encodings::TYPE_32FC1;
+        msg->width = size.width;
+        msg->height = size.height;
+        msg->is_bigendian = 0;
+        msg->step = size.width * sizeof(float);
+        msg->data.resize(msg->step * size.height);
+    }
+    return cv::Mat(size, CV_32FC1, msg->data.data(), msg->step);
+}
+
+void DepthCamManager::update_depthmap(int direction, DepthEstimator * dep_est, const cv::Mat & disparity, Eigen::Matrix3d rel_ric_depth) {
+    auto & index = depthmap_index[direction];
+    if (index.rectify_version != dep_est->get_rectify_version()) {
+        index = build_depthmap_index(direction, dep_est->get_Q(), disparity.size(), rel_ric_depth);
+        index.rectify_version = dep_est->get_rectify_version();
+    }
+
+    depth_maps[direction] = depthmap_buffer(direction, index.size);
+    generate_depthmap(disparity, index, dep_est->get_Q(), depth_maps[direction]);
+}
+
+DepthMapIndex DepthCamManager::build_depthmap_index(int direction, const cv::Mat & Q, cv::Size disp_size, Eigen::Matrix3d rel_ric_depth) const {
+    DepthMapIndex index;
+    cv::Rect full(0, 0, depth_cam->imageWidth(), depth_cam->imageHeight());
+    cv::Rect roi = depthmap_rois[direction] & full;
+    if (roi.area() == 0) {
+        roi = full;
+    }
+    int step = depthmap_steps[direction];
+    index.size = cv::Size((roi.width + step - 1) / step, (roi.height + step - 1) / step);
+    index.disp_index.resize(index.size.area(), -1);
+    index.scale.resize(index.size.area(), 0);
+
+    //Rectified camera from Q: X = (u - cx)/W, Y = (v - cy)/W, Z = f/W
+    double cx = -Q.at<float>(0, 3);
+    double cy = -Q.at<float>(1, 3);
+    double f = Q.at<float>(2, 3);
+
+    for (int y = 0; y < index.size.height; y ++) {
+        for (int x = 0; x < index.size.width; x ++) {
+            Eigen::Vector2d p(roi.x + x * step, roi.y + y * step);
+            Eigen::Vector3d ray;
+            depth_cam->liftProjective(p, ray);
+            Eigen::Vector3d ray_rect = rel_ric_depth * ray;
+            if (ray_rect.z() <= 0) {
+                continue;
+            }
+            int u = std::round(f * ray_rect.x() / ray_rect.z() + cx);
+            int v = std::round(f * ray_rect.y() / ray_rect.z() + cy);
+            if (u >= 0 && v >= 0 && u < disp_size.width && v < disp_size.height) {
+                int i = y * index.size.width + x;
+                index.disp_index[i] = v * disp_size.width + u;
+                //depth along the depth camera axis is Z_rect / ray_rect.z()
+                index.scale[i] = f * ray.z() / ray_rect.z();
             }
         }
     }
 
-    return pcl2depth_map;
+    return index;
 }
 
-cv::Mat DepthCamManager::generate_depthmap(const cv::Mat & pts3d, const cv::Mat & pcl2depth_map) const {
-    cv::Mat depthmap;
-    cv::remap(pts3d, depthmap, pcl2depth_map, cv::Mat(), cv::INTER_LINEAR);
-    return depthmap;
+void DepthCamManager::generate_depthmap(const cv::Mat & disparity, const DepthMapIndex & index, const cv::Mat & Q, cv::Mat & depthmap) const {
+    const float q32 = Q.at<float>(3, 2);
+    const float q33 = Q.at<float>(3, 3);
+    const float * disp = disparity.ptr<float>();
+    const int * disp_index = index.disp_index.data();
+    const float * scale = index.scale.data();
+    assert(disparity.isContinuous() && depthmap.isContinuous());
+
+    float * depth = depthmap.ptr<float>();
+    int size = index.size.area();
+    for (int i = 0; i < size; i ++) {
+        float d = disp_index[i] < 0 ? 0 : disp[disp_index[i]];
+        depth[i] = d > 0 ? scale[i] / (q32 * d + q33) : 0;
+    }
 }
@@ -13,6 +13,17 @@
 
 class FisheyeUndist;
 
+//Precomputed lookup from each (ROI, decimated) depth map pixel to the rectified disparity pixel it samples.
+//Depth of the pixel is scale / (Q32 * disparity + Q33), so no XYZ cloud is needed to build the depth map.
+struct DepthMapIndex {
+    //Rectify version of the DepthEstimator this index was built with; -1 for not built
+    int rectify_version = -1;
+    cv::Size size;
+    //Row-major index into the disparity image, -1 if the pixel is out of the rectified view
+    std::vector<int> disp_index;
+    std::vector<float> scale;
+};
+
 class DepthCamManager {
     std::vector<ros::Publisher> pub_depth_clouds;
     std::vector<ros::Publisher> pub_depth_maps;
@@ -46,7 +57,10 @@ class DepthCamManager {
     std::vector<cv::Mat> depth_maps;
     std::vector<cv::Mat> pts_3ds;
     std::vector<cv::Mat> texture_imgs;
-    std::vector<cv::Mat> pcl2depth_map;
+    std::vector<DepthMapIndex> depthmap_index;
+    std::vector<sensor_msgs::ImagePtr> depthmap_msgs;
+    std::vector<cv::Rect> depthmap_rois;
+    std::vector<int> depthmap_steps;
 
     int show_disparity = 0;
     int enable_extrinsic_calib_for_depth = 0;
@@ -87,8 +101,10 @@ public:
     void add_pts_point_cloud(const cv::Mat & pts3d, Eigen::Matrix3d R, Eigen::Vector3d P, ros::Time stamp,
         sensor_msgs::PointCloud & pcl, int step = 3, cv::Mat color = cv::Mat());
 
-    cv::Mat generate_depthmap(const cv::Mat & pts3d, const cv::Mat & pcl2depth_map) const;
-    cv::Mat build_pcl2depth_map(const cv::Mat & pts3d, Eigen::Matrix3d rel_ric_depth) const;
+    void generate_depthmap(const cv::Mat & disparity, const DepthMapIndex & index, const cv::Mat & Q, cv::Mat & depthmap) const;
+    DepthMapIndex build_depthmap_index(int direction, const cv::Mat & Q, cv::Size disp_size, Eigen::Matrix3d rel_ric_depth) const;
+    void update_depthmap(int direction, DepthEstimator * dep_est, const cv::Mat & disparity, Eigen::Matrix3d rel_ric_depth);
+    cv::Mat depthmap_buffer(int direction, cv::Size size);
     template<typename cvMat>
     void update_depth_image(ros::Time stamp, cvMat _up_front, cvMat _down_front, 
         Eigen::Matrix3d ric1, Eigen::Vector3d tic1,
@@ -145,6 +161,16 @@ public:
 
 
 
+    //Flattened views read by update_images_to_buf, 0 top 1 left 2 front 3 right 4 rear
+    std::vector<bool> consumed_views() const {
+        std::vector<bool> views(5, false);
+        views[1] = estimate_left_depth;
+        views[2] = estimate_front_depth;
+        views[3] = estimate_right_depth;
+        views[4] = estimate_rear_depth;
+        return views;
+    }
+
     template<typename cvMat>
     void update_images_to_buf(std::vector<cvMat> & up_cams, std::vector<cvMat> & down_cams) {
         
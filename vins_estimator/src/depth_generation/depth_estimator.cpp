@@ -72,6 +72,7 @@ cv::Mat DepthEstimator::ComputeDispartiyMap(cv::cuda::GpuMat & left, cv::cuda::G
         _Q.convertTo(Q, CV_32F);
 
         first_init = false;
+        rectify_version ++;
     } 
 
 #ifdef FORCE_CPU_SBGM
@@ -144,7 +145,9 @@ cv::Mat DepthEstimator::ComputeDispartiyMap(cv::cuda::GpuMat & left, cv::cuda::G
             cv::waitKey(2);
         }            
             
-        ROS_INFO("SGBM time cost %fms", tic.toc());
+        if(ENABLE_PERF_OUTPUT) {
+            ROS_INFO("SGBM time cost %fms", tic.toc());
+        }
 
         return disparity;
 
@@ -207,7 +210,9 @@ cv::Mat DepthEstimator::ComputeDispartiyMap(cv::cuda::GpuMat & left, cv::cuda::G
         auto _cv_disp_cuda = map.getGpuMat();
         _cv_disp_cuda.download(cv_disp);
 
-        ROS_INFO("Visionworks DISP %d %d!Time %fms", cv_disp.size().width, cv_disp.size().height, tic.toc());
+        if(ENABLE_PERF_OUTPUT) {
+            ROS_INFO("Visionworks DISP %d %d!Time %fms", cv_disp.size().width, cv_disp.size().height, tic.toc());
+        }
         if (show) {
             cv::Mat color_disp;
             color->process();
@@ -271,6 +276,7 @@ cv::Mat DepthEstimator::ComputeDispartiyMap(cv::Mat & left, cv::Mat & right) {
         _Q.convertTo(Q, CV_32F);
 
         first_init = false;
+        rectify_version ++;
     } 
 
 
@@ -284,7 +290,9 @@ cv::Mat DepthEstimator::ComputeDispartiyMap(cv::Mat & left, cv::Mat & right) {
 
     // sgbm->compute(right_rect, left_rect, disparity);
     sgbm->compute(leftRectify, rightRectify, disparity);
-    ROS_INFO("CPU SGBM time cost %fms", tic.toc());
+    if(ENABLE_PERF_OUTPUT) {
+        ROS_INFO("CPU SGBM time cost %fms", tic.toc());
+    }
     if (show) {
         cv::Mat disparity_color, disp;
         disparity.convertTo(disp, CV_8U, 255. / params.num_disp/16);
@@ -44,6 +44,7 @@ class DepthEstimator {
     sgm::LibSGMWrapper * sgmp;
 #endif
     bool first_init = true;
+    int rectify_version = 0;
     cv::Mat R, T, R1, R2, P1, P2, Q;
     double baseline = 0;
     
@@ -89,8 +90,18 @@ public:
         cv::remap(img, texture, map11, map12, cv::INTER_LINEAR);
     }
 
+    //Q is only valid after the first disparity has been computed, and is rebuilt after online extrinsic calibration.
+    //rectify_version increases every time Q changes so that users caching data derived from Q can invalidate it.
+    const cv::Mat & get_Q() const {
+        return Q;
+    }
+
+    int get_rectify_version() const {
+        return rectify_version;
+    }
+
     template<typename cvMat>
-    cv::Mat ComputeDepthCloud(cvMat & left, cvMat & right) {
+    cv::Mat ComputeDisparity32F(cvMat & left, cvMat & right) {
         static int count = 0;
         int skip = 10/extrinsic_calib_rate;
         if (skip <= 0) {
@@ -114,19 +125,21 @@ public:
         }
         
         cv::Mat dispartitymap = ComputeDispartiyMap(left, right);
-        int width = left.size().width;
-        int height = left.size().height;
 
         cv::Mat imgDisparity32F;
-        TicToc tic1;
         dispartitymap.convertTo(imgDisparity32F, CV_32F, 1./16);
         cv::threshold(imgDisparity32F, imgDisparity32F, params.min_disparity, 1000, cv::THRESH_TOZERO);
-        ROS_INFO("Convert cost %fms", tic1.toc());
+        return imgDisparity32F;
+    }
 
-        TicToc tic;
+    cv::Mat ReprojectTo3D(const cv::Mat & imgDisparity32F) const {
         cv::Mat XYZ = cv::Mat::zeros(imgDisparity32F.rows, imgDisparity32F.cols, CV_32FC3);   // Output point cloud
         cv::reprojectImageTo3D(imgDisparity32F, XYZ, Q);    // cv::project
-        ROS_INFO("Reproject to 3d cost %fms", tic.toc());
         return XYZ;
     }
+
+    template<typename cvMat>
+    cv::Mat ComputeDepthCloud(cvMat & left, cvMat & right) {
+        return ReprojectTo3D(ComputeDisparity32F(left, right));
+    }
 };
\ No newline at end of file
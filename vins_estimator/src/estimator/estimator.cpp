@@ -29,19 +29,50 @@ Estimator::Estimator(): f_manager{Rs}
     initFirstPoseFlag = false;
 }
 
+Estimator::~Estimator()
+{
+    //Stop the loops before the state they use goes away
+    threads_running = false;
+    featureBuf.stop();
+    if (processThread.joinable())
+        processThread.join();
+    if (depthThread.joinable())
+        depthThread.join();
+
+    waitMarginalization();
+    if (last_marginalization_info != nullptr)
+        delete last_marginalization_info;
+    if (verify_marginalization_info != nullptr)
+        delete verify_marginalization_info;
+}
+
 void Estimator::setParameter()
 {
-     if (FISHEYE) {
-        if (USE_GPU) {
-            featureTracker = new FeatureTracker::FisheyeFeatureTrackerCuda(this);
+    //Restart keeps the tracker, the frontend and depth manager hold on to it
+    bool new_tracker = featureTracker == nullptr;
+    if (new_tracker) {
+        if (FISHEYE) {
+            if (USE_GPU) {
+                featureTracker = new FeatureTracker::FisheyeFeatureTrackerCuda(this);
+            } else if (FISHEYE_DIRECT) {
+                featureTracker = new FeatureTracker::FisheyeFeatureTrackerDirect(this);
+            } else {
+                featureTracker = new FeatureTracker::FisheyeFeatureTrackerOpenMP(this);
+            }
         } else {
-            featureTracker = new FeatureTracker::FisheyeFeatureTrackerOpenMP(this);
+            if (USE_GPU) {
+                featureTracker = new FeatureTracker::PinholeFeatureTrackerCuda(this);
+            } else {
+                featureTracker = new FeatureTracker::PinholeFeatureTrackerOpenMP(this);
+            }
         }
-    } else {
-        featureTracker = new FeatureTracker::PinholeFeatureTrackerCuda(this);
     }
 
     f_manager.ft = featureTracker;
+    featureBuf.configure(FEATURE_QUEUE_SIZE, QUEUE_BLOCK);
+    overload.setParameter();
+    solver_budget.setParameter();
+    landmark_selector.setParameter();
 
     for (int i = 0; i < NUM_OF_CAM; i++)
     {
@@ -57,33 +88,33 @@ void Estimator::setParameter()
     g = G;
     cout << "set g " << g.transpose() << endl;
     
-    featureTracker->readIntrinsicParameter(CAM_NAMES);
+    if (new_tracker)
+        featureTracker->readIntrinsicParameter(CAM_NAMES);
 
-    processThread   = std::thread(&Estimator::processMeasurements, this);
-    if (FISHEYE && ENABLE_DEPTH) {
+    if (!processThread.joinable())
+        processThread   = std::thread(&Estimator::processMeasurements, this);
+    if (FISHEYE && ENABLE_DEPTH && !depthThread.joinable()) {
         depthThread   = std::thread(&Estimator::processDepthGeneration, this);
     }
 }
 
+void Estimator::requestRestart()
+{
+    restart_requested = true;
+}
+
 void Estimator::inputImage(double t, const cv::Mat &_img, const cv::Mat &_img1)
 {
-    static int img_track_count = 0;
-    static double sum_time = 0;
     inputImageCnt++;
     FeatureFrame featureFrame;
     TicToc featureTrackerTime;
 
     featureFrame = featureTracker->trackImage(t, _img, _img1);
-
-    double dt = featureTrackerTime.toc();
-    sum_time += dt;
-    img_track_count ++;
+    PERF_RECORD(PERF_TRACK, featureTrackerTime.toc());
 
     if(inputImageCnt % 2 == 0)
     {
-        mBuf.lock();
-        featureBuf.push(make_pair(t, featureFrame));
-        mBuf.unlock();
+        inputFeature(t, std::move(featureFrame));
     }
 }
 
@@ -96,19 +127,20 @@ bool Estimator::is_next_odometry_frame() {
 void Estimator::inputFisheyeImage(double t, const CvImages & fisheye_imgs_up, 
         const CvImages & fisheye_imgs_down)
 {
-    static int img_track_count = 0;
-    static double sum_time = 0;
     inputImageCnt++;
     
     FeatureFrame featureFrame;
     TicToc featureTrackerTime;
 
+    predictPtsByGyro(t);
     featureFrame = featureTracker->trackImage(t, fisheye_imgs_up, fisheye_imgs_down);
+    PERF_RECORD(PERF_TRACK, featureTrackerTime.toc());
 
     if(inputImageCnt % 2 == 0)
     {
+        //Push without holding mBuf, this may wait for the backend
+        inputFeature(t, std::move(featureFrame));
         mBuf.lock();
-        featureBuf.push(make_pair(t, featureFrame));
         if (FISHEYE && ENABLE_DEPTH) {
             fisheye_imgs_upBuf.push(fisheye_imgs_up);
             fisheye_imgs_downBuf.push(fisheye_imgs_down);
@@ -116,26 +148,37 @@ void Estimator::inputFisheyeImage(double t, const CvImages & fisheye_imgs_up,
         }
         mBuf.unlock();
     }
+}
+
+//Direct tracking on raw fisheye images; flattened views are only kept for depth
+void Estimator::inputFisheyeRawImage(double t, const cv::Mat & raw_up, const cv::Mat & raw_down,
+        const CvImages & fisheye_imgs_up, const CvImages & fisheye_imgs_down)
+{
+    inputImageCnt++;
 
-    double dt = featureTrackerTime.toc();
+    FeatureFrame featureFrame;
+    TicToc featureTrackerTime;
 
-    if (inputImageCnt > 100) {
-        sum_time += dt;
-        img_track_count ++;
-    }
+    predictPtsByGyro(t);
+    featureFrame = featureTracker->trackImage(t, raw_up, raw_down);
+    PERF_RECORD(PERF_TRACK, featureTrackerTime.toc());
 
-    if(ENABLE_PERF_OUTPUT) {
-        printf("featureTracker time: AVG %f NOW %f inputImageCnt %d Bufsize %ld imgs buf Size %ld\n", 
-            sum_time/img_track_count, dt, inputImageCnt, featureBuf.size(), fisheye_imgs_upBuf_cuda.size());
+    if(inputImageCnt % 2 == 0)
+    {
+        inputFeature(t, std::move(featureFrame));
+        mBuf.lock();
+        if (ENABLE_DEPTH) {
+            fisheye_imgs_upBuf.push(fisheye_imgs_up);
+            fisheye_imgs_downBuf.push(fisheye_imgs_down);
+            fisheye_imgs_stampBuf.push(t);
+        }
+        mBuf.unlock();
     }
-   
 }
 
 void Estimator::inputFisheyeImage(double t, const CvCudaImages & fisheye_imgs_up_cuda, 
         const CvCudaImages & fisheye_imgs_down_cuda, bool is_blank_init)
 {
-    static int img_track_count = 0;
-    static double sum_time = 0;
     if (!is_blank_init) {
         inputImageCnt++;
     }
@@ -148,13 +191,16 @@ void Estimator::inputFisheyeImage(double t, const CvCudaImages & fisheye_imgs_up
             trackImage_blank_init(t, fisheye_imgs_up_cuda, fisheye_imgs_down_cuda);
             return;
     } else {
+        predictPtsByGyro(t);
         featureFrame = featureTracker->trackImage(t, fisheye_imgs_up_cuda, fisheye_imgs_down_cuda);
+        PERF_RECORD(PERF_TRACK, featureTrackerTime.toc());
     }
 
     if(inputImageCnt % 2 == 0)
     {
+        //Push without holding mBuf, this may wait for the backend
+        inputFeature(t, std::move(featureFrame));
         mBuf.lock();
-        featureBuf.push(make_pair(t, featureFrame));
         if (FISHEYE && ENABLE_DEPTH) {
             fisheye_imgs_upBuf_cuda.push(fisheye_imgs_up_cuda);
             fisheye_imgs_downBuf_cuda.push(fisheye_imgs_down_cuda);
@@ -162,19 +208,6 @@ void Estimator::inputFisheyeImage(double t, const CvCudaImages & fisheye_imgs_up
         }
         mBuf.unlock();
     }
-
-    double dt = featureTrackerTime.toc();
-
-    if (inputImageCnt > 100) {
-        sum_time += dt;
-        img_track_count ++;
-    }
-
-    if(ENABLE_PERF_OUTPUT) {
-        printf("featureTracker time: AVG %f NOW %f inputImageCnt %d Bufsize %ld imgs buf Size %ld\n", 
-            sum_time/img_track_count, dt, inputImageCnt, featureBuf.size(), fisheye_imgs_upBuf_cuda.size());
-    }
-   
 }
 
 double base = 0;
@@ -186,6 +219,13 @@ void Estimator::inputIMU(double t, const Vector3d &linearAcceleration, const Vec
 
     accBuf.push(make_pair(t, linearAcceleration));
     gyrBuf.push(make_pair(t, angularVelocity));
+    if (GYRO_PREDICT) {
+        trackGyrBuf.push_back(make_pair(t, angularVelocity));
+        //Images stopped, keep about one second
+        while (trackGyrBuf.size() > IMU_FREQ) {
+            trackGyrBuf.pop_front();
+        }
+    }
 
     if (fast_prop_inited) {
         double dt = t - latest_time;
@@ -207,11 +247,9 @@ void Estimator::inputIMU(double t, const Vector3d &linearAcceleration, const Vec
 
 }
 
-void Estimator::inputFeature(double t, const FeatureFrame &featureFrame)
+void Estimator::inputFeature(double t, FeatureFrame &&featureFrame)
 {
-    mBuf.lock();
-    featureBuf.push(make_pair(t, featureFrame));
-    mBuf.unlock();
+    featureBuf.push(make_pair(t, std::move(featureFrame)));
 }
 
 
@@ -282,7 +320,7 @@ void Estimator::processDepthGeneration() {
     std::vector<cv::cuda::GpuMat> fisheye_imgs_up_cuda, fisheye_imgs_down_cuda;
     std::vector<cv::Mat> fisheye_imgs_up, fisheye_imgs_down;
 
-    while(ros::ok()) {
+    while(ros::ok() && threads_running) {
         if (!fisheye_imgs_upBuf.empty() || !fisheye_imgs_upBuf_cuda.empty()) {
             double t = fisheye_imgs_stampBuf.front();
             if (USE_GPU) {
@@ -304,6 +342,19 @@ void Estimator::processDepthGeneration() {
                 fisheye_imgs_stampBuf.pop();
                 mBuf.unlock();
             }
+
+            //No odometry will come for a dropped frame, and stamps up to this one can't match anymore
+            mBuf.lock();
+            bool dropped = dropped_depth_stamps.count(t) > 0;
+            dropped_depth_stamps.erase(dropped_depth_stamps.begin(), dropped_depth_stamps.upper_bound(t));
+            mBuf.unlock();
+            if (dropped) {
+                fisheye_imgs_up_cuda.clear();
+                fisheye_imgs_down_cuda.clear();
+                fisheye_imgs_up.clear();
+                fisheye_imgs_down.clear();
+                continue;
+            }
             //Use imu propaget for depth cloud, this is for realtime peformance;
             while(!IMUAvailable(t + td)) {
                 printf("Depth wait for IMU ... \n");
@@ -318,9 +369,7 @@ void Estimator::processDepthGeneration() {
                 depth_cam_manager->update_images_to_buf(fisheye_imgs_up, fisheye_imgs_down);
             }
 
-            if (ENABLE_PERF_OUTPUT) {
-                ROS_INFO("Depth generation cost %fms", tic.toc());
-            }
+            PERF_RECORD(PERF_DEPTH, tic.toc());
             
             while(odometry_buf.size() == 0) {
                 //wait for odom
@@ -352,13 +401,9 @@ void Estimator::processDepthGeneration() {
             odometry_buf.pop();
             odomBuf.unlock();
             
-            depth_cam_manager->pub_depths_from_buf(ros::Time(t), this->ric[0], this->tic[0], _sync_last_R, _sync_last_P);
-            std_msgs::Header header;
-            header.frame_id = "world";
-            header.stamp = ros::Time(t);
-
             TicToc tic_pub;
-            ROS_INFO("Pub flatten images cost %fms", tic_pub.toc());
+            depth_cam_manager->pub_depths_from_buf(ros::Time(t), this->ric[0], this->tic[0], _sync_last_R, _sync_last_P);
+            PERF_RECORD(PERF_PUBLISH, tic_pub.toc());
 
             fisheye_imgs_up.clear();
             fisheye_imgs_down.clear();
@@ -369,23 +414,46 @@ void Estimator::processDepthGeneration() {
     }
 }
 
-void Estimator::processMeasurements()
+void Estimator::dropDepthFrame(double t)
 {
+    if (FISHEYE && ENABLE_DEPTH)
+    {
+        mBuf.lock();
+        dropped_depth_stamps.insert(t);
+        mBuf.unlock();
+    }
+}
 
-    static int mea_track_count = 0;
-    static double mea_sum_time = 0;
-    while (1)
+void Estimator::processMeasurements()
+{
+    while (threads_running)
     {
+        //Restart here so processImage never sees a half cleared state
+        if (restart_requested.exchange(false))
+        {
+            clearState();
+            setParameter();
+        }
         //printf("process measurments\n");
         TicToc t_process;
         pair<double, FeatureFrame > feature;
         vector<pair<double, Eigen::Vector3d>> accVector, gyrVector;
-        if(!featureBuf.empty())
+        if(featureBuf.pop(feature, 2))
         {
-            feature = featureBuf.front();
+            //Keep only the newest frames; IMU is integrated over the gap since prevTime is kept
+            int drop_cnt = overload.framesToDrop(featureBuf.size());
+            for (int i = 0; i < drop_cnt; i ++) {
+                double dropped_t = feature.first;
+                if (!featureBuf.pop(feature, 0)) {
+                    break;
+                }
+                overload.countDropped(1);
+                dropDepthFrame(dropped_t);
+            }
+            int queue_depth = featureBuf.size();
 
             curTime = feature.first + td;
-            while(1)
+            while(threads_running)
             {
                 if ((!USE_IMU  || IMUAvailable(feature.first + td)))
                     break;
@@ -396,6 +464,8 @@ void Estimator::processMeasurements()
                     std::this_thread::sleep_for(dura);
                 }
             }
+            if (!threads_running)
+                break;
             mBuf.lock();
             if(USE_IMU) {
                 getIMUInterval(prevTime, curTime, accVector, gyrVector);
@@ -403,8 +473,6 @@ void Estimator::processMeasurements()
                     ROS_WARN("Long image dt %fms or wrong IMU rate %fhz", (curTime - prevTime)*1000, accVector.size()/(curTime - prevTime));
                 } 
             }
-
-            featureBuf.pop();
             mBuf.unlock();
 
             if(USE_IMU)
@@ -424,8 +492,21 @@ void Estimator::processMeasurements()
                 }
             }
 
+            if (overload.enabled(OVERLOAD_SKIP_NON_KEYFRAME) && overload.overloaded() && solver_flag == NON_LINEAR &&
+                    !f_manager.isKeyframeCandidate(frame_count, feature.second)) {
+                //IMU stays in pre_integrations, next frame continues from here
+                prevTime = curTime;
+                dropDepthFrame(feature.first);
+                overload.countSkipped();
+                overload.update(queue_depth, t_process.toc());
+                continue;
+            }
+
+            bool solved = solver_flag == NON_LINEAR;
             processImage(feature.second, feature.first);
             prevTime = curTime;
+            //processImage may have reset the system
+            solved = solved && solver_flag == NON_LINEAR;
 
             printStatistics(*this, 0);
 
@@ -433,6 +514,7 @@ void Estimator::processMeasurements()
             header.frame_id = "world";
             header.stamp = ros::Time(feature.first);
 
+            TicToc t_pub;
             pubIMUBias(latest_Ba, latest_Bg, header);
             //These cost 5ms, ~1/6 percent on manifold2
             pubOdometry(*this, header);
@@ -441,18 +523,28 @@ void Estimator::processMeasurements()
             pubPointCloud(*this, header);
             pubKeyframe(*this);
             pubTF(*this, header);
+            PERF_RECORD(PERF_PUBLISH, t_pub.toc());
 
             double dt = t_process.toc();
-            mea_sum_time += dt;
-            mea_track_count ++;
+            PERF_RECORD(PERF_ESTIMATE, dt);
+            overload.update(queue_depth, dt);
+            if (solved) {
+                solver_budget.update(dt);
+                pubSolverBudget(*this, header);
+            }
+            featureTracker->setDetectScale(overload.detectScale());
 
             if(ENABLE_PERF_OUTPUT) {
-                ROS_INFO("process measurement time: AVG %f NOW %f\n", mea_sum_time/mea_track_count, dt );
+                auto wait_hist = featureBuf.wait_histogram();
+                if (wait_hist.count() % 50 == 0) {
+                    ROS_INFO("[Pipeline] feature queue wait %s", wait_hist.summary().c_str());
+                    ROS_INFO("[Overload] %s", overload.summary().c_str());
+                    ROS_INFO("[SolverBudget] %s", solver_budget.summary().c_str());
+                    if (landmark_selector.enabled())
+                        ROS_INFO("[Landmarks] %s", landmark_selector.summary().c_str());
+                }
             }
         }
-
-        std::chrono::milliseconds dura(2);
-        std::this_thread::sleep_for(dura);
     }
 }
 
@@ -496,9 +588,6 @@ void Estimator::clearState()
         Vs[i].setZero();
         Bas[i].setZero();
         Bgs[i].setZero();
-        dt_buf[i].clear();
-        linear_acceleration_buf[i].clear();
-        angular_velocity_buf[i].clear();
 
         if (pre_integrations[i] != nullptr)
         {
@@ -506,6 +595,13 @@ void Estimator::clearState()
         }
         pre_integrations[i] = nullptr;
     }
+    Headers.reset();
+    Rs.reset();
+    Ps.reset();
+    Vs.reset();
+    Bas.reset();
+    Bgs.reset();
+    pre_integrations.reset();
 
     for (int i = 0; i < NUM_OF_CAM; i++)
     {
@@ -518,15 +614,22 @@ void Estimator::clearState()
     sum_of_front = 0;
     frame_count = 0;
     solver_flag = INITIAL;
+    initial_timestamp = 0;
+    t_restart.tic();
+    //IMU and frontend threads keep running during a restart, they use these under mBuf
+    mBuf.lock();
     latest_P = Eigen::Vector3d::Zero();
     latest_V = Eigen::Vector3d::Zero();
     latest_Q = Eigen::Quaterniond::Identity();
     fast_prop_inited = false;
-    initial_timestamp = 0;
-    all_image_frame.clear();
+    trackGyrBuf.clear();
+    prevTrackTime = -1;
+    mBuf.unlock();
+    releaseImageFrames();
 
     if (tmp_pre_integration != nullptr)
         delete tmp_pre_integration;
+    waitMarginalization();
     if (last_marginalization_info != nullptr)
         delete last_marginalization_info;
 
@@ -539,6 +642,13 @@ void Estimator::clearState()
     failure_occur = 0;
 }
 
+void Estimator::releaseImageFrames()
+{
+    for (auto &frame : all_image_frame)
+        delete frame.second.pre_integration;
+    all_image_frame.clear();
+}
+
 void Estimator::processIMU(double t, double dt, const Vector3d &linear_acceleration, const Vector3d &angular_velocity)
 {
     if (!first_imu)
@@ -555,13 +665,9 @@ void Estimator::processIMU(double t, double dt, const Vector3d &linear_accelerat
     if (frame_count != 0)
     {
         pre_integrations[frame_count]->push_back(dt, linear_acceleration, angular_velocity);
-        //if(solver_flag != NON_LINEAR)
+        if(solver_flag != NON_LINEAR)
             tmp_pre_integration->push_back(dt, linear_acceleration, angular_velocity);
 
-        dt_buf[frame_count].push_back(dt);
-        linear_acceleration_buf[frame_count].push_back(linear_acceleration);
-        angular_velocity_buf[frame_count].push_back(angular_velocity);
-
         int j = frame_count;         
         Vector3d un_acc_0 = Rs[j] * (acc_0 - Bas[j]) - g;
         Vector3d un_gyr = 0.5 * (gyr_0 + angular_velocity) - Bgs[j];
@@ -579,6 +685,7 @@ void Estimator::processImage(const FeatureFrame &image, const double header)
 {
     ROS_DEBUG("new image coming ------------------------------------------");
     ROS_DEBUG("Adding feature points %lu", image.size());
+    TicToc t_add;
     if (f_manager.addFeatureCheckParallax(frame_count, image, td))
     {
         marginalization_flag = MARGIN_OLD;
@@ -589,16 +696,21 @@ void Estimator::processImage(const FeatureFrame &image, const double header)
         marginalization_flag = MARGIN_SECOND_NEW;
         //printf("non-keyframe\n");
     }
+    PERF_RECORD(PERF_ADD_FEATURE, t_add.toc());
 
     ROS_DEBUG("%s", marginalization_flag ? "Non-keyframe" : "Keyframe");
     ROS_DEBUG("Solving %d", frame_count);
     ROS_DEBUG("number of feature: %d", f_manager.getFeatureCount());
     Headers[frame_count] = header;
 
-    ImageFrame imageframe(image, header);
-    imageframe.pre_integration = tmp_pre_integration;
-    all_image_frame.insert(make_pair(header, imageframe));
-    tmp_pre_integration = new IntegrationBase{acc_0, gyr_0, Bas[frame_count], Bgs[frame_count]};
+    //Image history is only kept until initialization succeeds, the window holds poses and preintegrations afterwards
+    if (solver_flag == INITIAL)
+    {
+        ImageFrame imageframe(image, header);
+        imageframe.pre_integration = tmp_pre_integration;
+        all_image_frame.insert(make_pair(header, imageframe));
+        tmp_pre_integration = new IntegrationBase{acc_0, gyr_0, Bas[frame_count], Bgs[frame_count]};
+    }
 
     if(ESTIMATE_EXTRINSIC == 2)
     {
@@ -622,9 +734,11 @@ void Estimator::processImage(const FeatureFrame &image, const double header)
     {
 
         base = ros::Time::now().toSec();
+        //Direct fisheye tracking gives no stereo matches, so there is no metric depth to init from
+        bool stereo_init = STEREO && !FISHEYE_DIRECT;
 
         // monocular + IMU initilization
-        if (!STEREO && USE_IMU)
+        if (!stereo_init && USE_IMU)
         {
             if (frame_count == WINDOW_SIZE)
             {
@@ -647,7 +761,7 @@ void Estimator::processImage(const FeatureFrame &image, const double header)
         }
 
         // stereo + IMU initilization
-        if(STEREO && USE_IMU)
+        if(stereo_init && USE_IMU)
         {
             ROS_INFO("Init by pose pnp...");
             f_manager.initFramePoseByPnP(frame_count, Ps, Rs, tic, ric);
@@ -686,7 +800,7 @@ void Estimator::processImage(const FeatureFrame &image, const double header)
         }
 
         // stereo only initilization
-        if(STEREO && !USE_IMU)
+        if(stereo_init && !USE_IMU)
         {
             f_manager.initFramePoseByPnP(frame_count, Ps, Rs, tic, ric);
             f_manager.triangulate(frame_count, Ps, Rs, tic, ric);
@@ -700,6 +814,12 @@ void Estimator::processImage(const FeatureFrame &image, const double header)
             }
         }
 
+        if (solver_flag == NON_LINEAR)
+        {
+            releaseImageFrames();
+            ROS_INFO("[Init] first pose %.1fms after restart", t_restart.toc());
+        }
+
         if(frame_count < WINDOW_SIZE)
         {
             frame_count++;
@@ -714,21 +834,17 @@ void Estimator::processImage(const FeatureFrame &image, const double header)
     }
     else
     {
-        TicToc t_solve;
         if(!USE_IMU)
             f_manager.initFramePoseByPnP(frame_count, Ps, Rs, tic, ric);
         TicToc t_ic;
         f_manager.triangulate(frame_count, Ps, Rs, tic, ric);
-        
-        if(ENABLE_PERF_OUTPUT) {        
-            ROS_INFO("Triangulation cost %3.1fms..", t_ic.toc());
-        }
+        PERF_RECORD(PERF_TRIANGULATE, t_ic.toc());
 
-        optimization();
-        
-        if(ENABLE_PERF_OUTPUT) {
-            ROS_INFO("after optimization cost %fms..", t_ic.toc());
-        }
+        waitMarginalization();
+        if (motionOnlyFrame())
+            motionOnlyOptimization();
+        else
+            optimization();
         
         set<int> removeIndex;
         outliersRejection(removeIndex);
@@ -738,10 +854,6 @@ void Estimator::processImage(const FeatureFrame &image, const double header)
         
         f_manager.removeOutlier(removeIndex);
         predictPtsInNextFrame();
-        
-        if(ENABLE_PERF_OUTPUT) {
-            ROS_INFO("solver costs: %fms", t_solve.toc());
-        }
 
         if (failureDetection())
         {
@@ -755,11 +867,10 @@ void Estimator::processImage(const FeatureFrame &image, const double header)
             return;
         }
 
+        TicToc t_slide;
         slideWindow();
-
-        if(ENABLE_PERF_OUTPUT) {
-            ROS_INFO("to slideWindow costs: %fms", t_solve.toc());
-        }
+        solver_budget.recordSlide(t_slide.toc());
+        PERF_RECORD(PERF_SLIDE, t_slide.toc());
 
         f_manager.removeFailures();
         // prepare output of VINS
@@ -777,9 +888,6 @@ void Estimator::processImage(const FeatureFrame &image, const double header)
         odomBuf.unlock();
 
         updateLatestStates();
-        if(ENABLE_PERF_OUTPUT) {
-            ROS_INFO("after updateLatestStates costs: %fms", t_solve.toc());
-        }
     }  
 }
 
@@ -822,6 +930,9 @@ bool Estimator::initialStructure()
     for (auto &_it : f_manager.feature)
     {
         auto & it_per_id = _it.second;
+        //SFM solves the poses of camera 0 only
+        if (it_per_id.main_cam != 0)
+            continue;
         int imu_j = it_per_id.start_frame - 1;
         SFMFeature tmp_feature;
         tmp_feature.state = false;
@@ -886,6 +997,8 @@ bool Estimator::initialStructure()
             int feature_id = id_pts.first;
             for (auto &i_p : id_pts.second)
             {
+                if (i_p.first != 0)
+                    continue;
                 it = sfm_tracked_points.find(feature_id);
                 if(it != sfm_tracked_points.end())
                 {
@@ -1064,16 +1177,10 @@ void Estimator::vector2double()
     }
 
 
-    auto deps = f_manager.getDepthVector();
-    param_feature_id.clear();
-    // printf("Solve features: %ld;", deps.size());
-    for (auto & it : deps) {
-        // ROS_INFO("Feature %d invdepth %f feature index %d", it.first, it.second, param_feature_id.size());
-        para_Feature[param_feature_id.size()][0] = it.second;
-        param_feature_id_to_index[it.first] = param_feature_id.size();
-        param_feature_id.push_back(it.first);
-        
-    }
+    if (landmark_selector.enabled())
+        landmark_selector.select(f_manager, Rs, ric, tic, overload.maxSolveCnt(), landmark_params);
+    else
+        f_manager.getDepthVector(overload.maxSolveCnt(), landmark_params);
 
 
     para_Td[0][0] = td;
@@ -1157,14 +1264,7 @@ void Estimator::double2vector()
         }
     }
 
-    std::map<int, double> deps;
-    for (unsigned int i = 0; i < param_feature_id.size(); i++) {
-        int _id = param_feature_id[i];
-        // ROS_INFO("Id %d depth %f", i, 1/para_Feature[i][0]);
-        deps[_id] = para_Feature[i][0];
-    }
-
-    f_manager.setDepth(deps);
+    f_manager.setDepth(landmark_params);
 
     if(USE_IMU)
         td = para_Td[0][0];
@@ -1223,6 +1323,7 @@ bool Estimator::failureDetection()
 void Estimator::optimization()
 {
     TicToc t_whole, t_prepare;
+    waitMarginalization();
     vector2double();
 
     ceres::Problem problem;
@@ -1283,11 +1384,11 @@ void Estimator::optimization()
     int f_m_cnt = 0;
 
     // for (auto &_it : f_manager.feature)
-    for (int _id : param_feature_id){
-        auto & it_per_id = f_manager.feature[_id];
+    for (int feature_index = 0; feature_index < landmark_params.size(); feature_index++){
+        auto & it_per_id = f_manager.feature[landmark_params.id(feature_index)];
         it_per_id.used_num = it_per_id.feature_per_frame.size();
  
-        int feature_index = param_feature_id_to_index[it_per_id.feature_id];
+        double * para_Feature = landmark_params.block(feature_index);
 
         int imu_i = it_per_id.start_frame, imu_j = imu_i - 1;
         
@@ -1306,12 +1407,12 @@ void Estimator::optimization()
                 // param_blocks.push_back(para_Pose[imu_i]);
                 // param_blocks.push_back(para_Pose[imu_j]);
                 // param_blocks.push_back(para_Ex_Pose[0]);
-                // param_blocks.push_back(para_Feature[feature_index]);
+                // param_blocks.push_back(para_Feature);
                 // param_blocks.push_back(para_Td[0]);
                 // ROS_INFO("Check ProjectionTwoFrameOneCamFactor");
                 // f_td->check(param_blocks.data());
                 // exit(-1);
-                problem.AddResidualBlock(f_td, loss_function, para_Pose[imu_i], para_Pose[imu_j], para_Ex_Pose[it_per_id.main_cam], para_Feature[feature_index], para_Td[0]);
+                problem.AddResidualBlock(f_td, loss_function, para_Pose[imu_i], para_Pose[imu_j], para_Ex_Pose[it_per_id.main_cam], para_Feature, para_Td[0]);
             }
 
             if(STEREO && it_per_frame.is_stereo)
@@ -1328,11 +1429,11 @@ void Estimator::optimization()
                     // param_blocks.push_back(para_Pose[imu_j]);
                     // param_blocks.push_back(para_Ex_Pose[0]);
                     // param_blocks.push_back(para_Ex_Pose[1]);
-                    // param_blocks.push_back(para_Feature[feature_index]);             
+                    // param_blocks.push_back(para_Feature);             
                     // param_blocks.push_back(para_Td[0]);
                     // ROS_INFO("Check ProjectionTwoFrameTwoCamFactor");
                     // f->check(param_blocks.data());
-                    problem.AddResidualBlock(f, loss_function, para_Pose[imu_i], para_Pose[imu_j], para_Ex_Pose[0], para_Ex_Pose[1], para_Feature[feature_index], para_Td[0]);
+                    problem.AddResidualBlock(f, loss_function, para_Pose[imu_i], para_Pose[imu_j], para_Ex_Pose[0], para_Ex_Pose[1], para_Feature, para_Td[0]);
                 }
                 else
                 {
@@ -1342,17 +1443,17 @@ void Estimator::optimization()
                     std::vector<double*> param_blocks;
                     param_blocks.push_back(para_Ex_Pose[0]);
                     param_blocks.push_back(para_Ex_Pose[1]);
-                    param_blocks.push_back(para_Feature[feature_index]);
+                    param_blocks.push_back(para_Feature);
                     param_blocks.push_back(para_Td[0]);
                     // ROS_INFO("Check ProjectionOneFrameTwoCamFactor ID: %d, index %d depth init %f Velocity L %f %f %f R %f %f %f", it_per_id.feature_id, feature_index, 
-                    //     para_Feature[feature_index][0],
+                    //     para_Feature[0],
                     //     it_per_id.feature_per_frame[0].velocity.x(), it_per_id.feature_per_frame[0].velocity.y(), it_per_id.feature_per_frame[0].velocity.z(),
                     //     it_per_frame.velocityRight.x(), it_per_frame.velocityRight.y(), it_per_frame.velocityRight.z()
                     //     );
                     // f->check(param_blocks.data());
                     // exit(-1);
 
-                    problem.AddResidualBlock(f, loss_function, para_Ex_Pose[0], para_Ex_Pose[1], para_Feature[feature_index], para_Td[0]);
+                    problem.AddResidualBlock(f, loss_function, para_Ex_Pose[0], para_Ex_Pose[1], para_Feature, para_Td[0]);
                 }
             
             }
@@ -1369,32 +1470,21 @@ void Estimator::optimization()
     options.linear_solver_type = ceres::DENSE_SCHUR;
     options.num_threads = 1;
     options.trust_region_strategy_type = ceres::DOGLEG;
-    options.max_num_iterations = NUM_ITERATIONS;
+    options.max_num_iterations = overload.numIterations();
     // options.check_gradients = true;
     //options.use_explicit_schur_complement = true;
     //options.minimizer_progress_to_stdout = true;
     //options.use_nonmonotonic_steps = true;
-    if (marginalization_flag == MARGIN_OLD)
-        options.max_solver_time_in_seconds = SOLVER_TIME * 4.0 / 5.0;
-    else
-        options.max_solver_time_in_seconds = SOLVER_TIME;
+    options.max_solver_time_in_seconds = solver_budget.solveTime(marginalization_flag == MARGIN_OLD);
+    solver_budget.recordPrepare(t_prepare.toc());
     TicToc t_solver;
     ceres::Solver::Summary summary;
     ceres::Solve(options, &problem, &summary);
+    solver_budget.recordSolve(t_solver.toc(), summary.iterations.size());
+    PERF_RECORD(PERF_SOLVE, t_solver.toc());
     //cout << summary.BriefReport() << endl;
     // std::cout << summary.FullReport() << endl;
-    static double sum_iterations = 0;
-    static double sum_solve_time = 0;
-    static int solve_count = 0;
-    sum_iterations = sum_iterations + summary.iterations.size();
-    sum_solve_time = sum_solve_time + summary.total_time_in_seconds;
-    solve_count += 1;
-
-    if (ENABLE_PERF_OUTPUT) {
-        ROS_INFO("AVG Iter %f time %fms Iterations : %d solver costs: %f \n", 
-            sum_iterations/solve_count, sum_solve_time*1000/solve_count,
-            static_cast<int>(summary.iterations.size()),  t_solver.toc());
-    }
+    ROS_DEBUG("Iterations : %d", static_cast<int>(summary.iterations.size()));
 
     double2vector();
     //printf("frame_count: %d \n", frame_count);
@@ -1406,6 +1496,7 @@ void Estimator::optimization()
     if (marginalization_flag == MARGIN_OLD)
     {
         MarginalizationInfo *marginalization_info = new MarginalizationInfo();
+        marginalization_info->sqrt_marginalization = SQRT_MARGINALIZATION;
         vector2double();
 
         if (last_marginalization_info && last_marginalization_info->valid)
@@ -1437,10 +1528,10 @@ void Estimator::optimization()
             }
         }
 
-        for (int _id : param_feature_id) {
-            auto & it_per_id = f_manager.feature[_id];
+        for (int feature_index = 0; feature_index < landmark_params.size(); feature_index++) {
+            auto & it_per_id = f_manager.feature[landmark_params.id(feature_index)];
 
-            int feature_index = param_feature_id_to_index[it_per_id.feature_id];
+            double * para_Feature = landmark_params.block(feature_index);
 
             int imu_i = it_per_id.start_frame, imu_j = imu_i - 1;
             if (imu_i != 0)
@@ -1457,7 +1548,7 @@ void Estimator::optimization()
                     ProjectionTwoFrameOneCamFactor *f_td = new ProjectionTwoFrameOneCamFactor(pts_i, pts_j, it_per_id.feature_per_frame[0].velocity, it_per_frame.velocity,
                                                                         it_per_id.feature_per_frame[0].cur_td, it_per_frame.cur_td);
                     ResidualBlockInfo *residual_block_info = new ResidualBlockInfo(f_td, loss_function,
-                                                                                    vector<double *>{para_Pose[imu_i], para_Pose[imu_j], para_Ex_Pose[it_per_id.main_cam], para_Feature[feature_index], para_Td[0]},
+                                                                                    vector<double *>{para_Pose[imu_i], para_Pose[imu_j], para_Ex_Pose[it_per_id.main_cam], para_Feature, para_Td[0]},
                                                                                     vector<int>{0, 3});
                     marginalization_info->addResidualBlockInfo(residual_block_info);
                 }
@@ -1469,7 +1560,7 @@ void Estimator::optimization()
                         ProjectionTwoFrameTwoCamFactor *f = new ProjectionTwoFrameTwoCamFactor(pts_i, pts_j_right, it_per_id.feature_per_frame[0].velocity, it_per_frame.velocityRight,
                                                                         it_per_id.feature_per_frame[0].cur_td, it_per_frame.cur_td);
                         ResidualBlockInfo *residual_block_info = new ResidualBlockInfo(f, loss_function,
-                                                                                        vector<double *>{para_Pose[imu_i], para_Pose[imu_j], para_Ex_Pose[it_per_id.main_cam], para_Ex_Pose[1], para_Feature[feature_index], para_Td[0]},
+                                                                                        vector<double *>{para_Pose[imu_i], para_Pose[imu_j], para_Ex_Pose[it_per_id.main_cam], para_Ex_Pose[1], para_Feature, para_Td[0]},
                                                                                         vector<int>{0, 4});
                         marginalization_info->addResidualBlockInfo(residual_block_info);
                     }
@@ -1478,7 +1569,7 @@ void Estimator::optimization()
                         ProjectionOneFrameTwoCamFactor *f = new ProjectionOneFrameTwoCamFactor(pts_i, pts_j_right, it_per_id.feature_per_frame[0].velocity, it_per_frame.velocityRight,
                                                                         it_per_id.feature_per_frame[0].cur_td, it_per_frame.cur_td);
                         ResidualBlockInfo *residual_block_info = new ResidualBlockInfo(f, loss_function,
-                                                                                        vector<double *>{para_Ex_Pose[0], para_Ex_Pose[1], para_Feature[feature_index], para_Td[0]},
+                                                                                        vector<double *>{para_Ex_Pose[0], para_Ex_Pose[1], para_Feature, para_Td[0]},
                                                                                         vector<int>{2});
                         marginalization_info->addResidualBlockInfo(residual_block_info);
                     }
@@ -1490,10 +1581,6 @@ void Estimator::optimization()
         marginalization_info->preMarginalize();
 
         // ROS_INFO("pre marginalization %f ms", t_pre_margin.toc());
-        
-        TicToc t_margin;
-        marginalization_info->marginalize();
-        // ROS_INFO("marginalization %f ms", t_margin.toc());
 
         std::unordered_map<long, double *> addr_shift;
         for (int i = 1; i <= WINDOW_SIZE; i++)
@@ -1507,13 +1594,7 @@ void Estimator::optimization()
 
         addr_shift[reinterpret_cast<long>(para_Td[0])] = para_Td[0];
 
-        vector<double *> parameter_blocks = marginalization_info->getParameterBlocks(addr_shift);
-
-        if (last_marginalization_info)
-            delete last_marginalization_info;
-        last_marginalization_info = marginalization_info;
-        last_marginalization_parameter_blocks = parameter_blocks;
-        
+        finishMarginalization(marginalization_info, addr_shift);
     }
     else
     {
@@ -1522,6 +1603,7 @@ void Estimator::optimization()
         {
 
             MarginalizationInfo *marginalization_info = new MarginalizationInfo();
+            marginalization_info->sqrt_marginalization = SQRT_MARGINALIZATION;
             vector2double();
             if (last_marginalization_info && last_marginalization_info->valid)
             {
@@ -1541,15 +1623,7 @@ void Estimator::optimization()
                 marginalization_info->addResidualBlockInfo(residual_block_info);
             }
 
-            TicToc t_pre_margin;
-            // ROS_INFO("begin marginalization");
             marginalization_info->preMarginalize();
-            ROS_INFO("end pre marginalization, %f ms", t_pre_margin.toc());
-
-            TicToc t_margin;
-            // ROS_INFO("begin marginalization");
-            marginalization_info->marginalize();
-            ROS_INFO("end marginalization, %f ms", t_margin.toc());
             
             std::unordered_map<long, double *> addr_shift;
             for (int i = 0; i <= WINDOW_SIZE; i++)
@@ -1574,21 +1648,159 @@ void Estimator::optimization()
 
             addr_shift[reinterpret_cast<long>(para_Td[0])] = para_Td[0];
 
-            
-            vector<double *> parameter_blocks = marginalization_info->getParameterBlocks(addr_shift);
-            if (last_marginalization_info)
-                delete last_marginalization_info;
-            last_marginalization_info = marginalization_info;
-            last_marginalization_parameter_blocks = parameter_blocks;
-            
+            finishMarginalization(marginalization_info, addr_shift);
         }
     }
-    if(ENABLE_PERF_OUTPUT) {
-        ROS_INFO("whole marginalization costs: %fms \n", t_whole_marginalization.toc());
-    }
+    solver_budget.recordMarginalization(t_whole_marginalization.toc());
+    PERF_RECORD(PERF_MARGINALIZE, t_whole_marginalization.toc());
     //printf("whole time for ceres: %f \n", t_whole.toc());
 }
 
+//Non-keyframes are dropped right after the solve, so they only need the newest state refined.
+//The window is solved in full when the prior still holds the second newest pose.
+bool Estimator::motionOnlyFrame()
+{
+    if (!KEYFRAME_ONLY_BA || marginalization_flag != MARGIN_SECOND_NEW || frame_count != WINDOW_SIZE)
+        return false;
+    return !last_marginalization_info ||
+        !std::count(std::begin(last_marginalization_parameter_blocks), std::end(last_marginalization_parameter_blocks), para_Pose[WINDOW_SIZE - 1]);
+}
+
+//Refine the newest pose and speed bias with IMU and reprojection factors,
+//everything else in the window is held fixed.
+void Estimator::motionOnlyOptimization()
+{
+    TicToc t_prepare;
+    vector2double();
+
+    int j = frame_count;
+    ceres::Problem problem;
+    ceres::LossFunction *loss_function = new ceres::HuberLoss(1.0);
+    ceres::LocalParameterization *local_parameterization = new PoseLocalParameterization();
+    problem.AddParameterBlock(para_Pose[j], SIZE_POSE, local_parameterization);
+    if(USE_IMU)
+    {
+        problem.AddParameterBlock(para_SpeedBias[j], SIZE_SPEEDBIAS);
+        if (pre_integrations[j]->sum_dt < 10.0)
+        {
+            IMUFactor* imu_factor = new IMUFactor(pre_integrations[j]);
+            problem.AddResidualBlock(imu_factor, NULL, para_Pose[j - 1], para_SpeedBias[j - 1], para_Pose[j], para_SpeedBias[j]);
+        }
+    }
+
+    int f_m_cnt = 0;
+    for (int feature_index = 0; feature_index < landmark_params.size(); feature_index++) {
+        auto & it_per_id = f_manager.feature[landmark_params.id(feature_index)];
+        int imu_i = it_per_id.start_frame;
+        if (imu_i == j || it_per_id.endFrame() != j)
+            continue;
+
+        double * para_Feature = landmark_params.block(feature_index);
+        auto & first = it_per_id.feature_per_frame[0];
+        auto & it_per_frame = it_per_id.feature_per_frame.back();
+
+        ProjectionTwoFrameOneCamFactor *f_td = new ProjectionTwoFrameOneCamFactor(first.point, it_per_frame.point, first.velocity, it_per_frame.velocity,
+                                                        first.cur_td, it_per_frame.cur_td);
+        problem.AddResidualBlock(f_td, loss_function, para_Pose[imu_i], para_Pose[j], para_Ex_Pose[it_per_id.main_cam], para_Feature, para_Td[0]);
+        if(STEREO && it_per_frame.is_stereo)
+        {
+            ProjectionTwoFrameTwoCamFactor *f = new ProjectionTwoFrameTwoCamFactor(first.point, it_per_frame.pointRight, first.velocity, it_per_frame.velocityRight,
+                                                        first.cur_td, it_per_frame.cur_td);
+            problem.AddResidualBlock(f, loss_function, para_Pose[imu_i], para_Pose[j], para_Ex_Pose[0], para_Ex_Pose[1], para_Feature, para_Td[0]);
+        }
+        f_m_cnt++;
+    }
+    ROS_DEBUG("motion only visual measurement count: %d", f_m_cnt);
+
+    vector<double *> blocks;
+    problem.GetParameterBlocks(&blocks);
+    for (auto block : blocks)
+    {
+        if (block != para_Pose[j] && block != para_SpeedBias[j])
+            problem.SetParameterBlockConstant(block);
+    }
+
+    ceres::Solver::Options options;
+    options.linear_solver_type = ceres::DENSE_QR;
+    options.num_threads = 1;
+    options.trust_region_strategy_type = ceres::DOGLEG;
+    options.max_num_iterations = overload.numIterations();
+    options.max_solver_time_in_seconds = solver_budget.solveTime(false);
+    solver_budget.recordPrepare(t_prepare.toc());
+    TicToc t_solver;
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, &problem, &summary);
+    solver_budget.recordSolve(t_solver.toc(), summary.iterations.size());
+    PERF_RECORD(PERF_MOTION_ONLY, t_solver.toc());
+
+    //The rest of the window did not move, so no yaw realignment as in double2vector
+    Rs[j] = Quaterniond(para_Pose[j][6], para_Pose[j][3], para_Pose[j][4], para_Pose[j][5]).normalized().toRotationMatrix();
+    Ps[j] = Vector3d(para_Pose[j][0], para_Pose[j][1], para_Pose[j][2]);
+    if(USE_IMU)
+    {
+        Vs[j] = Vector3d(para_SpeedBias[j][0], para_SpeedBias[j][1], para_SpeedBias[j][2]);
+        Bas[j] = Vector3d(para_SpeedBias[j][3], para_SpeedBias[j][4], para_SpeedBias[j][5]);
+        Bgs[j] = Vector3d(para_SpeedBias[j][6], para_SpeedBias[j][7], para_SpeedBias[j][8]);
+    }
+
+    //No setDepth here: collected landmarks keep their solved depth instead of being re-triangulated
+    for (int i = 0; i < landmark_params.size(); i++)
+        f_manager.feature[landmark_params.id(i)].need_triangulation = false;
+}
+
+void Estimator::finishMarginalization(MarginalizationInfo *marginalization_info, std::unordered_map<long, double *> &addr_shift)
+{
+    pending_marginalization_info = marginalization_info;
+    if (ASYNC_MARGINALIZATION == 2)
+    {
+        verify_marginalization_info = marginalization_info->shareLinearization();
+        verify_marginalization_parameter_blocks = verify_marginalization_info->computePrior(addr_shift);
+    }
+
+    if (ASYNC_MARGINALIZATION)
+    {
+        marginalization_job = std::async(std::launch::async, [this, addr_shift]() mutable {
+            pending_marginalization_parameter_blocks = pending_marginalization_info->computePrior(addr_shift);
+        });
+    }
+    else
+    {
+        pending_marginalization_parameter_blocks = marginalization_info->computePrior(addr_shift);
+        waitMarginalization();
+    }
+}
+
+//Install the pending prior, must run before anything reads last_marginalization_info
+void Estimator::waitMarginalization()
+{
+    if (pending_marginalization_info == nullptr)
+        return;
+    if (marginalization_job.valid())
+        marginalization_job.get();
+
+    if (verify_marginalization_info != nullptr)
+    {
+        marginalization_verified++;
+        if (verify_marginalization_parameter_blocks != pending_marginalization_parameter_blocks ||
+            !pending_marginalization_info->samePrior(*verify_marginalization_info))
+        {
+            marginalization_mismatch++;
+            ROS_ERROR("[Marginalization] asynchronous prior differs from synchronous one, %ld of %ld",
+                marginalization_mismatch, marginalization_verified);
+        }
+        else if (marginalization_verified % 100 == 0)
+            ROS_INFO("[Marginalization] %ld asynchronous priors verified, %ld mismatch", marginalization_verified, marginalization_mismatch);
+        delete verify_marginalization_info;
+        verify_marginalization_info = nullptr;
+    }
+
+    if (last_marginalization_info)
+        delete last_marginalization_info;
+    last_marginalization_info = pending_marginalization_info;
+    last_marginalization_parameter_blocks = pending_marginalization_parameter_blocks;
+    pending_marginalization_info = nullptr;
+}
+
 void Estimator::slideWindow()
 {
     TicToc t_margin;
@@ -1599,24 +1811,15 @@ void Estimator::slideWindow()
         back_P0 = Ps[0];
         if (frame_count == WINDOW_SIZE)
         {
-            for (int i = 0; i < WINDOW_SIZE; i++)
-            {
-                Headers[i] = Headers[i + 1];
-                Rs[i].swap(Rs[i + 1]);
-                Ps[i].swap(Ps[i + 1]);
-                if(USE_IMU)
-                {
-                    std::swap(pre_integrations[i], pre_integrations[i + 1]);
+            //Oldest slots become the newest ones
+            Headers.rotate();
+            Rs.rotate();
+            Ps.rotate();
+            Vs.rotate();
+            Bas.rotate();
+            Bgs.rotate();
+            pre_integrations.rotate();
 
-                    dt_buf[i].swap(dt_buf[i + 1]);
-                    linear_acceleration_buf[i].swap(linear_acceleration_buf[i + 1]);
-                    angular_velocity_buf[i].swap(angular_velocity_buf[i + 1]);
-
-                    Vs[i].swap(Vs[i + 1]);
-                    Bas[i].swap(Bas[i + 1]);
-                    Bgs[i].swap(Bgs[i + 1]);
-                }
-            }
             Headers[WINDOW_SIZE] = Headers[WINDOW_SIZE - 1];
             Ps[WINDOW_SIZE] = Ps[WINDOW_SIZE - 1];
             Rs[WINDOW_SIZE] = Rs[WINDOW_SIZE - 1];
@@ -1627,19 +1830,17 @@ void Estimator::slideWindow()
                 Bas[WINDOW_SIZE] = Bas[WINDOW_SIZE - 1];
                 Bgs[WINDOW_SIZE] = Bgs[WINDOW_SIZE - 1];
 
-                delete pre_integrations[WINDOW_SIZE];
-                pre_integrations[WINDOW_SIZE] = new IntegrationBase{acc_0, gyr_0, Bas[WINDOW_SIZE], Bgs[WINDOW_SIZE]};
-
-                dt_buf[WINDOW_SIZE].clear();
-                linear_acceleration_buf[WINDOW_SIZE].clear();
-                angular_velocity_buf[WINDOW_SIZE].clear();
+                resetPreIntegration(WINDOW_SIZE);
             }
 
-            if (true || solver_flag == INITIAL)
+            if (solver_flag == INITIAL)
             {
                 map<double, ImageFrame>::iterator it_0;
                 it_0 = all_image_frame.find(t_0);
                 delete it_0->second.pre_integration;
+                it_0->second.pre_integration = nullptr;
+                for (auto it = all_image_frame.begin(); it != it_0; it++)
+                    delete it->second.pre_integration;
                 all_image_frame.erase(all_image_frame.begin(), it_0);
             }
             slideWindowOld();
@@ -1655,35 +1856,29 @@ void Estimator::slideWindow()
 
             if(USE_IMU)
             {
-                for (unsigned int i = 0; i < dt_buf[frame_count].size(); i++)
-                {
-                    double tmp_dt = dt_buf[frame_count][i];
-                    Vector3d tmp_linear_acceleration = linear_acceleration_buf[frame_count][i];
-                    Vector3d tmp_angular_velocity = angular_velocity_buf[frame_count][i];
-
-                    pre_integrations[frame_count - 1]->push_back(tmp_dt, tmp_linear_acceleration, tmp_angular_velocity);
-
-                    dt_buf[frame_count - 1].push_back(tmp_dt);
-                    linear_acceleration_buf[frame_count - 1].push_back(tmp_linear_acceleration);
-                    angular_velocity_buf[frame_count - 1].push_back(tmp_angular_velocity);
-                }
+                //Compose the dropped frame's preintegration into the previous one
+                pre_integrations[frame_count - 1]->append(*pre_integrations[frame_count]);
 
                 Vs[frame_count - 1] = Vs[frame_count];
                 Bas[frame_count - 1] = Bas[frame_count];
                 Bgs[frame_count - 1] = Bgs[frame_count];
 
-                delete pre_integrations[WINDOW_SIZE];
-                pre_integrations[WINDOW_SIZE] = new IntegrationBase{acc_0, gyr_0, Bas[WINDOW_SIZE], Bgs[WINDOW_SIZE]};
-
-                dt_buf[WINDOW_SIZE].clear();
-                linear_acceleration_buf[WINDOW_SIZE].clear();
-                angular_velocity_buf[WINDOW_SIZE].clear();
+                resetPreIntegration(WINDOW_SIZE);
             }
             slideWindowNew();
         }
     }
 }
 
+//Reuse the preintegration object of slot i for a new frame
+void Estimator::resetPreIntegration(int i)
+{
+    if (pre_integrations[i] == nullptr)
+        pre_integrations[i] = new IntegrationBase{acc_0, gyr_0, Bas[i], Bgs[i]};
+    else
+        pre_integrations[i]->reset(acc_0, gyr_0, Bas[i], Bgs[i]);
+}
+
 void Estimator::slideWindowNew()
 {
     sum_of_front++;
@@ -1727,7 +1922,8 @@ void Estimator::getPoseInWorldFrame(int index, Eigen::Matrix4d &T)
 void Estimator::predictPtsInNextFrame()
 {
     //printf("predict pts in next frame\n");
-    if(frame_count < 2)
+    //Fisheye frontend predicts from gyro for each tracked image instead, pinhole inputs never do
+    if(frame_count < 2 || (FISHEYE && GYRO_PREDICT && USE_IMU))
         return;
     // predict next pose. Assume constant velocity motion
     Eigen::Matrix4d curT, prevT, nextT;
@@ -1762,6 +1958,53 @@ void Estimator::predictPtsInNextFrame()
     featureTracker->setPrediction(predictPts, predictPts1);
 }
 
+//Body rotation from the last tracked image to image t, integrated from gyro samples
+bool Estimator::trackRotation(double t, Eigen::Matrix3d & R)
+{
+    std::lock_guard<std::mutex> lock(mBuf);
+    double t0 = prevTrackTime;
+    prevTrackTime = t + td;
+    if (t0 < 0) {
+        return false;
+    }
+
+    Eigen::Vector3d bg = fast_prop_inited ? latest_Bg : Eigen::Vector3d::Zero();
+    Eigen::Quaterniond q = Eigen::Quaterniond::Identity();
+    double t_last = t0;
+    while (!trackGyrBuf.empty() && trackGyrBuf.front().first <= prevTrackTime) {
+        auto & gyr = trackGyrBuf.front();
+        if (gyr.first > t_last) {
+            q = q * Utility::deltaQ((gyr.second - bg) * (gyr.first - t_last));
+            t_last = gyr.first;
+        }
+        trackGyrBuf.pop_front();
+    }
+
+    if (t_last == t0) {
+        return false;
+    }
+
+    //Hold the next sample up to the image time
+    if (!trackGyrBuf.empty() && t_last < prevTrackTime) {
+        q = q * Utility::deltaQ((trackGyrBuf.front().second - bg) * (prevTrackTime - t_last));
+    }
+    R = q.normalized().toRotationMatrix();
+    return true;
+}
+
+//Rotate the last tracked bearings into image t as LK initial flow
+void Estimator::predictPtsByGyro(double t)
+{
+    Eigen::Matrix3d R;
+    if (!(GYRO_PREDICT && USE_IMU) || !trackRotation(t, R)) {
+        return;
+    }
+
+    Eigen::Matrix3d R_c0 = ric[0].transpose() * R * ric[0];
+    Eigen::Matrix3d R_c1 = NUM_OF_CAM > 1 ? ric[1].transpose() * R * ric[1] : R_c0;
+    featureTracker->setRotationPrediction(R_c0, R_c1);
+}
+
 double Estimator::reprojectionError(Matrix3d &Ri, Vector3d &Pi, Matrix3d &rici, Vector3d &tici,
                                  Matrix3d &Rj, Vector3d &Pj, Matrix3d &ricj, Vector3d &ticj, 
                                  double depth, Vector3d &uvi, Vector3d &uvj)
@@ -1773,7 +2016,7 @@ double Estimator::reprojectionError(Matrix3d &Ri, Vector3d &Pi, Matrix3d &rici,
 
 void Estimator::outliersRejection(set<int> &removeIndex)
 {
-    for (int _id : param_feature_id) {
+    for (int _id : landmark_params.featureIds()) {
         auto & it_per_id = f_manager.feature[_id];
         double err = 0;
         int errCnt = 0;
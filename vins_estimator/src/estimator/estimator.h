@@ -11,19 +11,27 @@
  
 #include <thread>
 #include <mutex>
+#include <future>
+#include <atomic>
 #include <std_msgs/Header.h>
 #include <std_msgs/Float32.h>
 #include <ceres/ceres.h>
 #include <unordered_map>
 #include <queue>
+#include <deque>
 #include <opencv2/core/eigen.hpp>
 #include <eigen3/Eigen/Dense>
 #include <eigen3/Eigen/Geometry>
 
 #include "parameters.h"
 #include "feature_manager.h"
+#include "overload_controller.h"
+#include "solver_budget.h"
+#include "landmark_selector.h"
 #include "../utility/utility.h"
 #include "../utility/tic_toc.h"
+#include "../utility/bounded_queue.h"
+#include "../utility/window_buffer.h"
 #include "../initial/solve_5pts.h"
 #include "../initial/initial_sfm.h"
 #include "../initial/initial_alignment.h"
@@ -45,21 +53,28 @@ class Estimator
 {
   public:
     Estimator();
+    ~Estimator();
 
     void setParameter();
+    //Clear the state and reload parameters on the process thread before its next frame
+    void requestRestart();
 
     // interface
     void initFirstPose(Eigen::Vector3d p, Eigen::Matrix3d r);
     void inputIMU(double t, const Vector3d &linearAcceleration, const Vector3d &angularVelocity);
-    void inputFeature(double t, const FeatureFrame &featureFrame);
+    void inputFeature(double t, FeatureFrame &&featureFrame);
     void inputImage(double t, const cv::Mat &_img, const cv::Mat &_img1 = cv::Mat());
 
     bool is_next_odometry_frame();
     void inputFisheyeImage(double t, const CvCudaImages & up_imgs, const CvCudaImages & down_imgs, bool is_blank_init = false);
     void inputFisheyeImage(double t, const CvImages & fisheye_imgs_up, const CvImages & fisheye_imgs_down);
+    void inputFisheyeRawImage(double t, const cv::Mat & raw_up, const cv::Mat & raw_down,
+        const CvImages & fisheye_imgs_up, const CvImages & fisheye_imgs_down);
     void processIMU(double t, double dt, const Vector3d &linear_acceleration, const Vector3d &angular_velocity);
     void processImage(const FeatureFrame &image, const double header);
     void processMeasurements();
+    //No odometry is published for t, so its depth images must not be paired with a later pose
+    void dropDepthFrame(double t);
 
     void processDepthGeneration();
 
@@ -68,10 +83,16 @@ class Estimator
     bool initialStructure();
     bool visualInitialAlign();
     bool relativePose(Matrix3d &relative_R, Vector3d &relative_T, int &l);
+    void releaseImageFrames();
     void slideWindow();
+    void resetPreIntegration(int i);
     void slideWindowNew();
     void slideWindowOld();
     void optimization();
+    void finishMarginalization(MarginalizationInfo *marginalization_info, std::unordered_map<long, double *> &addr_shift);
+    void waitMarginalization();
+    bool motionOnlyFrame();
+    void motionOnlyOptimization();
     void vector2double();
     void double2vector();
     bool failureDetection();
@@ -80,6 +101,8 @@ class Estimator
     void getPoseInWorldFrame(Eigen::Matrix4d &T);
     void getPoseInWorldFrame(int index, Eigen::Matrix4d &T);
     void predictPtsInNextFrame();
+    bool trackRotation(double t, Eigen::Matrix3d & R);
+    void predictPtsByGyro(double t);
     void outliersRejection(set<int> &removeIndex);
     double reprojectionError(Matrix3d &Ri, Vector3d &Pi, Matrix3d &rici, Vector3d &tici,
                                      Matrix3d &Rj, Vector3d &Pj, Matrix3d &ricj, Vector3d &ticj, 
@@ -105,13 +128,22 @@ class Estimator
     std::mutex odomBuf;
     queue<pair<double, Eigen::Vector3d>> accBuf;
     queue<pair<double, Eigen::Vector3d>> gyrBuf;
-    queue<pair<double,FeatureFrame >> featureBuf;
+    //Gyro samples since the last tracked image, for the frontend rotation prior
+    std::deque<pair<double, Eigen::Vector3d>> trackGyrBuf;
+    double prevTrackTime = -1;
+    //Bounded with backpressure: tracking waits when the backend falls behind
+    BoundedQueue<pair<double,FeatureFrame >> featureBuf;
+    OverloadController overload;
+    SolverBudget solver_budget;
+    LandmarkSelector landmark_selector;
     double prevTime, curTime;
     bool openExEstimation;
 
     std::thread trackThread;
     std::thread processThread;
     std::thread depthThread;
+    std::atomic<bool> threads_running{true};
+    std::atomic<bool> restart_requested{false};
 
     FeatureTracker::BaseFeatureTracker * featureTracker = nullptr;
 
@@ -122,24 +154,22 @@ class Estimator
     Matrix3d ric[2];
     Vector3d tic[2];
 
-    Vector3d        Ps[(WINDOW_SIZE + 1)];
-    Vector3d        Vs[(WINDOW_SIZE + 1)];
-    Matrix3d        Rs[(WINDOW_SIZE + 1)];
-    Vector3d        Bas[(WINDOW_SIZE + 1)];
-    Vector3d        Bgs[(WINDOW_SIZE + 1)];
+    //Window slots are ring buffers, sliding moves their heads
+    WindowVector3d  Ps;
+    WindowVector3d  Vs;
+    WindowMatrix3d  Rs;
+    WindowVector3d  Bas;
+    WindowVector3d  Bgs;
     double td;
 
     Matrix3d back_R0, last_R, last_R0;
     Vector3d back_P0, last_P, last_P0;
-    double Headers[(WINDOW_SIZE + 1)];
+    WindowBuffer<double, WINDOW_SIZE + 1> Headers;
 
-    IntegrationBase *pre_integrations[(WINDOW_SIZE + 1)] = {0};
+    //Pooled, a slot is reset in place when it becomes the newest one
+    WindowBuffer<IntegrationBase *, WINDOW_SIZE + 1> pre_integrations;
     Vector3d acc_0, gyr_0;
 
-    vector<double> dt_buf[(WINDOW_SIZE + 1)];
-    vector<Vector3d> linear_acceleration_buf[(WINDOW_SIZE + 1)];
-    vector<Vector3d> angular_velocity_buf[(WINDOW_SIZE + 1)];
-
     int frame_count;
     int sum_of_outlier, sum_of_back, sum_of_front, sum_of_invalid;
     int inputImageCnt;
@@ -158,13 +188,13 @@ class Estimator
     vector<Vector3d> margin_cloud;
     vector<Vector3d> key_poses;
     double initial_timestamp;
+    //Wall time since the last clearState, reported as time to first pose
+    TicToc t_restart;
 
 
     double para_Pose[WINDOW_SIZE + 1][SIZE_POSE];
     double para_SpeedBias[WINDOW_SIZE + 1][SIZE_SPEEDBIAS];
-    double para_Feature[NUM_OF_F][SIZE_FEATURE];
-    std::vector<int> param_feature_id;
-    std::map<int, int> param_feature_id_to_index;
+    LandmarkParams landmark_params;
     double para_Ex_Pose[2][SIZE_POSE];
     double para_Retrive_Pose[SIZE_POSE];
     double para_Td[1][1];
@@ -174,6 +204,15 @@ class Estimator
 
     MarginalizationInfo *last_marginalization_info = nullptr;
     vector<double *> last_marginalization_parameter_blocks;
+    //Prior computed in the background, replaces last_marginalization_info in waitMarginalization()
+    MarginalizationInfo *pending_marginalization_info = nullptr;
+    vector<double *> pending_marginalization_parameter_blocks;
+    MarginalizationInfo *verify_marginalization_info = nullptr;
+    vector<double *> verify_marginalization_parameter_blocks;
+    long marginalization_verified = 0;
+    long marginalization_mismatch = 0;
+    //Declared after the state the job writes, so it is destroyed (and waited for) first
+    std::future<void> marginalization_job;
 
     map<double, ImageFrame> all_image_frame;
     IntegrationBase *tmp_pre_integration = nullptr;
@@ -191,6 +230,8 @@ class Estimator
     DepthCamManager * depth_cam_manager = nullptr;
 
     queue<double> fisheye_imgs_stampBuf;
+    //Frames the backend dropped under overload, their depth images are skipped
+    set<double> dropped_depth_stamps;
 
     queue<std::vector<cv::cuda::GpuMat>> fisheye_imgs_upBuf_cuda;
     queue<std::vector<cv::cuda::GpuMat>> fisheye_imgs_downBuf_cuda;
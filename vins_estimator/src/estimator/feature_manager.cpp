@@ -14,8 +14,8 @@ int FeaturePerId::endFrame()
     return start_frame + feature_per_frame.size() - 1;
 }
 
-FeatureManager::FeatureManager(Matrix3d _Rs[])
-    : Rs(_Rs)
+FeatureManager::FeatureManager(const WindowMatrix3d &_Rs)
+    : Rs(&_Rs)
 {
     for (int i = 0; i < NUM_OF_CAM; i++)
         ric[i].setIdentity();
@@ -136,12 +136,45 @@ bool FeatureManager::addFeatureCheckParallax(int frame_count, const FeatureFrame
     }
 }
 
+bool FeatureManager::isKeyframeCandidate(int frame_count, const FeatureFrame &image)
+{
+    //Same tests as addFeatureCheckParallax, but parallax is taken between image and the newest frame in window
+    int track_num = 0, new_num = 0, long_num = 0;
+    double parallax_sum = 0;
+    int parallax_num = 0;
+    for (auto &id_pts : image)
+    {
+        auto it = feature.find(id_pts.first);
+        if (it == feature.end()) {
+            new_num++;
+            continue;
+        }
+        auto & it_per_id = it->second;
+        track_num++;
+        if (it_per_id.feature_per_frame.size() >= 3)
+            long_num++;
+        if (it_per_id.endFrame() == frame_count - 1) {
+            Vector3d pt = id_pts.second[0].second.head<3>();
+            parallax_sum += (it_per_id.feature_per_frame.back().point - pt).norm();
+            parallax_num++;
+        }
+    }
+
+    if (frame_count < 2 || track_num < 20 || long_num < KEYFRAME_LONGTRACK_THRES || new_num > 0.5 * track_num || parallax_num == 0) {
+        return true;
+    }
+    return parallax_sum / parallax_num >= MIN_PARALLAX;
+}
+
 vector<pair<Vector3d, Vector3d>> FeatureManager::getCorresponding(int frame_count_l, int frame_count_r)
 {
     vector<pair<Vector3d, Vector3d>> corres;
     for (auto &_it : feature)
     {
         auto & it = _it.second;
+        //Points of camera 0, features first seen by the down camera are in another frame
+        if (it.main_cam != 0)
+            continue;
         if (it.start_frame <= frame_count_l && it.endFrame() >= frame_count_r)
         {
             Vector3d a = Vector3d::Zero(), b = Vector3d::Zero();
@@ -158,12 +191,12 @@ vector<pair<Vector3d, Vector3d>> FeatureManager::getCorresponding(int frame_coun
     return corres;
 }
 
-void FeatureManager::setDepth(std::map<int, double> deps)
+void FeatureManager::setDepth(LandmarkParams &params)
 {
-    for (auto &it : deps)
+    for (int i = 0; i < params.size(); i++)
     {
-        int _id = it.first;
-        double depth = it.second;
+        int _id = params.id(i);
+        double depth = params.block(i)[0];
         auto & it_per_id = feature[_id];
 
         it_per_id.used_num = it_per_id.feature_per_frame.size();
@@ -206,18 +239,26 @@ void FeatureManager::clearDepth()
     }
 }
 
-std::map<int, double> FeatureManager::getDepthVector()
+void FeatureManager::setInvDepth(LandmarkParams &params, const FeaturePerId &it_per_id)
+{
+    double *para = params.find(it_per_id.feature_id);
+    if (para == nullptr)
+        para = params.add(it_per_id.feature_id);
+    para[0] = 1. / it_per_id.estimated_depth;
+}
+
+void FeatureManager::getDepthVector(int max_solve_cnt, LandmarkParams &params)
 {
     //This function gives actually points for solving; We only use oldest max_solve_cnt point, oldest pts has good track
     //As for some feature point not solve all the time; we do re triangulate on it
-    std::map<int, double> dep_vec;
+    params.clear();
     for (auto &_it : feature) {
         auto & it_per_id = _it.second;
         it_per_id.used_num = it_per_id.feature_per_frame.size();
         bool id_in_outouliers = outlier_features.find(it_per_id.feature_id) != outlier_features.end();
 
-        if(it_per_id.is_stereo && it_per_id.used_num >= 2 && dep_vec.size() < MAX_SOLVE_CNT &&  it_per_id.good_for_solving && !id_in_outouliers) {
-            dep_vec[it_per_id.feature_id] = 1. / it_per_id.estimated_depth;
+        if(it_per_id.is_stereo && it_per_id.used_num >= 2 && params.size() < max_solve_cnt &&  it_per_id.good_for_solving && !id_in_outouliers) {
+            setInvDepth(params, it_per_id);
             ft->setFeatureStatus(it_per_id.feature_id, 3);
         } else {
             it_per_id.need_triangulation = true;
@@ -228,16 +269,14 @@ std::map<int, double> FeatureManager::getDepthVector()
         it_per_id.used_num = it_per_id.feature_per_frame.size();
         bool id_in_outouliers = outlier_features.find(it_per_id.feature_id) != outlier_features.end();
 
-        if(dep_vec.size() < MAX_SOLVE_CNT && it_per_id.used_num >= 4 
+        if(params.size() < max_solve_cnt && it_per_id.used_num >= 4 
             && it_per_id.good_for_solving && !id_in_outouliers) {
-            dep_vec[it_per_id.feature_id] = 1. / it_per_id.estimated_depth;
+            setInvDepth(params, it_per_id);
             ft->setFeatureStatus(it_per_id.feature_id, 3);
         } else {
             it_per_id.need_triangulation = true;
         }
     }
-
-    return dep_vec;
 }
 
 
@@ -357,7 +396,7 @@ bool FeatureManager::solvePoseByPnP(Eigen::Matrix3d &R, Eigen::Vector3d &P,
     return true;
 }
 
-void FeatureManager::initFramePoseByPnP(int frameCnt, Vector3d Ps[], Matrix3d Rs[], Vector3d tic[], Matrix3d ric[])
+void FeatureManager::initFramePoseByPnP(int frameCnt, WindowVector3d &Ps, WindowMatrix3d &Rs, Vector3d tic[], Matrix3d ric[])
 {
 
     if(frameCnt > 0)
@@ -402,7 +441,7 @@ void FeatureManager::initFramePoseByPnP(int frameCnt, Vector3d Ps[], Matrix3d Rs
     }
 }
 
-void FeatureManager::triangulate(int frameCnt, Vector3d Ps[], Matrix3d Rs[], Vector3d tic[], Matrix3d ric[])
+void FeatureManager::triangulate(int frameCnt, WindowVector3d &Ps, WindowMatrix3d &Rs, Vector3d tic[], Matrix3d ric[])
 {
     for (auto &_it : feature) {
         auto & it_per_id = _it.second;
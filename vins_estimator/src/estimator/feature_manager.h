@@ -26,6 +26,8 @@ using namespace Eigen;
 
 #include "parameters.h"
 #include "../utility/tic_toc.h"
+#include "../utility/window_buffer.h"
+#include "landmark_params.h"
 #include "../featureTracker/feature_tracker.h"
 #define KEYFRAME_LONGTRACK_THRES 20
 
@@ -98,25 +100,27 @@ class FeatureManager
 {
   public:
     FeatureTracker::BaseFeatureTracker * ft = nullptr;
-    FeatureManager(Matrix3d _Rs[]);
+    FeatureManager(const WindowMatrix3d &_Rs);
 
     void setRic(Matrix3d _ric[]);
     void clearState();
     int getFeatureCount();
     bool addFeatureCheckParallax(int frame_count, const FeatureFrame &image, double td);
+    //Read only estimate of whether image is worth adding, used to skip frames under overload
+    bool isKeyframeCandidate(int frame_count, const FeatureFrame &image);
     vector<pair<Vector3d, Vector3d>> getCorresponding(int frame_count_l, int frame_count_r);
     //void updateDepth(const VectorXd &x);
-    void setDepth(std::map<int, double> deps);
+    void setDepth(LandmarkParams &params);
     void removeFailures();
     void clearDepth();
-    std::map<int, double> getDepthVector();
-    void triangulate(int frameCnt, Vector3d Ps[], Matrix3d Rs[], Vector3d tic[], Matrix3d ric[]);
+    void getDepthVector(int max_solve_cnt, LandmarkParams &params);
+    void triangulate(int frameCnt, WindowVector3d &Ps, WindowMatrix3d &Rs, Vector3d tic[], Matrix3d ric[]);
     void triangulatePoint(Eigen::Matrix<double, 3, 4> &Pose0, Eigen::Matrix<double, 3, 4> &Pose1,
                             Eigen::Vector2d &point0, Eigen::Vector2d &point1, Eigen::Vector3d &point_3d);
     void triangulatePoint3DPts(Eigen::Matrix<double, 3, 4> &Pose0, Eigen::Matrix<double, 3, 4> &Pose1,
                             Eigen::Vector3d &point0, Eigen::Vector3d &point1, Eigen::Vector3d &point_3d);
     double triangulatePoint3DPts(vector<Eigen::Matrix<double, 3, 4>> &Poses, vector<Eigen::Vector3d> &points, Eigen::Vector3d &point_3d);
-    void initFramePoseByPnP(int frameCnt, Vector3d Ps[], Matrix3d Rs[], Vector3d tic[], Matrix3d ric[]);
+    void initFramePoseByPnP(int frameCnt, WindowVector3d &Ps, WindowMatrix3d &Rs, Vector3d tic[], Matrix3d ric[]);
     bool solvePoseByPnP(Eigen::Matrix3d &R_initial, Eigen::Vector3d &P_initial, 
                             vector<cv::Point2f> &pts2D, vector<cv::Point3f> &pts3D);
     void removeBackShiftDepth(Eigen::Matrix3d marg_R, Eigen::Vector3d marg_P, Eigen::Matrix3d new_R, Eigen::Vector3d new_P);
@@ -132,8 +136,9 @@ class FeatureManager
     set<int> outlier_features;
 
   private:
+    void setInvDepth(LandmarkParams &params, const FeaturePerId &it_per_id);
     double compensatedParallax2(const FeaturePerId &it_per_id, int frame_count);
-    const Matrix3d *Rs;
+    const WindowMatrix3d *Rs;
     Matrix3d ric[2];
 };
 
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+#include "parameters.h"
+
+//Inverse depth parameter blocks of the landmarks solved in one optimization.
+//Blocks are packed in 64 byte aligned chunks which are never moved or freed,
+//so a block address handed to ceres stays valid while the store grows, and
+//clear() keeps all memory for the next frame. Feature ids are mapped to their
+//block through an open addressing table.
+class LandmarkParams
+{
+  public:
+    LandmarkParams()
+    {
+        slots.resize(1 << 12);
+    }
+
+    void clear()
+    {
+        ids.clear();
+        generation++;
+    }
+
+    //Block of a feature not in the store yet
+    double *add(int feature_id)
+    {
+        if ((ids.size() + 1) * 2 > slots.size())
+            rehash(slots.size() * 2);
+
+        int index = ids.size();
+        if (index == (int)chunks.size() * CHUNK_SIZE)
+        {
+            void *p = nullptr;
+            if (posix_memalign(&p, 64, CHUNK_SIZE * SIZE_FEATURE * sizeof(double)) != 0)
+                throw std::bad_alloc();
+            chunks.emplace_back(static_cast<double *>(p));
+        }
+        ids.push_back(feature_id);
+        insert(feature_id, index);
+        return block(index);
+    }
+
+    //nullptr if the feature is not in the store
+    double *find(int feature_id)
+    {
+        for (size_t h = hash(feature_id); slots[h].generation == generation; h = (h + 1) & (slots.size() - 1))
+        {
+            if (slots[h].id == feature_id)
+                return block(slots[h].index);
+        }
+        return nullptr;
+    }
+
+    int size() const
+    {
+        return ids.size();
+    }
+
+    int id(int index) const
+    {
+        return ids[index];
+    }
+
+    const std::vector<int> &featureIds() const
+    {
+        return ids;
+    }
+
+    double *block(int index)
+    {
+        return chunks[index / CHUNK_SIZE].get() + (index % CHUNK_SIZE) * SIZE_FEATURE;
+    }
+
+  private:
+    static const int CHUNK_SIZE = 512;
+
+    struct Slot
+    {
+        int id = -1;
+        int index = -1;
+        unsigned int generation = 0;
+    };
+
+    struct ChunkFree
+    {
+        void operator()(double *p) const
+        {
+            free(p);
+        }
+    };
+
+    size_t hash(int feature_id) const
+    {
+        return ((unsigned int)feature_id * 2654435761u) & (slots.size() - 1);
+    }
+
+    void insert(int feature_id, int index)
+    {
+        size_t h = hash(feature_id);
+        while (slots[h].generation == generation)
+            h = (h + 1) & (slots.size() - 1);
+        slots[h].id = feature_id;
+        slots[h].index = index;
+        slots[h].generation = generation;
+    }
+
+    void rehash(size_t capacity)
+    {
+        slots.assign(capacity, Slot());
+        generation = 1;
+        for (int i = 0; i < (int)ids.size(); i++)
+            insert(ids[i], i);
+    }
+
+    std::vector<std::unique_ptr<double, ChunkFree>> chunks;
+    std::vector<int> ids;
+    std::vector<Slot> slots;
+    unsigned int generation = 1;
+};
@@ -0,0 +1,145 @@
+#include "landmark_selector.h"
+#include <cstdio>
+#include <algorithm>
+
+static double smooth(double avg, double val, long cnt)
+{
+    return cnt == 0 ? val : 0.8 * avg + 0.2 * val;
+}
+
+void LandmarkSelector::setParameter()
+{
+    //Same 1.5 pixel noise as the projection factors
+    angle_noise = 1.5 / FOCAL_LENGTH;
+    frame_cnt = 0;
+    avg_candidates = 0;
+    avg_selected = 0;
+    avg_cost = 0;
+}
+
+//Residual blocks the landmark adds to the problem
+int LandmarkSelector::residualCost(const FeaturePerId &it_per_id)
+{
+    int cost = 0;
+    for (size_t i = 0; i < it_per_id.feature_per_frame.size(); i++)
+    {
+        cost += i > 0;
+        cost += STEREO && it_per_id.feature_per_frame[i].is_stereo;
+    }
+    return cost;
+}
+
+int LandmarkSelector::viewBucket(const FeaturePerId &it_per_id)
+{
+    const Vector3d &pt = it_per_id.feature_per_frame[0].point;
+    int view = 0;
+    //Flattened top view covers +-45 degrees around the optical axis
+    if (pt.z() < M_SQRT1_2 * pt.norm())
+    {
+        double a = atan2(pt.y(), pt.x()) + M_PI;
+        view = 1 + std::min(3, (int)(a / (M_PI / 2)));
+    }
+    return std::min(it_per_id.main_cam, 1) * 5 + view;
+}
+
+double LandmarkSelector::score(const FeaturePerId &it_per_id, const WindowMatrix3d &Rs, const Matrix3d ric[], double baseline) const
+{
+    int n = it_per_id.feature_per_frame.size();
+    double track = std::min(n, WINDOW_SIZE) / (double)WINDOW_SIZE;
+
+    int first = it_per_id.start_frame, last = it_per_id.start_frame + n - 1;
+    const Matrix3d &ric_main = ric[it_per_id.main_cam];
+    Vector3d b0 = (Rs[first] * ric_main * it_per_id.feature_per_frame.front().point).normalized();
+    Vector3d b1 = (Rs[last] * ric_main * it_per_id.feature_per_frame.back().point).normalized();
+    double parallax = acos(std::min(1.0, std::max(-1.0, b0.dot(b1))));
+
+    //A stereo observation constrains depth by the baseline angle at once
+    if (it_per_id.is_stereo && it_per_id.estimated_depth > 0)
+        parallax = std::max(parallax, baseline / it_per_id.estimated_depth);
+
+    //Relative inverse depth sigma is about angle noise over parallax
+    double sigma = angle_noise / std::max(parallax, 1e-6);
+    return track / (1.0 + sigma * sigma);
+}
+
+void LandmarkSelector::select(FeatureManager &f_manager, const WindowMatrix3d &Rs, const Matrix3d ric[], const Vector3d tic[],
+                              int max_solve_cnt, LandmarkParams &params)
+{
+    double baseline = NUM_OF_CAM > 1 ? (tic[1] - tic[0]).norm() : 0;
+    for (auto &bucket : buckets)
+        bucket.clear();
+
+    //Same candidates as FeatureManager::getDepthVector
+    int candidates = 0;
+    for (auto &_it : f_manager.feature)
+    {
+        auto &it_per_id = _it.second;
+        it_per_id.used_num = it_per_id.feature_per_frame.size();
+        bool id_in_outliers = f_manager.outlier_features.find(it_per_id.feature_id) != f_manager.outlier_features.end();
+        if (!it_per_id.good_for_solving || id_in_outliers || it_per_id.estimated_depth <= 0 ||
+            (!(it_per_id.is_stereo && it_per_id.used_num >= 2) && it_per_id.used_num < 4))
+        {
+            it_per_id.need_triangulation = true;
+            continue;
+        }
+
+        buckets[viewBucket(it_per_id)].push_back(Candidate{score(it_per_id, Rs, ric, baseline), residualCost(it_per_id), &it_per_id, false});
+        candidates++;
+    }
+
+    for (auto &bucket : buckets)
+    {
+        std::sort(bucket.begin(), bucket.end(), [](const Candidate &a, const Candidate &b) {
+            return a.score > b.score;
+        });
+    }
+
+    //Best remaining landmark of every view in turn, skipping those over the remaining budget
+    params.clear();
+    int remaining = LANDMARK_BUDGET;
+    size_t heads[VIEW_BUCKETS] = {0};
+    bool progress = true;
+    while (progress && params.size() < max_solve_cnt)
+    {
+        progress = false;
+        for (int b = 0; b < VIEW_BUCKETS && params.size() < max_solve_cnt; b++)
+        {
+            auto &bucket = buckets[b];
+            while (heads[b] < bucket.size() && bucket[heads[b]].cost > remaining)
+                heads[b]++;
+            if (heads[b] == bucket.size())
+                continue;
+
+            auto &c = bucket[heads[b]++];
+            c.selected = true;
+            params.add(c.feature->feature_id)[0] = 1. / c.feature->estimated_depth;
+            f_manager.ft->setFeatureStatus(c.feature->feature_id, 3);
+            remaining -= c.cost;
+            progress = true;
+        }
+    }
+
+    //Like getDepthVector, only landmarks left out of the solve are triangulated again,
+    //the selected ones keep their solved depth when the solve does not write it back
+    for (auto &bucket : buckets)
+    {
+        for (auto &c : bucket)
+        {
+            if (!c.selected)
+                c.feature->need_triangulation = true;
+        }
+    }
+
+    avg_candidates = smooth(avg_candidates, candidates, frame_cnt);
+    avg_selected = smooth(avg_selected, params.size(), frame_cnt);
+    avg_cost = smooth(avg_cost, LANDMARK_BUDGET - remaining, frame_cnt);
+    frame_cnt++;
+}
+
+std::string LandmarkSelector::summary() const
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "candidates %.0f selected %.0f residuals %.0f/%d",
+        avg_candidates, avg_selected, avg_cost, LANDMARK_BUDGET);
+    return std::string(buf);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "parameters.h"
+#include "feature_manager.h"
+#include "landmark_params.h"
+
+//Landmark budgeting before the solve.
+//Candidates are scored by track length, parallax and depth certainty, bucketed by the
+//view they were first seen in (camera x fisheye top/side view), and taken round robin
+//from the buckets until LANDMARK_BUDGET residual blocks are used, so the solve cost
+//per frame stays fixed however many views the features come from.
+class LandmarkSelector
+{
+  public:
+    //2 cameras, each with a top and 4 side views
+    static const int VIEW_BUCKETS = 10;
+
+    void setParameter();
+
+    bool enabled() const
+    {
+        return LANDMARK_BUDGET > 0;
+    }
+
+    void select(FeatureManager &f_manager, const WindowMatrix3d &Rs, const Matrix3d ric[], const Vector3d tic[],
+                int max_solve_cnt, LandmarkParams &params);
+
+    std::string summary() const;
+
+  private:
+    struct Candidate
+    {
+        double score;
+        int cost;
+        FeaturePerId *feature;
+        bool selected;
+    };
+
+    double score(const FeaturePerId &it_per_id, const WindowMatrix3d &Rs, const Matrix3d ric[], double baseline) const;
+    static int viewBucket(const FeaturePerId &it_per_id);
+    static int residualCost(const FeaturePerId &it_per_id);
+
+    std::vector<Candidate> buckets[VIEW_BUCKETS];
+    double angle_noise = 0;
+
+    long frame_cnt = 0;
+    double avg_candidates = 0;
+    double avg_selected = 0;
+    double avg_cost = 0;
+};
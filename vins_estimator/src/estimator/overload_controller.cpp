@@ -0,0 +1,78 @@
+#include "overload_controller.h"
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+const int OverloadController::MAX_REDUCE_LEVEL;
+
+void OverloadController::setParameter()
+{
+    policy = OVERLOAD_POLICY;
+    //Only every second image reaches the backend
+    budget_ms = IMAGE_FREQ > 0 ? 2000.0 / IMAGE_FREQ : 0;
+    cost_avg = 0;
+    reduce_level = 0;
+    is_overloaded = false;
+}
+
+void OverloadController::update(int queue_depth, double process_ms)
+{
+    total_frames ++;
+    cost_avg = cost_avg == 0 ? process_ms : 0.8 * cost_avg + 0.2 * process_ms;
+    is_overloaded = queue_depth >= OVERLOAD_QUEUE_DEPTH || (budget_ms > 0 && cost_avg > budget_ms);
+    if (is_overloaded) {
+        overloaded_frames ++;
+    }
+
+    if (enabled(OVERLOAD_REDUCE_COST)) {
+        if (is_overloaded) {
+            reduce_level = std::min(reduce_level + 1, MAX_REDUCE_LEVEL);
+        } else if (queue_depth == 0 && (budget_ms <= 0 || cost_avg < 0.7 * budget_ms)) {
+            //Recover slowly with hysteresis to avoid oscillation
+            reduce_level = std::max(reduce_level - 1, 0);
+        }
+        if (reduce_level > 0) {
+            reduced_frames ++;
+        }
+    }
+}
+
+int OverloadController::framesToDrop(int queue_depth) const
+{
+    if (!enabled(OVERLOAD_DROP_QUEUED)) {
+        return 0;
+    }
+    return std::max(queue_depth - OVERLOAD_KEEP_NEWEST + 1, 0);
+}
+
+int OverloadController::numIterations() const
+{
+    if (!enabled(OVERLOAD_REDUCE_COST)) {
+        return NUM_ITERATIONS;
+    }
+    return std::max(1, (int)std::round(NUM_ITERATIONS * costScale()));
+}
+
+int OverloadController::maxSolveCnt() const
+{
+    if (!enabled(OVERLOAD_REDUCE_COST)) {
+        return MAX_SOLVE_CNT;
+    }
+    return std::max(1, (int)std::round(MAX_SOLVE_CNT * costScale()));
+}
+
+double OverloadController::detectScale() const
+{
+    if (!enabled(OVERLOAD_REDUCE_COST)) {
+        return 1.0;
+    }
+    return costScale();
+}
+
+std::string OverloadController::summary() const
+{
+    char buf[256] = {0};
+    snprintf(buf, sizeof(buf), "frames %ld overloaded %ld dropped %ld skipped %ld reduced %ld level %d cost %.1fms budget %.1fms",
+        total_frames, overloaded_frames, dropped_frames, skipped_frames, reduced_frames, reduce_level, cost_avg, budget_ms);
+    return std::string(buf);
+}
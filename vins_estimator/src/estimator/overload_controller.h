@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include "parameters.h"
+
+//Bits of OVERLOAD_POLICY
+enum OverloadPolicyFlag
+{
+    OVERLOAD_DROP_QUEUED = 1,       //Discard queued frames, keep the newest OVERLOAD_KEEP_NEWEST
+    OVERLOAD_SKIP_NON_KEYFRAME = 2, //Skip frames that will not become keyframe while overloaded
+    OVERLOAD_REDUCE_COST = 4        //Lower iterations, solved features and detected features
+};
+
+//Load shedding for the backend.
+//Overload is decided from feature queue depth and smoothed process time against the frame period.
+class OverloadController
+{
+  public:
+    static const int MAX_REDUCE_LEVEL = 4;
+
+    void setParameter();
+    void update(int queue_depth, double process_ms);
+
+    bool enabled(OverloadPolicyFlag flag) const
+    {
+        return (policy & flag) != 0;
+    }
+
+    bool overloaded() const
+    {
+        return is_overloaded;
+    }
+
+    //Count of queued frames to discard so only the newest remain
+    int framesToDrop(int queue_depth) const;
+
+    int numIterations() const;
+    int maxSolveCnt() const;
+    double detectScale() const;
+
+    void countDropped(int n)
+    {
+        dropped_frames += n;
+    }
+
+    void countSkipped()
+    {
+        skipped_frames ++;
+    }
+
+    std::string summary() const;
+
+  private:
+    double costScale() const
+    {
+        return 1.0 - 0.15 * reduce_level;
+    }
+
+    int policy = 0;
+    double budget_ms = 0;
+    double cost_avg = 0;
+    int reduce_level = 0;
+    bool is_overloaded = false;
+
+    long total_frames = 0;
+    long overloaded_frames = 0;
+    long dropped_frames = 0;
+    long skipped_frames = 0;
+    long reduced_frames = 0;
+};
@@ -28,6 +28,11 @@ Eigen::Vector3d G{0.0, 0.0, 9.8};
 double BIAS_ACC_THRESHOLD;
 double BIAS_GYR_THRESHOLD;
 double SOLVER_TIME;
+int ADAPTIVE_SOLVER_TIME;
+int KEYFRAME_ONLY_BA;
+int ASYNC_MARGINALIZATION;
+int SQRT_MARGINALIZATION;
+double SOLVER_BUDGET_RATIO;
 int NUM_ITERATIONS;
 int ESTIMATE_EXTRINSIC;
 int ESTIMATE_TD;
@@ -69,6 +74,7 @@ int MAX_CNT;
 int TOP_PTS_CNT;
 int SIDE_PTS_CNT;
 int MAX_SOLVE_CNT;
+int LANDMARK_BUDGET;
 int RGB_DEPTH_CLOUD;
 int ENABLE_DEPTH;
 int ENABLE_PERF_OUTPUT;
@@ -76,6 +82,9 @@ int MIN_DIST;
 double F_THRESHOLD;
 int SHOW_TRACK;
 int FLOW_BACK;
+int FIXED_WINDOW_LK;
+int GYRO_PREDICT;
+int FISHEYE_DIRECT;
 int SHOW_FEATURE_ID;
 
 int WARN_IMU_DURATION;
@@ -83,6 +92,15 @@ int PUB_FLATTEN;
 int FLATTEN_COLOR;
 int PUB_FLATTEN_FREQ;
 
+int PIPELINE_QUEUE_SIZE;
+int INPUT_DROP_POLICY;
+int FEATURE_QUEUE_SIZE;
+double PERF_REPORT_PERIOD;
+
+int OVERLOAD_POLICY;
+int OVERLOAD_KEEP_NEWEST;
+int OVERLOAD_QUEUE_DEPTH;
+
 std::string configPath;
 
 template <typename T>
@@ -133,12 +151,16 @@ void readParameters(std::string config_file)
     TOP_PTS_CNT = fsSettings["top_cnt"];
     SIDE_PTS_CNT = fsSettings["side_cnt"];
     MAX_SOLVE_CNT = fsSettings["max_solve_cnt"];
+    LANDMARK_BUDGET = fsSettings["landmark_budget"];
     MIN_DIST = fsSettings["min_dist"];
     USE_ORB = fsSettings["use_orb"];
 
     SHOW_TRACK = fsSettings["show_track"];
     SHOW_FEATURE_ID = fsSettings["show_track_id"];
     FLOW_BACK = fsSettings["flow_back"];
+    FIXED_WINDOW_LK = fsSettings["fixed_window_lk"];
+    GYRO_PREDICT = fsSettings["gyro_predict"];
+    FISHEYE_DIRECT = fsSettings["fisheye_direct"];
     RGB_DEPTH_CLOUD = fsSettings["rgb_depth_cloud"];
     ENABLE_DEPTH = fsSettings["enable_depth"];
     THRES_OUTLIER = fsSettings["thres_outlier"];
@@ -172,6 +194,39 @@ void readParameters(std::string config_file)
         PUB_FLATTEN_FREQ = 10;
     }
 
+    //Bounded queues between flatten, tracking and estimation stages
+    PIPELINE_QUEUE_SIZE = fsSettings["pipeline_queue_size"];
+    if (PIPELINE_QUEUE_SIZE <= 0) {
+        PIPELINE_QUEUE_SIZE = 2;
+    }
+    FEATURE_QUEUE_SIZE = fsSettings["feature_queue_size"];
+    if (FEATURE_QUEUE_SIZE <= 0) {
+        FEATURE_QUEUE_SIZE = 2;
+    }
+    //0 block, 1 drop oldest, 2 drop newest; only raw input images are dropped, later stages apply backpressure
+    if (fsSettings["input_drop_policy"].empty()) {
+        INPUT_DROP_POLICY = 1;
+    } else {
+        INPUT_DROP_POLICY = fsSettings["input_drop_policy"];
+    }
+
+    //Period of stage latency export to topic and csv, needs WITH_PERF_STATS
+    PERF_REPORT_PERIOD = fsSettings["perf_report_period"];
+    if (PERF_REPORT_PERIOD <= 0) {
+        PERF_REPORT_PERIOD = 1.0;
+    }
+
+    //Load shedding when backend falls behind; bitmask of 1 keep newest, 2 skip non keyframe, 4 reduce cost
+    OVERLOAD_POLICY = fsSettings["overload_policy"];
+    OVERLOAD_KEEP_NEWEST = fsSettings["overload_keep_newest"];
+    if (OVERLOAD_KEEP_NEWEST <= 0) {
+        OVERLOAD_KEEP_NEWEST = 1;
+    }
+    OVERLOAD_QUEUE_DEPTH = fsSettings["overload_queue_depth"];
+    if (OVERLOAD_QUEUE_DEPTH <= 0) {
+        OVERLOAD_QUEUE_DEPTH = 1;
+    }
+
     printf("USE_IMU: %d\n", USE_IMU);
     if(USE_IMU)
     {
@@ -185,7 +240,18 @@ void readParameters(std::string config_file)
     }
 
     SOLVER_TIME = fsSettings["max_solver_time"];
+    //Adapt solver time to measured backend cost, keep whole frame under solver_budget_ratio of backend period
+    ADAPTIVE_SOLVER_TIME = fsSettings["adaptive_solver_time"];
+    SOLVER_BUDGET_RATIO = fsSettings["solver_budget_ratio"];
+    if (SOLVER_BUDGET_RATIO <= 0) {
+        SOLVER_BUDGET_RATIO = 0.8;
+    }
     NUM_ITERATIONS = fsSettings["max_num_iterations"];
+    //Full window BA on keyframes only, non-keyframes get a motion only refinement
+    KEYFRAME_ONLY_BA = fsSettings["keyframe_only_ba"];
+    //1 computes the prior while the next frame is tracked, 2 also checks it against the synchronous result
+    ASYNC_MARGINALIZATION = fsSettings["async_marginalization"];
+    SQRT_MARGINALIZATION = fsSettings["sqrt_marginalization"];
     MIN_PARALLAX = fsSettings["keyframe_parallax"];
     MIN_PARALLAX = MIN_PARALLAX / FOCAL_LENGTH;
 
@@ -265,6 +331,12 @@ void readParameters(std::string config_file)
         fsSettings["publish_rectify"] >> PUB_RECTIFY;
     }
 
+    if (FISHEYE_DIRECT && !USE_IMU) {
+        //Direct tracking has no stereo matches, scale only comes from the IMU
+        std::cerr << "fisheye_direct has no stereo depth and needs imu: 1 to initialize!!!" << std::endl;
+        exit(-1);
+    }
+
     INIT_DEPTH = 5.0;
     BIAS_ACC_THRESHOLD = 0.1;
     BIAS_GYR_THRESHOLD = 0.1;
@@ -22,7 +22,6 @@ using namespace std;
 
 extern double FOCAL_LENGTH;
 const int WINDOW_SIZE = 10;
-const int NUM_OF_F = 1000;
 extern double triangulate_max_err;
 #define UNIT_SPHERE_ERROR
 
@@ -43,6 +42,11 @@ extern Eigen::Vector3d G;
 extern double BIAS_ACC_THRESHOLD;
 extern double BIAS_GYR_THRESHOLD;
 extern double SOLVER_TIME;
+extern int ADAPTIVE_SOLVER_TIME;
+extern int KEYFRAME_ONLY_BA;
+extern int ASYNC_MARGINALIZATION;
+extern int SQRT_MARGINALIZATION;
+extern double SOLVER_BUDGET_RATIO;
 extern int NUM_ITERATIONS;
 extern std::string EX_CALIB_RESULT_PATH;
 extern std::string VINS_RESULT_PATH;
@@ -86,10 +90,14 @@ extern int MAX_CNT;
 extern int TOP_PTS_CNT;
 extern int SIDE_PTS_CNT;
 extern int MAX_SOLVE_CNT;
+extern int LANDMARK_BUDGET;
 
 extern int MIN_DIST;
 extern int SHOW_TRACK;
 extern int FLOW_BACK;
+extern int FIXED_WINDOW_LK;
+extern int GYRO_PREDICT;
+extern int FISHEYE_DIRECT;
 extern int SHOW_FEATURE_ID;
 
 extern double IMU_FREQ;
@@ -101,6 +109,15 @@ extern int FLATTEN_COLOR;
 extern int IS_COMP_IMAGES;
 extern int PUB_FLATTEN_FREQ;
 
+extern int PIPELINE_QUEUE_SIZE;
+extern int INPUT_DROP_POLICY;
+extern int FEATURE_QUEUE_SIZE;
+extern double PERF_REPORT_PERIOD;
+
+extern int OVERLOAD_POLICY;
+extern int OVERLOAD_KEEP_NEWEST;
+extern int OVERLOAD_QUEUE_DEPTH;
+
 void readParameters(std::string config_file);
 
 enum SIZE_PARAMETERIZATION
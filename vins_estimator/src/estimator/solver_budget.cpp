@@ -0,0 +1,77 @@
+#include "solver_budget.h"
+#include <cstdio>
+#include <algorithm>
+#include <ros/console.h>
+
+static double smooth(double avg, double val, long cnt)
+{
+    return cnt == 0 ? val : 0.8 * avg + 0.2 * val;
+}
+
+void SolverBudget::setParameter()
+{
+    //Only every second image reaches the backend
+    period_ms = IMAGE_FREQ > 0 ? 2000.0 / IMAGE_FREQ : 0;
+    target_ms = period_ms * SOLVER_BUDGET_RATIO;
+    average = SolverCost();
+    last = SolverCost();
+    cur = SolverCost();
+    marginalize_old = -1;
+    marginalize_new = -1;
+    frame_cnt = 0;
+}
+
+double SolverBudget::solveTime(bool margin_old)
+{
+    cur_margin_old = margin_old;
+    double static_time = margin_old ? SOLVER_TIME * 4.0 / 5.0 : SOLVER_TIME;
+    double marg = margin_old ? marginalize_old : marginalize_new;
+    if (!ADAPTIVE_SOLVER_TIME || marg < 0 || target_ms <= 0) {
+        budget_ms = static_time * 1000;
+        budget_margin_old = margin_old;
+        return static_time;
+    }
+
+    double budget = target_ms - average.prepare - average.slide - average.other - marg;
+    //Never starve the solver below a quarter of the static budget
+    budget = std::min(std::max(budget, SOLVER_TIME * 250), target_ms);
+
+    if (ENABLE_PERF_OUTPUT) {
+        ROS_INFO("[SolverBudget] %s budget %.1fms -> %.1fms (target %.1fms prepare %.1f marg %.1f slide %.1f other %.1f)",
+            margin_old ? "MARGIN_OLD" : "MARGIN_NEW", budget_ms, budget, target_ms,
+            average.prepare, marg, average.slide, average.other);
+    }
+    budget_ms = budget;
+    budget_margin_old = margin_old;
+    return budget / 1000.0;
+}
+
+void SolverBudget::update(double total_ms)
+{
+    cur.total = total_ms;
+    cur.other = std::max(0.0, total_ms - cur.prepare - cur.solve - cur.marginalize - cur.slide);
+
+    average.prepare = smooth(average.prepare, cur.prepare, frame_cnt);
+    average.solve = smooth(average.solve, cur.solve, frame_cnt);
+    average.marginalize = smooth(average.marginalize, cur.marginalize, frame_cnt);
+    average.slide = smooth(average.slide, cur.slide, frame_cnt);
+    average.other = smooth(average.other, cur.other, frame_cnt);
+    average.total = smooth(average.total, cur.total, frame_cnt);
+    if (cur_margin_old) {
+        marginalize_old = marginalize_old < 0 ? cur.marginalize : 0.8 * marginalize_old + 0.2 * cur.marginalize;
+    } else {
+        marginalize_new = marginalize_new < 0 ? cur.marginalize : 0.8 * marginalize_new + 0.2 * cur.marginalize;
+    }
+
+    last = cur;
+    cur = SolverCost();
+    frame_cnt ++;
+}
+
+std::string SolverBudget::summary() const
+{
+    char buf[256] = {0};
+    snprintf(buf, sizeof(buf), "total %.1fms target %.1fms budget %.1fms solve %.1fms iter %d prepare %.1fms marg %.1fms slide %.1fms other %.1fms",
+        average.total, target_ms, budget_ms, average.solve, last_iterations, average.prepare, average.marginalize, average.slide, average.other);
+    return std::string(buf);
+}
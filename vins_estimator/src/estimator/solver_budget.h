@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include "parameters.h"
+
+//Per frame backend cost split by stage, in ms
+struct SolverCost
+{
+    double prepare = 0;
+    double solve = 0;
+    double marginalize = 0;
+    double slide = 0;
+    double other = 0;
+    double total = 0;
+};
+
+//Adaptive ceres time budget.
+//Smoothed costs of the stages around the solve are subtracted from the target frame cost,
+//the remainder is given to the next solve.
+class SolverBudget
+{
+  public:
+    void setParameter();
+
+    //Budget in seconds for the next solve
+    double solveTime(bool margin_old);
+
+    void recordPrepare(double ms)
+    {
+        cur.prepare = ms;
+    }
+
+    void recordSolve(double ms, int iterations)
+    {
+        cur.solve = ms;
+        last_iterations = iterations;
+    }
+
+    void recordMarginalization(double ms)
+    {
+        cur.marginalize = ms;
+    }
+
+    void recordSlide(double ms)
+    {
+        cur.slide = ms;
+    }
+
+    //Call once the whole frame is processed
+    void update(double total_ms);
+
+    std::string summary() const;
+
+    double period_ms = 0;
+    double target_ms = 0;
+    double budget_ms = 0;
+    bool budget_margin_old = false;
+    int last_iterations = 0;
+    SolverCost average;
+    SolverCost last;
+
+  private:
+    SolverCost cur;
+    //Marginalizing the oldest frame costs much more than dropping the second newest one
+    double marginalize_old = -1;
+    double marginalize_new = -1;
+    bool cur_margin_old = false;
+    long frame_cnt = 0;
+};
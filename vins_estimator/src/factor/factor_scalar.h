@@ -0,0 +1,11 @@
+#pragma once
+
+//Scalar of the visual factor evaluation and the jacobian products of the marginalization,
+//which are still summed in double.
+//The solver state stays double; building with WITH_FLOAT_FACTORS evaluates in float
+//for twice as many SIMD lanes.
+#ifdef WITH_FLOAT_FACTORS
+typedef float FactorScalar;
+#else
+typedef double FactorScalar;
+#endif
@@ -60,6 +60,68 @@ class IntegrationBase
             propagate(dt_buf[i], acc_buf[i], gyr_buf[i]);
     }
 
+    //Start over from new first samples and biases, keeping the sample buffers allocated
+    void reset(const Eigen::Vector3d &_acc_0, const Eigen::Vector3d &_gyr_0,
+               const Eigen::Vector3d &_linearized_ba, const Eigen::Vector3d &_linearized_bg)
+    {
+        linearized_acc = _acc_0;
+        linearized_gyr = _gyr_0;
+        dt_buf.clear();
+        acc_buf.clear();
+        gyr_buf.clear();
+        repropagate(_linearized_ba, _linearized_bg);
+    }
+
+    //Append an integration starting where this one ends, same as pushing its samples here.
+    //Deltas, jacobian and covariance are composed in closed form instead of replaying the samples.
+    void append(const IntegrationBase &next)
+    {
+        if (next.dt_buf.empty())
+            return;
+
+        //First order move of next to the biases this one is linearized at
+        Vector3d dba = linearized_ba - next.linearized_ba;
+        Vector3d dbg = linearized_bg - next.linearized_bg;
+        Quaterniond q_b = next.delta_q * Utility::deltaQ(next.jacobian.block<3, 3>(O_R, O_BG) * dbg);
+        Vector3d p_b = next.delta_p + next.jacobian.block<3, 3>(O_P, O_BA) * dba + next.jacobian.block<3, 3>(O_P, O_BG) * dbg;
+        Vector3d v_b = next.delta_v + next.jacobian.block<3, 3>(O_V, O_BA) * dba + next.jacobian.block<3, 3>(O_V, O_BG) * dbg;
+        Matrix3d R_a = delta_q.toRotationMatrix();
+        double dt_b = next.sum_dt;
+
+        //Composed error from the error at the end of this one (F_a) and the error of next (F_b)
+        Eigen::Matrix<double, 15, 15> F_a = Eigen::Matrix<double, 15, 15>::Identity();
+        F_a.block<3, 3>(O_P, O_R) = -R_a * Utility::skewSymmetric(p_b);
+        F_a.block<3, 3>(O_P, O_V) = dt_b * Matrix3d::Identity();
+        F_a.block<3, 3>(O_R, O_R) = q_b.toRotationMatrix().transpose();
+        F_a.block<3, 3>(O_V, O_R) = -R_a * Utility::skewSymmetric(v_b);
+
+        Eigen::Matrix<double, 15, 15> F_b = Eigen::Matrix<double, 15, 15>::Identity();
+        F_b.block<3, 3>(O_P, O_P) = R_a;
+        F_b.block<3, 3>(O_V, O_V) = R_a;
+
+        //Bias error at the joint also moves the deltas of next
+        F_a.block<9, 6>(O_P, O_BA) += F_b.block<9, 9>(O_P, O_P) * next.jacobian.block<9, 6>(O_P, O_BA);
+
+        jacobian = F_a * jacobian;
+        covariance = F_a * covariance * F_a.transpose() + F_b * next.covariance * F_b.transpose();
+
+        delta_p = delta_p + delta_v * dt_b + delta_q * p_b;
+        delta_v = delta_v + delta_q * v_b;
+        delta_q = (delta_q * q_b).normalized();
+        sum_dt += dt_b;
+
+        dt = next.dt;
+        acc_0 = next.acc_0;
+        gyr_0 = next.gyr_0;
+        acc_1 = next.acc_1;
+        gyr_1 = next.gyr_1;
+
+        //Raw samples are still kept for repropagate
+        dt_buf.insert(dt_buf.end(), next.dt_buf.begin(), next.dt_buf.end());
+        acc_buf.insert(acc_buf.end(), next.acc_buf.begin(), next.acc_buf.end());
+        gyr_buf.insert(gyr_buf.end(), next.gyr_buf.begin(), next.gyr_buf.end());
+    }
+
     void midPointIntegration(double _dt, 
                             const Eigen::Vector3d &_acc_0, const Eigen::Vector3d &_gyr_0,
                             const Eigen::Vector3d &_acc_1, const Eigen::Vector3d &_gyr_1,
@@ -198,7 +260,7 @@ class IntegrationBase
     Eigen::Vector3d acc_0, gyr_0;
     Eigen::Vector3d acc_1, gyr_1;
 
-    const Eigen::Vector3d linearized_acc, linearized_gyr;
+    Eigen::Vector3d linearized_acc, linearized_gyr;
     Eigen::Vector3d linearized_ba, linearized_bg;
 
     Eigen::Matrix<double, 15, 15> jacobian, covariance;
@@ -80,7 +80,9 @@ void ResidualBlockInfo::Evaluate()
 MarginalizationInfo::~MarginalizationInfo()
 {
     //ROS_WARN("release marginlizationinfo");
-    
+    if (!owns_factors)
+        return;
+
     for (auto it = parameter_block_data.begin(); it != parameter_block_data.end(); ++it)
         delete it->second;
 
@@ -158,23 +160,23 @@ void* ThreadsConstructA(void* threadsstruct)
             int size_i = p->parameter_block_size[reinterpret_cast<long>(it->parameter_blocks[i])];
             if (size_i == 7)
                 size_i = 6;
-            Eigen::MatrixXd jacobian_i = it->jacobians[i].leftCols(size_i);
+            Eigen::Matrix<FactorScalar, Eigen::Dynamic, Eigen::Dynamic> jacobian_i = it->jacobians[i].leftCols(size_i).cast<FactorScalar>();
             for (int j = i; j < static_cast<int>(it->parameter_blocks.size()); j++)
             {
                 int idx_j = p->parameter_block_idx[reinterpret_cast<long>(it->parameter_blocks[j])];
                 int size_j = p->parameter_block_size[reinterpret_cast<long>(it->parameter_blocks[j])];
                 if (size_j == 7)
                     size_j = 6;
-                Eigen::MatrixXd jacobian_j = it->jacobians[j].leftCols(size_j);
+                Eigen::Matrix<FactorScalar, Eigen::Dynamic, Eigen::Dynamic> jacobian_j = it->jacobians[j].leftCols(size_j).cast<FactorScalar>();
                 if (i == j)
-                    p->A.block(idx_i, idx_j, size_i, size_j) += jacobian_i.transpose() * jacobian_j;
+                    p->A.block(idx_i, idx_j, size_i, size_j) += (jacobian_i.transpose() * jacobian_j).cast<double>();
                 else
                 {
-                    p->A.block(idx_i, idx_j, size_i, size_j) += jacobian_i.transpose() * jacobian_j;
+                    p->A.block(idx_i, idx_j, size_i, size_j) += (jacobian_i.transpose() * jacobian_j).cast<double>();
                     p->A.block(idx_j, idx_i, size_j, size_i) = p->A.block(idx_i, idx_j, size_i, size_j).transpose();
                 }
             }
-            p->b.segment(idx_i, size_i) += jacobian_i.transpose() * it->residuals;
+            p->b.segment(idx_i, size_i) += (jacobian_i.transpose() * it->residuals.cast<FactorScalar>()).cast<double>();
         }
     }
     return threadsstruct;
@@ -209,7 +211,12 @@ void MarginalizationInfo::marginalize()
         return;
     }
 
-    TicToc t_summing;
+    if (sqrt_marginalization)
+    {
+        marginalizeSqrt(pos);
+        return;
+    }
+
     Eigen::MatrixXd A(pos, pos);
     Eigen::VectorXd b(pos);
     A.setZero();
@@ -238,7 +245,6 @@ void MarginalizationInfo::marginalize()
             b.segment(idx_i, size_i) += jacobian_i.transpose() * it->residuals;
         }
     }
-    ROS_INFO("summing up costs %f ms", t_summing.toc());
     */
     //multi thread
 
@@ -256,8 +262,8 @@ void MarginalizationInfo::marginalize()
     for (int i = 0; i < NUM_THREADS; i++)
     {
         TicToc zero_matrix;
-        threadsstruct[i].A = Eigen::MatrixXd::Zero(pos,pos);
-        threadsstruct[i].b = Eigen::VectorXd::Zero(pos);
+        threadsstruct[i].A.setZero(pos, pos);
+        threadsstruct[i].b.setZero(pos);
         threadsstruct[i].parameter_block_size = parameter_block_size;
         threadsstruct[i].parameter_block_idx = parameter_block_idx;
         int ret = pthread_create( &tids[i], NULL, ThreadsConstructA ,(void*)&(threadsstruct[i]));
@@ -310,6 +316,50 @@ void MarginalizationInfo::marginalize()
     //      (linearized_jacobians.transpose() * linearized_residuals - b).sum());
 }
 
+//Square root marginalization on the stacked jacobians [J_m J_r | r], without forming A.
+//Rows are reduced by Householder QR in batches into R with R^T R = J^T J. Its lower right
+//block is the square root of the Schur complement, and the rotated residual column below
+//the marginalized rows is the matching right hand side, so no eigendecomposition is needed.
+void MarginalizationInfo::marginalizeSqrt(int pos)
+{
+    TicToc t_qr;
+    int cols = pos + 1;
+    int batch = 2 * cols;
+    for (auto it : factors)
+        batch = std::max(batch, static_cast<int>(it->residuals.size()));
+
+    //Top cols rows hold R, the rows below collect the next batch of factors.
+    //Kept in double like A in marginalize(), R accumulates every factor.
+    Eigen::MatrixXd stack = Eigen::MatrixXd::Zero(cols + batch, cols);
+    int row = cols;
+    auto reduce = [&]() {
+        Eigen::HouseholderQR<Eigen::MatrixXd> qr(stack.topRows(row));
+        stack.topRows(cols) = qr.matrixQR().topRows(cols).triangularView<Eigen::Upper>();
+        stack.bottomRows(batch).setZero();
+        row = cols;
+    };
+
+    for (auto it : factors)
+    {
+        int rows = it->residuals.size();
+        if (row + rows > cols + batch)
+            reduce();
+        for (int i = 0; i < static_cast<int>(it->parameter_blocks.size()); i++)
+        {
+            long addr = reinterpret_cast<long>(it->parameter_blocks[i]);
+            int size_i = localSize(parameter_block_size[addr]);
+            stack.block(row, parameter_block_idx[addr], rows, size_i) = it->jacobians[i].leftCols(size_i);
+        }
+        stack.block(row, pos, rows, 1) = it->residuals;
+        row += rows;
+    }
+    reduce();
+
+    linearized_jacobians = stack.block(m, m, n, n);
+    linearized_residuals = stack.block(m, pos, n, 1);
+    ROS_DEBUG("sqrt marginalization %d rows %d x %d: %f ms", row, m, n, t_qr.toc());
+}
+
 std::vector<double *> MarginalizationInfo::getParameterBlocks(std::unordered_map<long, double *> &addr_shift)
 {
     std::vector<double *> keep_block_addr;
@@ -332,6 +382,47 @@ std::vector<double *> MarginalizationInfo::getParameterBlocks(std::unordered_map
     return keep_block_addr;
 }
 
+std::vector<double *> MarginalizationInfo::computePrior(std::unordered_map<long, double *> &addr_shift)
+{
+    TicToc t_margin;
+    marginalize();
+    std::vector<double *> parameter_blocks = getParameterBlocks(addr_shift);
+    ROS_DEBUG("marginalization %f ms", t_margin.toc());
+    return parameter_blocks;
+}
+
+MarginalizationInfo *MarginalizationInfo::shareLinearization() const
+{
+    MarginalizationInfo *info = new MarginalizationInfo();
+    info->owns_factors = false;
+    info->valid = valid;
+    info->sqrt_marginalization = sqrt_marginalization;
+    info->factors = factors;
+    info->parameter_block_size = parameter_block_size;
+    info->parameter_block_idx = parameter_block_idx;
+    info->parameter_block_data = parameter_block_data;
+    return info;
+}
+
+bool MarginalizationInfo::samePrior(const MarginalizationInfo &other) const
+{
+    if (valid != other.valid || m != other.m || n != other.n ||
+        keep_block_size != other.keep_block_size || keep_block_idx != other.keep_block_idx)
+        return false;
+    for (int i = 0; i < static_cast<int>(keep_block_data.size()); i++)
+    {
+        if (memcmp(keep_block_data[i], other.keep_block_data[i], sizeof(double) * keep_block_size[i]) != 0)
+            return false;
+    }
+    if (!valid)
+        return true;
+    return linearized_jacobians.rows() == other.linearized_jacobians.rows() &&
+        linearized_jacobians.cols() == other.linearized_jacobians.cols() &&
+        linearized_residuals.size() == other.linearized_residuals.size() &&
+        memcmp(linearized_jacobians.data(), other.linearized_jacobians.data(), sizeof(double) * linearized_jacobians.size()) == 0 &&
+        memcmp(linearized_residuals.data(), other.linearized_residuals.data(), sizeof(double) * linearized_residuals.size()) == 0;
+}
+
 MarginalizationFactor::MarginalizationFactor(MarginalizationInfo* _marginalization_info):marginalization_info(_marginalization_info)
 {
     int cnt = 0;
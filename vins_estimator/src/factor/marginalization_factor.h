@@ -18,6 +18,7 @@
 
 #include "../utility/utility.h"
 #include "../utility/tic_toc.h"
+#include "factor_scalar.h"
 
 const int NUM_THREADS = 4;
 
@@ -46,6 +47,8 @@ struct ResidualBlockInfo
 struct ThreadsStruct
 {
     std::vector<ResidualBlockInfo *> sub_factors;
+    //Partial normal equation. Jacobian products are in FactorScalar but summed in double:
+    //entries span 1e5 to 1e8, float sums would bury the eps cut of marginalize() in rounding
     Eigen::MatrixXd A;
     Eigen::VectorXd b;
     std::unordered_map<long, int> parameter_block_size; //global size
@@ -62,7 +65,15 @@ class MarginalizationInfo
     void addResidualBlockInfo(ResidualBlockInfo *residual_block_info);
     void preMarginalize();
     void marginalize();
+    void marginalizeSqrt(int pos);
     std::vector<double *> getParameterBlocks(std::unordered_map<long, double *> &addr_shift);
+    //marginalize() and getParameterBlocks(). Every residual has been evaluated by preMarginalize,
+    //so this only reads the info itself and can run on another thread.
+    std::vector<double *> computePrior(std::unordered_map<long, double *> &addr_shift);
+    //Info sharing the evaluated factors and linearization points, to marginalize the same input twice
+    MarginalizationInfo *shareLinearization() const;
+    //Bitwise comparison of the priors left by getParameterBlocks
+    bool samePrior(const MarginalizationInfo &other) const;
 
     std::vector<ResidualBlockInfo *> factors;
     int m, n;
@@ -79,6 +90,9 @@ class MarginalizationInfo
     Eigen::VectorXd linearized_residuals;
     const double eps = 1e-8;
     bool valid;
+    bool owns_factors = true;
+    //Prior by QR on the stacked jacobians instead of the eigen decomposed Schur complement
+    bool sqrt_marginalization = false;
 
 };
 
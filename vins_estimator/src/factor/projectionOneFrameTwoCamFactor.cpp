@@ -39,30 +39,37 @@ ProjectionOneFrameTwoCamFactor::ProjectionOneFrameTwoCamFactor(const Eigen::Vect
 #endif
 };
 
-bool ProjectionOneFrameTwoCamFactor::Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+template <typename T>
+bool ProjectionOneFrameTwoCamFactor::evaluate(double const *const *parameters, double *residuals, double **jacobians) const
 {
     //
     TicToc tic_toc;
+    Eigen::Matrix<T, 3, 1> pts_i = this->pts_i.template cast<T>(), pts_j = this->pts_j.template cast<T>();
+    Eigen::Matrix<T, 3, 1> velocity_i = this->velocity_i.template cast<T>(), velocity_j = this->velocity_j.template cast<T>();
+    T td_i = this->td_i, td_j = this->td_j;
+    Eigen::Matrix<T, 2, 3> tangent_base = this->tangent_base.template cast<T>();
+    Eigen::Matrix<T, 2, 2> sqrt_info = this->sqrt_info.template cast<T>();
 
-    Eigen::Vector3d tic(parameters[0][0], parameters[0][1], parameters[0][2]);
-    Eigen::Quaterniond qic(parameters[0][6], parameters[0][3], parameters[0][4], parameters[0][5]);
 
-    Eigen::Vector3d tic2(parameters[1][0], parameters[1][1], parameters[1][2]);
-    Eigen::Quaterniond qic2(parameters[1][6], parameters[1][3], parameters[1][4], parameters[1][5]);
+    Eigen::Matrix<T, 3, 1> tic(parameters[0][0], parameters[0][1], parameters[0][2]);
+    Eigen::Quaternion<T> qic(parameters[0][6], parameters[0][3], parameters[0][4], parameters[0][5]);
 
-    double inv_dep_i = parameters[2][0];
+    Eigen::Matrix<T, 3, 1> tic2(parameters[1][0], parameters[1][1], parameters[1][2]);
+    Eigen::Quaternion<T> qic2(parameters[1][6], parameters[1][3], parameters[1][4], parameters[1][5]);
 
-    double td = parameters[3][0];
+    T inv_dep_i = parameters[2][0];
 
-    Eigen::Vector3d pts_i_td, pts_j_td;
+    T td = parameters[3][0];
+
+    Eigen::Matrix<T, 3, 1> pts_i_td, pts_j_td;
     pts_i_td = pts_i - (td - td_i) * velocity_i;
     pts_j_td = pts_j - (td - td_j) * velocity_j;
 
-    Eigen::Vector3d pts_camera_i = pts_i_td / inv_dep_i;
-    Eigen::Vector3d pts_imu_i = qic * pts_camera_i + tic;
-    Eigen::Vector3d pts_imu_j = pts_imu_i;
-    Eigen::Vector3d pts_camera_j = qic2.inverse() * (pts_imu_j - tic2);
-    Eigen::Map<Eigen::Vector2d> residual(residuals);
+    Eigen::Matrix<T, 3, 1> pts_camera_i = pts_i_td / inv_dep_i;
+    Eigen::Matrix<T, 3, 1> pts_imu_i = qic * pts_camera_i + tic;
+    Eigen::Matrix<T, 3, 1> pts_imu_j = pts_imu_i;
+    Eigen::Matrix<T, 3, 1> pts_camera_j = qic2.inverse() * (pts_imu_j - tic2);
+    Eigen::Matrix<T, 2, 1> residual;
 
     // std::cout << "Source ERROR" << (pts_camera_j.normalized() - pts_j_td.normalized()).transpose() << std::endl;
 
@@ -70,30 +77,33 @@ bool ProjectionOneFrameTwoCamFactor::Evaluate(double const *const *parameters, d
     residual =  tangent_base * (pts_camera_j.normalized() - pts_j_td.normalized());
 
 #else
-    double dep_j = pts_camera_j.z();
-    residual = (pts_camera_j / dep_j).head<2>() - pts_j_td.head<2>();
+    T dep_j = pts_camera_j.z();
+    residual = (pts_camera_j / dep_j).template head<2>() - pts_j_td.template head<2>();
 #endif
 
     residual = sqrt_info * residual;
+    Eigen::Map<Eigen::Vector2d> residual_out(residuals);
+    residual_out = residual.template cast<double>();
 
     // std::cout << "TAN" << tangent_base.transpose() << std::endl;
     // std::cout << "Res" << residual << std::endl;
 
     if (jacobians)
     {
-        Eigen::Matrix3d ric = qic.toRotationMatrix();
-        Eigen::Matrix3d ric2 = qic2.toRotationMatrix();
-        Eigen::Matrix<double, 2, 3> reduce(2, 3);
+        Eigen::Matrix<T, 3, 3> ric = qic.toRotationMatrix();
+        Eigen::Matrix<T, 3, 3> ric2 = qic2.toRotationMatrix();
+        Eigen::Matrix<T, 2, 3> reduce(2, 3);
 #ifdef UNIT_SPHERE_ERROR
-        double norm = pts_camera_j.norm();
-        Eigen::Matrix3d norm_jaco;
-        double x1, x2, x3;
+        T norm = pts_camera_j.norm();
+        T norm3 = norm * norm * norm;
+        Eigen::Matrix<T, 3, 3> norm_jaco;
+        T x1, x2, x3;
         x1 = pts_camera_j(0);
         x2 = pts_camera_j(1);
         x3 = pts_camera_j(2);
-        norm_jaco << 1.0 / norm - x1 * x1 / pow(norm, 3), - x1 * x2 / pow(norm, 3),            - x1 * x3 / pow(norm, 3),
-                     - x1 * x2 / pow(norm, 3),            1.0 / norm - x2 * x2 / pow(norm, 3), - x2 * x3 / pow(norm, 3),
-                     - x1 * x3 / pow(norm, 3),            - x2 * x3 / pow(norm, 3),            1.0 / norm - x3 * x3 / pow(norm, 3);
+        norm_jaco << 1.0 / norm - x1 * x1 / norm3, - x1 * x2 / norm3,            - x1 * x3 / norm3,
+                     - x1 * x2 / norm3,            1.0 / norm - x2 * x2 / norm3, - x2 * x3 / norm3,
+                     - x1 * x3 / norm3,            - x2 * x3 / norm3,            1.0 / norm - x3 * x3 / norm3;
         reduce = tangent_base * norm_jaco;
 #else
         reduce << 1. / dep_j, 0, -pts_camera_j(0) / (dep_j * dep_j),
@@ -104,35 +114,35 @@ bool ProjectionOneFrameTwoCamFactor::Evaluate(double const *const *parameters, d
         if (jacobians[0])
         {
             Eigen::Map<Eigen::Matrix<double, 2, 7, Eigen::RowMajor>> jacobian_ex_pose(jacobians[0]);
-            Eigen::Matrix<double, 3, 6> jaco_ex;
-            jaco_ex.leftCols<3>() = ric2.transpose(); 
-            jaco_ex.rightCols<3>() = ric2.transpose() * ric * -Utility::skewSymmetric(pts_camera_i);
-            jacobian_ex_pose.leftCols<6>() = reduce * jaco_ex;
+            Eigen::Matrix<T, 3, 6> jaco_ex;
+            jaco_ex.template leftCols<3>() = ric2.transpose(); 
+            jaco_ex.template rightCols<3>() = ric2.transpose() * ric * -Utility::skewSymmetric(pts_camera_i);
+            jacobian_ex_pose.leftCols<6>() = (reduce * jaco_ex).template cast<double>();
             jacobian_ex_pose.rightCols<1>().setZero();
         }
         if (jacobians[1])
         {
             Eigen::Map<Eigen::Matrix<double, 2, 7, Eigen::RowMajor>> jacobian_ex_pose1(jacobians[1]);
-            Eigen::Matrix<double, 3, 6> jaco_ex;
-            jaco_ex.leftCols<3>() = - ric2.transpose();
-            jaco_ex.rightCols<3>() = Utility::skewSymmetric(pts_camera_j);
-            jacobian_ex_pose1.leftCols<6>() = reduce * jaco_ex;
+            Eigen::Matrix<T, 3, 6> jaco_ex;
+            jaco_ex.template leftCols<3>() = - ric2.transpose();
+            jaco_ex.template rightCols<3>() = Utility::skewSymmetric(pts_camera_j);
+            jacobian_ex_pose1.leftCols<6>() = (reduce * jaco_ex).template cast<double>();
             jacobian_ex_pose1.rightCols<1>().setZero();
         }
         if (jacobians[2])
         {
             Eigen::Map<Eigen::Vector2d> jacobian_feature(jacobians[2]);
 #ifdef UNIT_SPHERE_ERROR
-            jacobian_feature = reduce * ric2.transpose() * ric * pts_i_td * -1.0 / (inv_dep_i * inv_dep_i);
+            jacobian_feature = (reduce * ric2.transpose() * ric * pts_i_td * T(-1.0) / (inv_dep_i * inv_dep_i)).template cast<double>();
 #else
-            jacobian_feature = reduce * ric2.transpose() * ric * pts_i * -1.0 / (inv_dep_i * inv_dep_i);
+            jacobian_feature = (reduce * ric2.transpose() * ric * pts_i * T(-1.0) / (inv_dep_i * inv_dep_i)).template cast<double>();
 #endif
         }
         if (jacobians[3])
         {
             Eigen::Map<Eigen::Vector2d> jacobian_td(jacobians[3]);
-            jacobian_td = reduce * (ric2.transpose() * ric * velocity_i / inv_dep_i * -1.0)  +
-                       sqrt_info * tangent_base * velocity_j;
+            jacobian_td = (reduce * (ric2.transpose() * ric * velocity_i / inv_dep_i * T(-1.0))  +
+                       sqrt_info * tangent_base * velocity_j).template cast<double>();
         }
     }
     sum_t += tic_toc.toc();
@@ -140,6 +150,14 @@ bool ProjectionOneFrameTwoCamFactor::Evaluate(double const *const *parameters, d
     return true;
 }
 
+bool ProjectionOneFrameTwoCamFactor::Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+{
+    return evaluate<FactorScalar>(parameters, residuals, jacobians);
+}
+
+template bool ProjectionOneFrameTwoCamFactor::evaluate<float>(double const *const *parameters, double *residuals, double **jacobians) const;
+template bool ProjectionOneFrameTwoCamFactor::evaluate<double>(double const *const *parameters, double *residuals, double **jacobians) const;
+
 void ProjectionOneFrameTwoCamFactor::check(double **parameters)
 {
     double *res = new double[15];
@@ -40,57 +40,68 @@ ProjectionTwoFrameOneCamFactor::ProjectionTwoFrameOneCamFactor(const Eigen::Vect
 #endif
 };
 
-bool ProjectionTwoFrameOneCamFactor::Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+template <typename T>
+bool ProjectionTwoFrameOneCamFactor::evaluate(double const *const *parameters, double *residuals, double **jacobians) const
 {
     TicToc tic_toc;
-    Eigen::Vector3d Pi(parameters[0][0], parameters[0][1], parameters[0][2]);
-    Eigen::Quaterniond Qi(parameters[0][6], parameters[0][3], parameters[0][4], parameters[0][5]);
+    Eigen::Matrix<T, 3, 1> pts_i = this->pts_i.template cast<T>(), pts_j = this->pts_j.template cast<T>();
+    Eigen::Matrix<T, 3, 1> velocity_i = this->velocity_i.template cast<T>(), velocity_j = this->velocity_j.template cast<T>();
+    T td_i = this->td_i, td_j = this->td_j;
+    Eigen::Matrix<T, 2, 3> tangent_base = this->tangent_base.template cast<T>();
+    Eigen::Matrix<T, 2, 2> sqrt_info = this->sqrt_info.template cast<T>();
 
-    Eigen::Vector3d Pj(parameters[1][0], parameters[1][1], parameters[1][2]);
-    Eigen::Quaterniond Qj(parameters[1][6], parameters[1][3], parameters[1][4], parameters[1][5]);
+    //Positions only enter as Pj - Pi, taken in double so float keeps its precision far from the origin
+    Eigen::Matrix<T, 3, 1> Pi = Eigen::Matrix<T, 3, 1>::Zero();
+    Eigen::Quaternion<T> Qi(parameters[0][6], parameters[0][3], parameters[0][4], parameters[0][5]);
 
-    Eigen::Vector3d tic(parameters[2][0], parameters[2][1], parameters[2][2]);
-    Eigen::Quaterniond qic(parameters[2][6], parameters[2][3], parameters[2][4], parameters[2][5]);
+    Eigen::Matrix<T, 3, 1> Pj(parameters[1][0] - parameters[0][0], parameters[1][1] - parameters[0][1], parameters[1][2] - parameters[0][2]);
+    Eigen::Quaternion<T> Qj(parameters[1][6], parameters[1][3], parameters[1][4], parameters[1][5]);
 
-    double inv_dep_i = parameters[3][0];
+    Eigen::Matrix<T, 3, 1> tic(parameters[2][0], parameters[2][1], parameters[2][2]);
+    Eigen::Quaternion<T> qic(parameters[2][6], parameters[2][3], parameters[2][4], parameters[2][5]);
 
-    double td = parameters[4][0];
+    T inv_dep_i = parameters[3][0];
 
-    Eigen::Vector3d pts_i_td, pts_j_td;
+    T td = parameters[4][0];
+
+    Eigen::Matrix<T, 3, 1> pts_i_td, pts_j_td;
     pts_i_td = pts_i - (td - td_i) * velocity_i;
     pts_j_td = pts_j - (td - td_j) * velocity_j;
-    Eigen::Vector3d pts_camera_i = pts_i_td / inv_dep_i;
-    Eigen::Vector3d pts_imu_i = qic * pts_camera_i + tic;
-    Eigen::Vector3d pts_w = Qi * pts_imu_i + Pi;
-    Eigen::Vector3d pts_imu_j = Qj.inverse() * (pts_w - Pj);
-    Eigen::Vector3d pts_camera_j = qic.inverse() * (pts_imu_j - tic);
-    Eigen::Map<Eigen::Vector2d> residual(residuals);
+    Eigen::Matrix<T, 3, 1> pts_camera_i = pts_i_td / inv_dep_i;
+    Eigen::Matrix<T, 3, 1> pts_imu_i = qic * pts_camera_i + tic;
+    Eigen::Matrix<T, 3, 1> pts_w = Qi * pts_imu_i + Pi;
+    Eigen::Matrix<T, 3, 1> pts_imu_j = Qj.inverse() * (pts_w - Pj);
+    Eigen::Matrix<T, 3, 1> pts_camera_j = qic.inverse() * (pts_imu_j - tic);
+    Eigen::Matrix<T, 2, 1> residual;
 
 #ifdef UNIT_SPHERE_ERROR 
     residual =  tangent_base * (pts_camera_j.normalized() - pts_j_td.normalized());
 #else
-    double dep_j = pts_camera_j.z();
-    residual = (pts_camera_j / dep_j).head<2>() - pts_j_td.head<2>();
+    T dep_j = pts_camera_j.z();
+    residual = (pts_camera_j / dep_j).template head<2>() - pts_j_td.template head<2>();
 #endif
 
     residual = sqrt_info * residual;
+    Eigen::Map<Eigen::Vector2d> residual_out(residuals);
+    residual_out = residual.template cast<double>();
 
     if (jacobians)
     {
-        Eigen::Matrix3d Ri = Qi.toRotationMatrix();
-        Eigen::Matrix3d Rj = Qj.toRotationMatrix();
-        Eigen::Matrix3d ric = qic.toRotationMatrix();
-        Eigen::Matrix<double, 2, 3> reduce(2, 3);
+        Eigen::Matrix<T, 3, 3> Ri = Qi.toRotationMatrix();
+        Eigen::Matrix<T, 3, 3> Rj = Qj.toRotationMatrix();
+        Eigen::Matrix<T, 3, 3> ric = qic.toRotationMatrix();
+        Eigen::Matrix<T, 2, 3> reduce(2, 3);
 #ifdef UNIT_SPHERE_ERROR
-        double norm = pts_camera_j.norm();
-        Eigen::Matrix3d norm_jaco;
-        double x1, x2, x3;
+        T norm = pts_camera_j.norm();
+        T norm3 = norm * norm * norm;
+        Eigen::Matrix<T, 3, 3> norm_jaco;
+        T x1, x2, x3;
         x1 = pts_camera_j(0);
         x2 = pts_camera_j(1);
         x3 = pts_camera_j(2);
-        norm_jaco << 1.0 / norm - x1 * x1 / pow(norm, 3), - x1 * x2 / pow(norm, 3),            - x1 * x3 / pow(norm, 3),
-                     - x1 * x2 / pow(norm, 3),            1.0 / norm - x2 * x2 / pow(norm, 3), - x2 * x3 / pow(norm, 3),
-                     - x1 * x3 / pow(norm, 3),            - x2 * x3 / pow(norm, 3),            1.0 / norm - x3 * x3 / pow(norm, 3);
+        norm_jaco << 1.0 / norm - x1 * x1 / norm3, - x1 * x2 / norm3,            - x1 * x3 / norm3,
+                     - x1 * x2 / norm3,            1.0 / norm - x2 * x2 / norm3, - x2 * x3 / norm3,
+                     - x1 * x3 / norm3,            - x2 * x3 / norm3,            1.0 / norm - x3 * x3 / norm3;
         reduce = tangent_base * norm_jaco;
 #else
         reduce << 1. / dep_j, 0, -pts_camera_j(0) / (dep_j * dep_j),
@@ -102,11 +113,11 @@ bool ProjectionTwoFrameOneCamFactor::Evaluate(double const *const *parameters, d
         {
             Eigen::Map<Eigen::Matrix<double, 2, 7, Eigen::RowMajor>> jacobian_pose_i(jacobians[0]);
 
-            Eigen::Matrix<double, 3, 6> jaco_i;
-            jaco_i.leftCols<3>() = ric.transpose() * Rj.transpose();
-            jaco_i.rightCols<3>() = ric.transpose() * Rj.transpose() * Ri * -Utility::skewSymmetric(pts_imu_i);
+            Eigen::Matrix<T, 3, 6> jaco_i;
+            jaco_i.template leftCols<3>() = ric.transpose() * Rj.transpose();
+            jaco_i.template rightCols<3>() = ric.transpose() * Rj.transpose() * Ri * -Utility::skewSymmetric(pts_imu_i);
 
-            jacobian_pose_i.leftCols<6>() = reduce * jaco_i;
+            jacobian_pose_i.leftCols<6>() = (reduce * jaco_i).template cast<double>();
             jacobian_pose_i.rightCols<1>().setZero();
         }
 
@@ -114,34 +125,34 @@ bool ProjectionTwoFrameOneCamFactor::Evaluate(double const *const *parameters, d
         {
             Eigen::Map<Eigen::Matrix<double, 2, 7, Eigen::RowMajor>> jacobian_pose_j(jacobians[1]);
 
-            Eigen::Matrix<double, 3, 6> jaco_j;
-            jaco_j.leftCols<3>() = ric.transpose() * -Rj.transpose();
-            jaco_j.rightCols<3>() = ric.transpose() * Utility::skewSymmetric(pts_imu_j);
+            Eigen::Matrix<T, 3, 6> jaco_j;
+            jaco_j.template leftCols<3>() = ric.transpose() * -Rj.transpose();
+            jaco_j.template rightCols<3>() = ric.transpose() * Utility::skewSymmetric(pts_imu_j);
 
-            jacobian_pose_j.leftCols<6>() = reduce * jaco_j;
+            jacobian_pose_j.leftCols<6>() = (reduce * jaco_j).template cast<double>();
             jacobian_pose_j.rightCols<1>().setZero();
         }
         if (jacobians[2])
         {
             Eigen::Map<Eigen::Matrix<double, 2, 7, Eigen::RowMajor>> jacobian_ex_pose(jacobians[2]);
-            Eigen::Matrix<double, 3, 6> jaco_ex;
-            jaco_ex.leftCols<3>() = ric.transpose() * (Rj.transpose() * Ri - Eigen::Matrix3d::Identity());
-            Eigen::Matrix3d tmp_r = ric.transpose() * Rj.transpose() * Ri * ric;
-            jaco_ex.rightCols<3>() = -tmp_r * Utility::skewSymmetric(pts_camera_i) + Utility::skewSymmetric(tmp_r * pts_camera_i) +
+            Eigen::Matrix<T, 3, 6> jaco_ex;
+            jaco_ex.template leftCols<3>() = ric.transpose() * (Rj.transpose() * Ri - Eigen::Matrix<T, 3, 3>::Identity());
+            Eigen::Matrix<T, 3, 3> tmp_r = ric.transpose() * Rj.transpose() * Ri * ric;
+            jaco_ex.template rightCols<3>() = -tmp_r * Utility::skewSymmetric(pts_camera_i) + Utility::skewSymmetric(tmp_r * pts_camera_i) +
                                      Utility::skewSymmetric(ric.transpose() * (Rj.transpose() * (Ri * tic + Pi - Pj) - tic));
-            jacobian_ex_pose.leftCols<6>() = reduce * jaco_ex;
+            jacobian_ex_pose.leftCols<6>() = (reduce * jaco_ex).template cast<double>();
             jacobian_ex_pose.rightCols<1>().setZero();
         }
         if (jacobians[3])
         {
             Eigen::Map<Eigen::Vector2d> jacobian_feature(jacobians[3]);
-            jacobian_feature = reduce * ric.transpose() * Rj.transpose() * Ri * ric * pts_i_td * -1.0 / (inv_dep_i * inv_dep_i);
+            jacobian_feature = (reduce * ric.transpose() * Rj.transpose() * Ri * ric * pts_i_td * T(-1.0) / (inv_dep_i * inv_dep_i)).template cast<double>();
         }
         if (jacobians[4])
         {
             Eigen::Map<Eigen::Vector2d> jacobian_td(jacobians[4]);
-            jacobian_td = reduce * ric.transpose() * Rj.transpose() * Ri * ric * velocity_i / inv_dep_i * -1.0  +
-                          sqrt_info * tangent_base * velocity_j;
+            jacobian_td = (reduce * ric.transpose() * Rj.transpose() * Ri * ric * velocity_i / inv_dep_i * T(-1.0)  +
+                          sqrt_info * tangent_base * velocity_j).template cast<double>();
         }
     }
     sum_t += tic_toc.toc();
@@ -149,6 +160,15 @@ bool ProjectionTwoFrameOneCamFactor::Evaluate(double const *const *parameters, d
     return true;
 }
 
+bool ProjectionTwoFrameOneCamFactor::Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+{
+    return evaluate<FactorScalar>(parameters, residuals, jacobians);
+}
+
+//Both scalars are instantiated so the float path is always compiled and can be compared against double
+template bool ProjectionTwoFrameOneCamFactor::evaluate<float>(double const *const *parameters, double *residuals, double **jacobians) const;
+template bool ProjectionTwoFrameOneCamFactor::evaluate<double>(double const *const *parameters, double *residuals, double **jacobians) const;
+
 void ProjectionTwoFrameOneCamFactor::check(double **parameters)
 {
     double *res = new double[2];
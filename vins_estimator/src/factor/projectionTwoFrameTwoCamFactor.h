@@ -17,6 +17,7 @@
 #include "../utility/utility.h"
 #include "../utility/tic_toc.h"
 #include "../estimator/parameters.h"
+#include "factor_scalar.h"
 
 class ProjectionTwoFrameTwoCamFactor : public ceres::SizedCostFunction<2, 7, 7, 7, 7, 1, 1>
 {
@@ -25,6 +26,9 @@ class ProjectionTwoFrameTwoCamFactor : public ceres::SizedCostFunction<2, 7, 7,
     							   const Eigen::Vector3d &_velocity_i, const Eigen::Vector3d &_velocity_j,
     				   			   const double _td_i, const double _td_j);
     virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const;
+    //Evaluate with the factor math in T, parameters and outputs stay double
+    template <typename T>
+    bool evaluate(double const *const *parameters, double *residuals, double **jacobians) const;
     void check(double **parameters);
 
     Eigen::Vector3d pts_i, pts_j;
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/StdVector>
+
+typedef Eigen::Matrix<double, 8, 1> TrackFeatureNoId;
+typedef std::pair<int, TrackFeatureNoId> TrackFeature;
+
+//Observations of one feature in one frame: camera 0 first, then camera 1.
+//A feature is seen by at most two cameras, so they are stored inline.
+class FeatureObservations {
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    static const int CAPACITY = 2;
+
+    //Return false and drop the observation when already full
+    bool emplace_back(int camera_id, const TrackFeatureNoId & pt) {
+        if (n >= CAPACITY) {
+            return false;
+        }
+        obs[n].first = camera_id;
+        obs[n].second = pt;
+        n ++;
+        return true;
+    }
+
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+
+    TrackFeature & operator[](size_t i) { return obs[i]; }
+    const TrackFeature & operator[](size_t i) const { return obs[i]; }
+
+    TrackFeature * begin() { return obs; }
+    TrackFeature * end() { return obs + n; }
+    const TrackFeature * begin() const { return obs; }
+    const TrackFeature * end() const { return obs + n; }
+
+private:
+    TrackFeature obs[CAPACITY];
+    int n = 0;
+};
+
+typedef FeatureObservations FeatureFramenoId;
+
+//Features of one frame in a flat buffer sorted by feature id
+typedef std::vector<std::pair<int, FeatureFramenoId>, Eigen::aligned_allocator<std::pair<int, FeatureFramenoId>>> FeatureFrame;
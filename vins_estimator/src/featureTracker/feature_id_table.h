@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+namespace FeatureTracker {
+
+//Dense table from feature id to a value, replacing per frame std::map/std::set lookups.
+//Feature ids only grow, so an id starts at slot id % capacity and probes linearly on collision,
+//e.g. a long lived track and an id 1<<15 newer. Each slot is tagged with the id and the
+//generation it was written in: clear() just starts a new generation, slots left over from an
+//older generation read as free. The table doubles when it gets half full, which does not
+//happen with per frame feature counts, so normally nothing is allocated after construction.
+template<typename T>
+class FeatureIdTable {
+public:
+    explicit FeatureIdTable(int capacity_bits = 15):
+        slots(1 << capacity_bits), mask((1 << capacity_bits) - 1)
+    {}
+
+    void clear() {
+        generation ++;
+        count = 0;
+    }
+
+    void set(int id, const T & value) {
+        if (2 * (count + 1) > (int)slots.size()) {
+            grow();
+        }
+        for (int i = id & mask; ; i = (i + 1) & mask) {
+            Slot & s = slots[i];
+            if (s.generation != generation) {
+                s.id = id;
+                s.generation = generation;
+                s.value = value;
+                count ++;
+                return;
+            }
+            if (s.id == id) {
+                s.value = value;
+                return;
+            }
+        }
+    }
+
+    //nullptr if id is not in the table
+    const T * find(int id) const {
+        //At most half the slots are live, so the probe always reaches a free slot
+        for (int i = id & mask; ; i = (i + 1) & mask) {
+            const Slot & s = slots[i];
+            if (s.generation != generation) {
+                return nullptr;
+            }
+            if (s.id == id) {
+                return &s.value;
+            }
+        }
+    }
+
+    bool contains(int id) const {
+        return find(id) != nullptr;
+    }
+
+    void swap(FeatureIdTable & other) {
+        slots.swap(other.slots);
+        std::swap(mask, other.mask);
+        std::swap(generation, other.generation);
+        std::swap(count, other.count);
+    }
+
+    int size() const {
+        return count;
+    }
+
+    int capacity() const {
+        return slots.size();
+    }
+
+private:
+    struct Slot {
+        int id = -1;
+        unsigned int generation = 0;
+        T value = T();
+    };
+
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        mask = slots.size() - 1;
+        count = 0;
+        for (const Slot & s : old) {
+            if (s.generation == generation) {
+                set(s.id, s.value);
+            }
+        }
+    }
+
+    std::vector<Slot> slots;
+    int mask;
+    unsigned int generation = 1;
+    int count = 0;
+};
+
+}
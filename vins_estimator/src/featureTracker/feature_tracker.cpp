@@ -10,6 +10,7 @@
  *******************************************************/
 
 #include "feature_tracker.h"
+#include <tuple>
 #include "../estimator/estimator.h"
 #include "fisheye_undist.hpp"
 
@@ -59,13 +60,16 @@ std::vector<cv::Point2f> detect_orb_by_region(cv::InputArray _img, cv::InputArra
         for (int j = 0; j < rows; j ++) {
             std::vector<cv::KeyPoint> kpts;
             cv::Rect roi(small_width*i, small_height*j, small_width, small_height);
-            std::cout << "ROI " << roi << "Img " << _img.size() << std::endl;
-            _orb->detect(_img.getMat()(roi), kpts, _mask.getMat()(roi));
-            printf("Detected %ld features in reigion (%d, %d)\n", kpts.size(), i, j);
+            if (_mask.empty()) {
+                _orb->detect(_img.getMat()(roi), kpts);
+            } else {
+                _orb->detect(_img.getMat()(roi), kpts, _mask.getMat()(roi));
+            }
+            ROS_DEBUG("Detected %ld features in region (%d, %d)", kpts.size(), i, j);
 
             for (auto kp : kpts) {
                 kp.pt.x = kp.pt.x + small_width*i;
-                kp.pt.y = kp.pt.y + small_width*j;
+                kp.pt.y = kp.pt.y + small_height*j;
                 ret.push_back(kp.pt);
             }
         }
@@ -83,15 +87,15 @@ bool inBorder(const cv::Point2f &pt, cv::Size shape)
     return BORDER_SIZE <= img_x && img_x < shape.width - BORDER_SIZE && BORDER_SIZE <= img_y && img_y < shape.height - BORDER_SIZE;
 }
 
-vector<cv::Point2f> get_predict_pts(vector<int> ids, const vector<cv::Point2f> & cur_pt, const std::map<int, cv::Point2f> & predict) {
+vector<cv::Point2f> get_predict_pts(const vector<int> & ids, const vector<cv::Point2f> & cur_pt, const FeatureIdTable<cv::Point2f> * predict) {
     assert(ids.size() == cur_pt.size() && "[get_predict_pts] IDS must same size as cur pt");
+    if (predict == nullptr) {
+        return cur_pt;
+    }
     std::vector<cv::Point2f> ret(cur_pt.size());
     for (size_t i = 0; i < ids.size(); i++) {
-        if(predict.find(ids[i]) != predict.end()) {
-            ret[i] = predict.at(ids[i]);
-        } else {
-            ret[i] = cur_pt.at(i);
-        }
+        auto pt = predict->find(ids[i]);
+        ret[i] = pt != nullptr ? *pt : cur_pt[i];
     }
     
     return ret;
@@ -102,7 +106,6 @@ void detectPoints(cv::InputArray img, cv::InputArray mask, vector<cv::Point2f> &
     int lack_up_top_pts = require_pts - static_cast<int>(cur_pts.size());
 
     //Add Points Top
-    TicToc tic;
     ROS_INFO("Lost %d pts; Require %d will detect %d", lack_up_top_pts, require_pts, lack_up_top_pts > require_pts/4);
     if (lack_up_top_pts > require_pts/4) {
         if(mask.empty())
@@ -131,43 +134,83 @@ void detectPoints(cv::InputArray img, cv::InputArray mask, vector<cv::Point2f> &
     else {
         n_pts.clear();
     }
-#ifdef PERF_OUTPUT
-    ROS_INFO("Detected %ld npts %fms", n_pts.size(), tic.toc());
-#endif
 
  }
 
-void BaseFeatureTracker::setup_feature_frame(FeatureFrame & ff, vector<int> ids, vector<cv::Point2f> cur_pts, vector<cv::Point3f> cur_un_pts, vector<cv::Point3f> cur_pts_vel, int camera_id) {
-    // ROS_INFO("Setup feature frame pts %ld un pts %ld vel %ld on Camera %d", cur_pts.size(), cur_un_pts.size(), cur_pts_vel.size(), camera_id);
-    for (size_t i = 0; i < ids.size(); i++)
-    {
-        int feature_id = ids[i];
-        double x, y ,z;
-        x = cur_un_pts[i].x;
-        y = cur_un_pts[i].y;
-        z = cur_un_pts[i].z;
-        double p_u, p_v;
-        p_u = cur_pts[i].x;
-        p_v = cur_pts[i].y;
-        double velocity_x, velocity_y, velocity_z;
-        velocity_x = cur_pts_vel[i].x;
-        velocity_y = cur_pts_vel[i].y;
-        velocity_z = cur_pts_vel[i].z;
+//Merge all views into ff sorted by id in one pass. Each view keeps its ids increasing,
+//so the smallest head among the views is the next feature; a stereo feature is
+//the same id in a camera 0 and a camera 1 view.
+void BaseFeatureTracker::setup_feature_frame(FeatureFrame & ff, const vector<FeatureFrameView> & views) {
+    size_t total = 0;
+    bool sorted = true;
+    for (auto & view : views) {
+        total += view.ids->size();
+        sorted = sorted && std::is_sorted(view.ids->begin(), view.ids->end());
+    }
+    ff.clear();
+    ff.reserve(total);
 
+    auto append = [&ff](int feature_id, const FeatureFrameView & view, size_t i) {
+        auto & un_pt = (*view.un_pts)[i];
+        auto & pt = (*view.pts)[i];
+        auto & vel = (*view.vel)[i];
         TrackFeatureNoId xyz_uv_velocity;
-        xyz_uv_velocity << x, y, z, p_u, p_v, velocity_x, velocity_y, velocity_z;
-
-        // ROS_INFO("FeaturePts Id %d; Cam %d; pos %f, %f, %f uv %f, %f, vel %f, %f, %f", feature_id, camera_id,
-            // x, y, z, p_u, p_v, velocity_x, velocity_y, velocity_z);
-        ff[feature_id].emplace_back(camera_id,  xyz_uv_velocity);
+        xyz_uv_velocity << un_pt.x, un_pt.y, un_pt.z, pt.x, pt.y, vel.x, vel.y, vel.z;
+        if (ff.empty() || ff.back().first != feature_id) {
+            ff.emplace_back(feature_id, FeatureFramenoId());
+        }
+        if (!ff.back().second.emplace_back(view.camera_id, xyz_uv_velocity)) {
+            ROS_WARN_THROTTLE(1.0, "Feature %d tracked in more than two views, extra observation dropped", feature_id);
+        }
+    };
+
+    if (sorted) {
+        vector<size_t> heads(views.size(), 0);
+        while (true) {
+            int best = -1;
+            for (size_t v = 0; v < views.size(); v++) {
+                if (heads[v] < views[v].ids->size() &&
+                    (best < 0 || (*views[v].ids)[heads[v]] < (*views[best].ids)[heads[best]])) {
+                    best = v;
+                }
+            }
+            if (best < 0) {
+                break;
+            }
+            //Equal ids are taken in view order, camera 0 first
+            int feature_id = (*views[best].ids)[heads[best]];
+            for (size_t v = best; v < views.size(); v++) {
+                if (heads[v] < views[v].ids->size() && (*views[v].ids)[heads[v]] == feature_id) {
+                    append(feature_id, views[v], heads[v]++);
+                }
+            }
+        }
+    } else {
+        //Trackers reordering ids (VisionWorks, pinhole setMask()): sort (id, view, index) once
+        vector<std::tuple<int, int, int>> order;
+        order.reserve(total);
+        for (size_t v = 0; v < views.size(); v++) {
+            for (size_t i = 0; i < views[v].ids->size(); i++) {
+                order.emplace_back((*views[v].ids)[i], v, i);
+            }
+        }
+        std::sort(order.begin(), order.end());
+        for (auto & o : order) {
+            append(std::get<0>(o), views[std::get<1>(o)], std::get<2>(o));
+        }
     }
- }
+}
 
 
 
+vector<cv::Mat> * PyramidPool::build(const cv::Mat & img) {
+    cv::buildOpticalFlowPyramid(img, pyrs[cur], WIN_SIZE, PYR_LEVEL, true);
+    return &pyrs[cur];
+}
+
 vector<cv::Point2f> opticalflow_track(vector<cv::Mat> * cur_pyr, 
                         vector<cv::Mat> * prev_pyr, vector<cv::Point2f> & prev_pts, 
-                        vector<int> & ids, vector<int> & track_cnt, std::set<int> removed_pts, std::map<int, cv::Point2f> prediction_points) {
+                        vector<int> & ids, vector<int> & track_cnt, const FeatureIdTable<bool> & removed_pts, const FeatureIdTable<cv::Point2f> * prediction_points) {
     if (prev_pts.size() == 0) {
         return vector<cv::Point2f>();
     }
@@ -177,7 +220,7 @@ vector<cv::Point2f> opticalflow_track(vector<cv::Mat> * cur_pyr,
 
     for (size_t i = 0; i < ids.size(); i ++) {
         int _id = ids[i];
-        if (removed_pts.find(_id) == removed_pts.end()) {
+        if (!removed_pts.contains(_id)) {
             status.push_back(1);
         } else {
             status.push_back(0);
@@ -193,7 +236,6 @@ vector<cv::Point2f> opticalflow_track(vector<cv::Mat> * cur_pyr,
     }
 
     vector<cv::Point2f> cur_pts = get_predict_pts(ids, prev_pts, prediction_points);
-    TicToc t_og;
     status.clear();
     vector<float> err;
     cv::calcOpticalFlowPyrLK(*prev_pyr, *cur_pyr, prev_pts, cur_pts, status, err, WIN_SIZE, PYR_LEVEL);
@@ -214,17 +256,12 @@ vector<cv::Point2f> opticalflow_track(vector<cv::Mat> * cur_pyr,
                 status[i] = 0;
         }
     }
-    // printf("gpu temporal optical flow costs: %f ms\n",t_og.toc());
 
     reduceVector(prev_pts, status);
     reduceVector(cur_pts, status);
     reduceVector(ids, status);
     reduceVector(track_cnt, status);
 
-#ifdef PERF_OUTPUT
-    ROS_INFO("Optical flow costs: %fms Pts %ld", t_og.toc(), ids.size());
-#endif
-
     //printf("track cnt %d\n", (int)ids.size());
 
     for (auto &n : track_cnt)
@@ -235,7 +272,7 @@ vector<cv::Point2f> opticalflow_track(vector<cv::Mat> * cur_pyr,
 
 vector<cv::Point2f> opticalflow_track(cv::Mat & cur_img, vector<cv::Mat> * cur_pyr, 
                         cv::Mat & prev_img, vector<cv::Mat> * prev_pyr, vector<cv::Point2f> & prev_pts, 
-                        vector<int> & ids, vector<int> & track_cnt, std::set<int> removed_pts, std::map<int, cv::Point2f> prediction_points) {
+                        vector<int> & ids, vector<int> & track_cnt, const FeatureIdTable<bool> & removed_pts, const FeatureIdTable<cv::Point2f> * prediction_points) {
     if (prev_pts.size() == 0) {
         return vector<cv::Point2f>();
     }
@@ -244,7 +281,7 @@ vector<cv::Point2f> opticalflow_track(cv::Mat & cur_img, vector<cv::Mat> * cur_p
 
     for (size_t i = 0; i < ids.size(); i ++) {
         int _id = ids[i];
-        if (removed_pts.find(_id) == removed_pts.end()) {
+        if (!removed_pts.contains(_id)) {
             status.push_back(1);
         } else {
             status.push_back(0);
@@ -261,7 +298,6 @@ vector<cv::Point2f> opticalflow_track(cv::Mat & cur_img, vector<cv::Mat> * cur_p
 
     vector<cv::Point2f> cur_pts = get_predict_pts(ids, prev_pts, prediction_points);
 
-    TicToc t_og;
     status.clear();
     vector<float> err;
     
@@ -306,10 +342,6 @@ vector<cv::Point2f> opticalflow_track(cv::Mat & cur_img, vector<cv::Mat> * cur_p
     // std::cout << "Cur pts" << cur_pts.size() << std::endl;
 
 
-#ifdef PERF_OUTPUT
-    ROS_INFO("Optical flow costs: %fms Pts %ld", t_og.toc(), ids.size());
-#endif
-
     //printf("track cnt %d\n", (int)ids.size());
 
     for (auto &n : track_cnt)
@@ -318,6 +350,82 @@ vector<cv::Point2f> opticalflow_track(cv::Mat & cur_img, vector<cv::Mat> * cur_p
     return cur_pts;
 } 
 
+#define LK_CHUNK_SIZE 32
+
+void opticalflow_track_batch(vector<LKTrackJob> & jobs, const FeatureIdTable<bool> & removed_pts) {
+    //(job, first point) of each chunk
+    vector<pair<int, int>> chunks;
+    vector<vector<uchar>> status(jobs.size());
+
+    for (size_t j = 0; j < jobs.size(); j ++) {
+        auto & job = jobs[j];
+        vector<uchar> keep;
+        for (auto _id : *job.ids) {
+            keep.push_back(!removed_pts.contains(_id));
+        }
+        reduceVector(*job.prev_pts, keep);
+        reduceVector(*job.ids, keep);
+        if (job.track_cnt->size() > 0) {
+            reduceVector(*job.track_cnt, keep);
+        }
+
+        job.cur_pts = get_predict_pts(*job.ids, *job.prev_pts, job.prediction);
+        status[j].resize(job.prev_pts->size());
+
+        for (int i = 0; i < (int) job.prev_pts->size(); i += LK_CHUNK_SIZE) {
+            chunks.emplace_back(j, i);
+        }
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t c = 0; c < chunks.size(); c ++) {
+        auto & job = jobs[chunks[c].first];
+        int begin = chunks[c].second;
+        int end = std::min(begin + LK_CHUNK_SIZE, (int) job.prev_pts->size());
+
+        vector<cv::Point2f> prev_pts(job.prev_pts->begin() + begin, job.prev_pts->begin() + end);
+        vector<cv::Point2f> cur_pts(job.cur_pts.begin() + begin, job.cur_pts.begin() + end);
+        vector<uchar> st;
+        vector<float> err;
+        //Falls back to OpenCV if the pyramids come without derivatives
+        if (!(FIXED_WINDOW_LK && FixedLK::calc(*job.prev_pyr, *job.cur_pyr, prev_pts, cur_pts, st))) {
+            cv::calcOpticalFlowPyrLK(*job.prev_pyr, *job.cur_pyr, prev_pts, cur_pts, st, err, WIN_SIZE, PYR_LEVEL, 
+                cv::TermCriteria(cv::TermCriteria::COUNT+cv::TermCriteria::EPS, 30, 0.01), cv::OPTFLOW_USE_INITIAL_FLOW);
+        }
+
+        if (FLOW_BACK) {
+            vector<cv::Point2f> reverse_pts = prev_pts;
+            vector<uchar> reverse_status;
+            if (!(FIXED_WINDOW_LK && FixedLK::calc(*job.cur_pyr, *job.prev_pyr, cur_pts, reverse_pts, reverse_status))) {
+                cv::calcOpticalFlowPyrLK(*job.cur_pyr, *job.prev_pyr, cur_pts, reverse_pts, reverse_status, err, WIN_SIZE, PYR_LEVEL,
+                    cv::TermCriteria(cv::TermCriteria::COUNT+cv::TermCriteria::EPS, 30, 0.01), cv::OPTFLOW_USE_INITIAL_FLOW);
+            }
+            for (size_t i = 0; i < st.size(); i ++) {
+                st[i] = st[i] && reverse_status[i] && distance(prev_pts[i], reverse_pts[i]) <= 0.5;
+            }
+        }
+
+        auto & job_status = status[chunks[c].first];
+        for (size_t i = 0; i < st.size(); i ++) {
+            job.cur_pts[begin + i] = cur_pts[i];
+            job_status[begin + i] = st[i] && inBorder(cur_pts[i], job.img_size);
+        }
+    }
+
+    for (size_t j = 0; j < jobs.size(); j ++) {
+        auto & job = jobs[j];
+        reduceVector(*job.prev_pts, status[j]);
+        reduceVector(job.cur_pts, status[j]);
+        reduceVector(*job.ids, status[j]);
+        if (job.track_cnt->size() > 0) {
+            reduceVector(*job.track_cnt, status[j]);
+        }
+
+        for (auto &n : *job.track_cnt)
+            n++;
+    }
+}
+
 map<int, cv::Point2f> pts_map(vector<int> ids, vector<cv::Point2f> cur_pts) {
     map<int, cv::Point2f> prevMap;
     for (unsigned int i = 0; i < ids.size(); i ++) {
@@ -333,8 +441,9 @@ void BaseFeatureTracker::drawTrackImage(cv::Mat & img, vector<cv::Point2f> pts,
         //Not solving
         //Just New point yellow
         cv::Scalar color = cv::Scalar(0, 255, 255);
-        if (pts_status.find(ids[j]) != pts_status.end()) {
-            int status = pts_status[ids[j]];
+        auto status_ptr = pts_status.find(ids[j]);
+        if (status_ptr != nullptr) {
+            int status = *status_ptr;
             if (status < 0) {
                 //Removed points
                 color = cv::Scalar(0, 0, 0);
@@ -387,11 +496,10 @@ void BaseFeatureTracker::drawTrackImage(cv::Mat & img, vector<cv::Point2f> pts,
 #ifndef WITHOUT_CUDA
 vector<cv::Point2f> opticalflow_track(cv::cuda::GpuMat & cur_img, 
                         std::vector<cv::cuda::GpuMat> & prev_pyr, vector<cv::Point2f> & prev_pts, 
-                        vector<int> & ids, vector<int> & track_cnt, std::set<int> removed_pts,
-                        bool is_lr_track, std::map<int, cv::Point2f> prediction_points) {
+                        vector<int> & ids, vector<int> & track_cnt, const FeatureIdTable<bool> & removed_pts,
+                        bool is_lr_track, const FeatureIdTable<cv::Point2f> * prediction_points) {
 
 
-    TicToc tic1;
     auto cur_pyr = buildImagePyramid(cur_img);
     
     if (prev_pts.size() == 0) {
@@ -405,7 +513,7 @@ vector<cv::Point2f> opticalflow_track(cv::cuda::GpuMat & cur_img,
 
     for (size_t i = 0; i < ids.size(); i ++) {
         int _id = ids[i];
-        if (removed_pts.find(_id) == removed_pts.end()) {
+        if (!removed_pts.contains(_id)) {
             status.push_back(1);
         } else {
             status.push_back(0);
@@ -426,7 +534,6 @@ vector<cv::Point2f> opticalflow_track(cv::cuda::GpuMat & cur_img,
 
     vector<cv::Point2f> cur_pts = get_predict_pts(ids, prev_pts, prediction_points);
 
-    TicToc t_og;
     cv::cuda::GpuMat prev_gpu_pts(prev_pts);
     cv::cuda::GpuMat cur_gpu_pts(cur_pts);
     cv::cuda::GpuMat gpu_status;
@@ -470,7 +577,6 @@ vector<cv::Point2f> opticalflow_track(cv::cuda::GpuMat & cur_img,
                 status[i] = 0;
         }
     }
-    // printf("gpu temporal optical flow costs: %f ms\n",t_og.toc());
     for (int i = 0; i < int(cur_pts.size()); i++){
         if (status[i] && !inBorder(cur_pts[i], cur_img.size())) {
             status[i] = 0;
@@ -483,10 +589,6 @@ vector<cv::Point2f> opticalflow_track(cv::cuda::GpuMat & cur_img,
         reduceVector(track_cnt, status);
     }
 
-    if (ENABLE_PERF_OUTPUT) {
-        ROS_INFO("Optical flow costs: %fms Pts %ld", t_og.toc(), ids.size());
-    }
-
     //printf("track cnt %d\n", (int)ids.size());
     if (!is_lr_track)
         prev_pyr = cur_pyr;
@@ -517,7 +619,6 @@ void detectPoints(const cv::cuda::GpuMat & img, vector<cv::Point2f> & n_pts,
         vector<cv::Point2f> & cur_pts, int require_pts) {
     int lack_up_top_pts = require_pts - static_cast<int>(cur_pts.size());
 
-    TicToc tic;
     
 
     if (lack_up_top_pts > require_pts/4) {
@@ -570,9 +671,6 @@ void detectPoints(const cv::cuda::GpuMat & img, vector<cv::Point2f> & n_pts,
     else {
         n_pts.clear();
     }
-#ifdef PERF_OUTPUT
-    ROS_INFO("Detected %ld npts %fms", n_pts.size(), tic.toc());
-#endif
 
 }
 
@@ -16,6 +16,7 @@
 #include <queue>
 #include <execinfo.h>
 #include <csignal>
+#include <atomic>
 #include <opencv2/opencv.hpp>
 #include <eigen3/Eigen/Dense>
 
@@ -26,29 +27,39 @@
 #include "camodocal/camera_models/PinholeCamera.h"
 #include "../estimator/parameters.h"
 #include "../utility/tic_toc.h"
+#include "../utility/perf.h"
+#include "fixed_window_lk.hpp"
+#include "feature_id_table.h"
+#include "feature_frame.h"
 
 #ifdef WITH_VWORKS
 #include "vworks_feature_tracker.hpp"
 #endif
 
 #define PYR_LEVEL 3
-#define WIN_SIZE cv::Size(21, 21)
+#define LK_WIN 21
+#define WIN_SIZE cv::Size(LK_WIN, LK_WIN)
 
 using namespace std;
 using namespace camodocal;
 using namespace Eigen;
 
 
-typedef Eigen::Matrix<double, 8, 1> TrackFeatureNoId;
-typedef pair<int, TrackFeatureNoId> TrackFeature;
-typedef vector<TrackFeature> FeatureFramenoId;
-typedef map<int, FeatureFramenoId> FeatureFrame;
-
 class Estimator;
 class FisheyeUndist;
 
 namespace FeatureTracker {
 
+typedef FixedWindowLK<LK_WIN, PYR_LEVEL> FixedLK;
+
+//Outputs of one tracked view, referenced by the feature frame builder
+struct FeatureFrameView {
+    const vector<int> * ids;
+    const vector<cv::Point2f> * pts;
+    const vector<cv::Point3f> * un_pts;
+    const vector<cv::Point3f> * vel;
+    int camera_id;
+};
 
 class BaseFeatureTracker {
 public:
@@ -61,18 +72,26 @@ public:
     
     virtual void setPrediction(const map<int, Eigen::Vector3d> &predictPts_cam0, const map<int, Eigen::Vector3d> &predictPt_cam1 =  map<int, Eigen::Vector3d>()) = 0;
 
+    //Predict the next image by rotating the last tracked bearings, R_c is previous to next camera rotation
+    virtual void setRotationPrediction(const Eigen::Matrix3d & R_c0, const Eigen::Matrix3d & R_c1) {}
+
     virtual FeatureFrame trackImage(double _cur_time, cv::InputArray _img, 
         cv::InputArray _img1 = cv::noArray()) = 0;
     
     void setFeatureStatus(int feature_id, int status) {
-        this->pts_status[feature_id] = status;
+        this->pts_status.set(feature_id, status);
         if (status < 0) {
-            removed_pts.insert(feature_id);
+            removed_pts.set(feature_id, true);
         }
     }
 
     virtual void readIntrinsicParameter(const vector<string> &calib_file) = 0;
 
+    //Scale of the detected feature count, lowered by the backend when overloaded
+    void setDetectScale(double scale) {
+        detect_scale = scale;
+    }
+
 protected:
     bool hasPrediction = false;
     int n_id = 0;
@@ -82,14 +101,20 @@ protected:
     int height, width;
 
     Estimator * estimator = nullptr;
+
+    std::atomic<double> detect_scale{1.0};
+    int scaled_pts_cnt(int cnt) const {
+        return cnt * detect_scale.load();
+    }
     
-    void setup_feature_frame(FeatureFrame & ff, vector<int> ids, vector<cv::Point2f> cur_pts, vector<cv::Point3f> cur_un_pts, vector<cv::Point3f> cur_pts_vel, int camera_id);
+    //Views must be given camera 0 first
+    static void setup_feature_frame(FeatureFrame & ff, const vector<FeatureFrameView> & views);
     virtual FeatureFrame setup_feature_frame() = 0;
 
     void drawTrackImage(cv::Mat & img, vector<cv::Point2f> pts, vector<int> ids, map<int, cv::Point2f> prev_pts, map<int, cv::Point2f> predictions = map<int, cv::Point2f>());
 
-    map<int, int> pts_status;
-    set<int> removed_pts;
+    FeatureIdTable<int> pts_status;
+    FeatureIdTable<bool> removed_pts;
 
     vector<camodocal::CameraPtr> m_camera;
 
@@ -105,27 +130,75 @@ double distance(cv::Point2f &pt1, cv::Point2f &pt2);
 #ifndef WITHOUT_CUDA
 vector<cv::Point2f> opticalflow_track(cv::cuda::GpuMat & cur_img, 
                     std::vector<cv::cuda::GpuMat> & prev_pyr, vector<cv::Point2f> & prev_pts, 
-                    vector<int> & ids, vector<int> & track_cnt, std::set<int> removed_pts,
-                    bool is_lr_track, std::map<int, cv::Point2f> prediction_points = std::map<int, cv::Point2f>());
+                    vector<int> & ids, vector<int> & track_cnt, const FeatureIdTable<bool> & removed_pts,
+                    bool is_lr_track, const FeatureIdTable<cv::Point2f> * prediction_points = nullptr);
 
 std::vector<cv::cuda::GpuMat> buildImagePyramid(const cv::cuda::GpuMat& prevImg, int maxLevel_ = 3);
 void detectPoints(const cv::cuda::GpuMat & img, vector<cv::Point2f> & n_pts, 
         vector<cv::Point2f> & cur_pts, int require_pts);
 #endif
 
-vector<cv::Point2f> get_predict_pts(vector<int> id, const vector<cv::Point2f> & cur_pt, const std::map<int, cv::Point2f> & predict);
+vector<cv::Point2f> get_predict_pts(const vector<int> & ids, const vector<cv::Point2f> & cur_pt, const FeatureIdTable<cv::Point2f> * predict);
     
 vector<cv::Point2f> opticalflow_track(vector<cv::Mat> * cur_pyr, 
                     vector<cv::Mat> * prev_pyr, vector<cv::Point2f> & prev_pts, 
-                    vector<int> & ids, vector<int> & track_cnt, std::set<int> removed_pts, std::map<int, cv::Point2f> prediction_points = std::map<int, cv::Point2f>());
+                    vector<int> & ids, vector<int> & track_cnt, const FeatureIdTable<bool> & removed_pts, const FeatureIdTable<cv::Point2f> * prediction_points = nullptr);
 
 vector<cv::Point2f> opticalflow_track(cv::Mat & cur_img, vector<cv::Mat> * cur_pyr, 
                     cv::Mat & prev_img, vector<cv::Mat> * prev_pyr, vector<cv::Point2f> & prev_pts, 
-                    vector<int> & ids, vector<int> & track_cnt, std::set<int> removed_pts, std::map<int, cv::Point2f> prediction_points = std::map<int, cv::Point2f>());
+                    vector<int> & ids, vector<int> & track_cnt, const FeatureIdTable<bool> & removed_pts, const FeatureIdTable<cv::Point2f> * prediction_points = nullptr);
+
+//One pyramid pair and point list of a batched LK call
+struct LKTrackJob {
+    cv::Size img_size;
+    vector<cv::Mat> * cur_pyr = nullptr;
+    vector<cv::Mat> * prev_pyr = nullptr;
+    vector<cv::Point2f> * prev_pts = nullptr;
+    vector<int> * ids = nullptr;
+    vector<int> * track_cnt = nullptr;
+    const FeatureIdTable<cv::Point2f> * prediction = nullptr;
+    //Output, aligned with the reduced prev_pts, ids and track_cnt
+    vector<cv::Point2f> cur_pts;
+};
+
+//Track all jobs of a frame together. Points of every job are split into fixed size chunks
+//which idle threads keep taking from a shared queue, so a view with most of the points
+//no longer keeps the other threads waiting. Forward and FLOW_BACK passes run on the same chunk.
+void opticalflow_track_batch(vector<LKTrackJob> & jobs, const FeatureIdTable<bool> & removed_pts);
+
+//Double buffered optical flow pyramids of one view.
+//Level and derivative buffers stay allocated across frames: buildOpticalFlowPyramid only
+//reallocates a level when its size changes, and writes pyrDown/Scharr output into it in place.
+class PyramidPool {
+public:
+    //Build into the current slot; the previous slot is left untouched for tracking against it
+    vector<cv::Mat> * build(const cv::Mat & img);
+
+    vector<cv::Mat> * current() {
+        return &pyrs[cur];
+    }
+
+    vector<cv::Mat> * previous() {
+        return pyrs[cur^1].empty() ? nullptr : &pyrs[cur^1];
+    }
+
+    //Current pyramid becomes previous one, its old buffers are reused by the next build
+    void swap() {
+        cur ^= 1;
+    }
+
+protected:
+    vector<cv::Mat> pyrs[2];
+    int cur = 0;
+};
 
 std::vector<cv::Point2f> detect_orb_by_region(cv::InputArray _img, cv::InputArray _mask, int features, int cols = 4, int rows = 4);
 void detectPoints(cv::InputArray img, cv::InputArray mask, vector<cv::Point2f> & n_pts, vector<cv::Point2f> & cur_pts, int require_pts);
 
+//Bucketed Shi-Tomasi detection on the level 0 gradients of a pyramid built with derivatives.
+//Only grid cells short of tracked points are scanned, so the cost follows the number of lost points
+void detectPointsGrid(const vector<cv::Mat> & pyr, vector<cv::Point2f> & n_pts, const vector<cv::Point2f> & cur_pts, int require_pts);
+
 
 bool inBorder(const cv::Point2f &pt, cv::Size shape);
 
@@ -25,18 +25,25 @@ public:
     }
 
     virtual void setPrediction(const map<int, Eigen::Vector3d> &predictPts_cam0, const map<int, Eigen::Vector3d> &predictPt_cam1 =  map<int, Eigen::Vector3d>()) override;
+    virtual void setRotationPrediction(const Eigen::Matrix3d & R_c0, const Eigen::Matrix3d & R_c1) override;
 
 protected:
     virtual FeatureFrame setup_feature_frame() override;
     
     std::mutex set_predict_lock;
 
+    void addPrediction(FisheyeUndist & fisheye, int _id, const Eigen::Vector3d & pt,
+        FeatureIdTable<cv::Point2f> & predict_top, FeatureIdTable<cv::Point2f> & predict_side);
+    void addRotationPrediction(FisheyeUndist & fisheye, const Eigen::Matrix3d & R_c, const vector<int> & ids,
+        const vector<cv::Point3f> & un_pts, FeatureIdTable<cv::Point2f> & predict_top, FeatureIdTable<cv::Point2f> & predict_side);
+
     void addPointsFisheye();
 
     vector<cv::Point3f> undistortedPtsTop(vector<cv::Point2f> &pts, FisheyeUndist & fisheye);
     vector<cv::Point3f> undistortedPtsSide(vector<cv::Point2f> &pts, FisheyeUndist & fisheye, bool is_downward);
-    vector<cv::Point3f> ptsVelocity3D(vector<int> &ids, vector<cv::Point3f> &pts, 
-                                    map<int, cv::Point3f> &cur_id_pts, map<int, cv::Point3f> &prev_id_pts);
+    void liftPtsBatch(const vector<cv::Point2f> &pts, const Eigen::Matrix3d * M, int views, vector<cv::Point3f> &un_pts);
+    vector<cv::Point3f> ptsVelocity3D(const vector<int> &ids, const vector<cv::Point3f> &pts, 
+                                    const vector<int> &prev_ids, const vector<cv::Point3f> &prev_pts);
 
         
     virtual void drawTrackFisheye(const cv::Mat & img_up, const cv::Mat & img_down, 
@@ -51,7 +58,7 @@ protected:
     cv::Size side_size;
 
     vector<cv::Point2f> n_pts_up_top, n_pts_down_top, n_pts_up_side;
-    std::map<int, cv::Point2f> predict_up_side, predict_up_top, predict_down_top, predict_down_side;
+    FeatureIdTable<cv::Point2f> predict_up_side, predict_up_top, predict_down_top, predict_down_side;
     vector<cv::Point2f> prev_up_top_pts, cur_up_top_pts, prev_up_side_pts, cur_up_side_pts, prev_down_top_pts, prev_down_side_pts;
     
     vector<cv::Point3f> prev_up_top_un_pts,  prev_up_side_un_pts, prev_down_top_un_pts, prev_down_side_un_pts;
@@ -72,10 +79,12 @@ protected:
     vector<int> track_up_side_cnt;
     vector<int> track_down_side_cnt;
 
-    map<int, cv::Point3f> cur_up_top_un_pts_map, prev_up_top_un_pts_map;
-    map<int, cv::Point3f> cur_down_top_un_pts_map, prev_down_top_un_pts_map;
-    map<int, cv::Point3f> cur_up_side_un_pts_map, prev_up_side_un_pts_map;
-    map<int, cv::Point3f> cur_down_side_un_pts_map, prev_down_side_un_pts_map;
+    //Ids of prev_*_un_pts, index aligned
+    vector<int> prev_ids_up_top, prev_ids_up_side, prev_ids_down_top, prev_ids_down_side;
+    //Only used when a tracker does not keep ids in increasing order
+    FeatureIdTable<int> velocity_index;
+
+    void swapFramePts();
     
     CvMat prev_up_top_img, prev_up_side_img, prev_down_top_img;
 
@@ -122,10 +131,35 @@ class FisheyeFeatureTrackerOpenMP: public BaseFisheyeFeatureTracker<cv::Mat> {
 
         virtual FeatureFrame trackImage(double _cur_time, cv::InputArray fisheye_imgs_up, cv::InputArray fisheye_imgs_down) override;
     protected:
-        std::vector<cv::Mat> * prev_up_top_pyr = nullptr, * prev_down_top_pyr = nullptr, * prev_up_side_pyr = nullptr;
+        PyramidPool up_top_pyrs, down_top_pyrs, up_side_pyrs;
+        //Down side is only tracked against the current up side, a single slot is enough
+        PyramidPool down_side_pyrs;
 
 };
 
+//Tracks on the raw fisheye images without flattening, points are lifted with the camera model.
+//Up and down cameras are tracked as two mono cameras in the up_top/down_top slots, side slots stay empty.
+//No feature is stereo matched, so the estimator initializes through the mono + IMU path.
+class FisheyeFeatureTrackerDirect: public BaseFisheyeFeatureTracker<cv::Mat> {
+    public:
+        FisheyeFeatureTrackerDirect(Estimator * _estimator): BaseFisheyeFeatureTracker<cv::Mat>(_estimator) {
+        }
+
+        virtual FeatureFrame trackImage(double _cur_time, cv::InputArray fisheye_raw_up, cv::InputArray fisheye_raw_down) override;
+        virtual void setPrediction(const map<int, Eigen::Vector3d> &predictPts_cam0, const map<int, Eigen::Vector3d> &predictPt_cam1 =  map<int, Eigen::Vector3d>()) override;
+        virtual void setRotationPrediction(const Eigen::Matrix3d & R_c0, const Eigen::Matrix3d & R_c1) override;
+    protected:
+        PyramidPool up_pyrs, down_pyrs;
+        //Pixels inside the fisheye fov, built on the first image
+        cv::Mat fov_masks[2];
+
+        cv::Mat fovMask(const camodocal::CameraPtr & cam, cv::Size size) const;
+        void reduceByFov(const cv::Mat & fov_mask, vector<cv::Point2f> & pts, vector<int> & ids, vector<int> & track_cnt);
+        vector<cv::Point3f> liftPtsRaw(const vector<cv::Point2f> & pts, const camodocal::CameraPtr & cam);
+        void addRawPrediction(int cam_id, int _id, const Eigen::Vector3d & pt, FeatureIdTable<cv::Point2f> & predict);
+        void drawTrackRaw(const cv::Mat & img_up, const cv::Mat & img_down);
+};
+
 class FisheyeFeatureTrackerVWorks: public FisheyeFeatureTrackerCuda {
 public:
     virtual FeatureFrame trackImage(double _cur_time, cv::InputArray fisheye_imgs_up, cv::InputArray fisheye_imgs_down) override;
@@ -174,35 +208,57 @@ void BaseFisheyeFeatureTracker<CvMat>::setPrediction(const map<int, Eigen::Vecto
     predict_down_side.clear();
 
     for (auto it : predictPts_cam0) {
-        int _id = it.first;
-        auto pt = it.second;
-        auto ret = fisheys_undists[0].project_point_to_vcam_id(pt);
-        if (ret.first >= 0 ) {
-            if (ret.first == 0){
-                predict_up_top[_id] = ret.second;
-            } else if (ret.first > 1) {
-                cv::Point2f pt(ret.second.x + (ret.first - 1)*WIDTH, ret.second.y);
-                predict_up_side[_id] = pt;
-            } 
-        }
+        addPrediction(fisheys_undists[0], it.first, it.second, predict_up_top, predict_up_side);
     }
 
     for (auto it : predictPts_cam1) {
-        int _id = it.first;
-        auto pt = it.second;
-        auto ret = fisheys_undists[1].project_point_to_vcam_id(pt);
-        if (ret.first >= 0 ) {
-            if (ret.first == 0){
-                predict_down_top[_id] = ret.second;
-            } else if (ret.first > 1) {
-                cv::Point2f pt(ret.second.x + (ret.first - 1)*WIDTH, ret.second.y);
-                predict_down_side[_id] = pt;
-            } 
-        }
+        addPrediction(fisheys_undists[1], it.first, it.second, predict_down_top, predict_down_side);
     }
     set_predict_lock.unlock();
 }
 
+template<class CvMat>
+void BaseFisheyeFeatureTracker<CvMat>::setRotationPrediction(const Eigen::Matrix3d & R_c0, const Eigen::Matrix3d & R_c1) {
+    set_predict_lock.lock();
+    predict_up_top.clear();
+    predict_up_side.clear();
+    predict_down_top.clear();
+    predict_down_side.clear();
+
+    addRotationPrediction(fisheys_undists[0], R_c0, ids_up_top, prev_up_top_un_pts, predict_up_top, predict_up_side);
+    addRotationPrediction(fisheys_undists[0], R_c0, ids_up_side, prev_up_side_un_pts, predict_up_top, predict_up_side);
+    addRotationPrediction(fisheys_undists[1], R_c1, ids_down_top, prev_down_top_un_pts, predict_down_top, predict_down_side);
+    addRotationPrediction(fisheys_undists[1], R_c1, ids_down_side, prev_down_side_un_pts, predict_down_top, predict_down_side);
+    set_predict_lock.unlock();
+}
+
+//Point in camera frame to the top or side virtual camera it falls in
+template<class CvMat>
+void BaseFisheyeFeatureTracker<CvMat>::addPrediction(FisheyeUndist & fisheye, int _id, const Eigen::Vector3d & pt,
+        FeatureIdTable<cv::Point2f> & predict_top, FeatureIdTable<cv::Point2f> & predict_side) {
+    auto ret = fisheye.project_point_to_vcam_id(pt);
+    if (ret.first == 0) {
+        predict_top.set(_id, ret.second);
+    } else if (ret.first > 1) {
+        predict_side.set(_id, cv::Point2f(ret.second.x + (ret.first - 1)*WIDTH, ret.second.y));
+    }
+}
+
+//Pure rotation: bearings of the last image seen from the next camera pose, translation is ignored
+template<class CvMat>
+void BaseFisheyeFeatureTracker<CvMat>::addRotationPrediction(FisheyeUndist & fisheye, const Eigen::Matrix3d & R_c,
+        const vector<int> & ids, const vector<cv::Point3f> & un_pts,
+        FeatureIdTable<cv::Point2f> & predict_top, FeatureIdTable<cv::Point2f> & predict_side) {
+    if (ids.size() != un_pts.size()) {
+        return;
+    }
+    Eigen::Matrix3d R_inv = R_c.transpose();
+    for (size_t i = 0; i < ids.size(); i ++) {
+        Eigen::Vector3d pt(un_pts[i].x, un_pts[i].y, un_pts[i].z);
+        addPrediction(fisheye, ids[i], R_inv * pt, predict_top, predict_side);
+    }
+}
+
 template<class CvMat>
 void BaseFisheyeFeatureTracker<CvMat>::drawTrackFisheye(const cv::Mat & img_up,
     const cv::Mat & img_down,
@@ -272,19 +328,19 @@ void BaseFisheyeFeatureTracker<CvMat>::drawTrackFisheye(const cv::Mat & img_up,
     }
 
     if(enable_up_top) {
-        drawTrackImage(imUpTop, cur_up_top_pts, ids_up_top, up_top_prevLeftPtsMap, predict_up_top);
+        drawTrackImage(imUpTop, cur_up_top_pts, ids_up_top, up_top_prevLeftPtsMap);
     }
 
     if(enable_down_top) {
-        drawTrackImage(imDownTop, cur_down_top_pts, ids_down_top, down_top_prevLeftPtsMap, predict_down_top);
+        drawTrackImage(imDownTop, cur_down_top_pts, ids_down_top, down_top_prevLeftPtsMap);
     }
 
     if(enable_up_side) {
-        drawTrackImage(imUpSide, cur_up_side_pts, ids_up_side, up_side_prevLeftPtsMap, predict_up_side);
+        drawTrackImage(imUpSide, cur_up_side_pts, ids_up_side, up_side_prevLeftPtsMap);
     }
 
     if(enable_down_side) {
-        drawTrackImage(imDownSide, cur_down_side_pts, ids_down_side, pts_map(ids_up_side, cur_up_side_pts), predict_down_side);
+        drawTrackImage(imDownSide, cur_down_side_pts, ids_down_side, pts_map(ids_up_side, cur_up_side_pts));
     }
 
     //Show images
@@ -343,54 +399,72 @@ void BaseFisheyeFeatureTracker<CvMat>::readIntrinsicParameter(const vector<strin
 }
 
 template<class CvMat>
-vector<cv::Point3f> BaseFisheyeFeatureTracker<CvMat>::ptsVelocity3D(vector<int> &ids, vector<cv::Point3f> &cur_pts, 
-                                            map<int, cv::Point3f> &cur_id_pts, map<int, cv::Point3f> &prev_id_pts)
+vector<cv::Point3f> BaseFisheyeFeatureTracker<CvMat>::ptsVelocity3D(const vector<int> &ids, const vector<cv::Point3f> &cur_pts, 
+                                            const vector<int> &prev_ids, const vector<cv::Point3f> &prev_pts)
 {
-    // ROS_INFO("Pts %ld Prev pts %ld IDS %ld", cur_pts.size(), prev_id_pts.size(), ids.size());
-    vector<cv::Point3f> pts_velocity;
-    cur_id_pts.clear();
-    for (unsigned int i = 0; i < ids.size(); i++)
-    {
-        cur_id_pts[ids[i]] = cur_pts[i];
+    vector<cv::Point3f> pts_velocity(cur_pts.size(), cv::Point3f(0, 0, 0));
+    if (prev_ids.size() != prev_pts.size() || ids.size() != cur_pts.size()) {
+        return pts_velocity;
     }
 
-    // caculate points velocity
-    if (!prev_id_pts.empty())
-    {
-        double dt = cur_time - prev_time;
-        
-        for (unsigned int i = 0; i < cur_pts.size(); i++)
-        {
-            std::map<int, cv::Point3f>::iterator it;
-            it = prev_id_pts.find(ids[i]);
-            if (it != prev_id_pts.end())
-            {
-                double v_x = (cur_pts[i].x - it->second.x) / dt;
-                double v_y = (cur_pts[i].y - it->second.y) / dt;
-                double v_z = (cur_pts[i].z - it->second.z) / dt;
-                pts_velocity.push_back(cv::Point3f(v_x, v_y, v_z));
-                // ROS_INFO("id %d Dt %f, cur pts %f %f %f prev %f %f %f vel %f %f %f", 
-                //     ids[i],
-                //     cur_pts[i].x, cur_pts[i].y, cur_pts[i].z,
-                //     it->second.x, it->second.y, it->second.z,
-                //     v_x, v_y, v_z);
-
+    //Index of the previous point for each current point, -1 for new points
+    vector<int> prev_index(ids.size(), -1);
+    if (std::is_sorted(ids.begin(), ids.end()) && std::is_sorted(prev_ids.begin(), prev_ids.end())) {
+        //Tracking keeps the order of ids and new ids are appended increasing, so a single merge pass
+        size_t j = 0;
+        for (size_t i = 0; i < ids.size(); i++) {
+            while (j < prev_ids.size() && prev_ids[j] < ids[i]) {
+                j++;
+            }
+            if (j < prev_ids.size() && prev_ids[j] == ids[i]) {
+                prev_index[i] = j;
+            }
+        }
+    } else {
+        velocity_index.clear();
+        for (size_t j = 0; j < prev_ids.size(); j++) {
+            velocity_index.set(prev_ids[j], j);
+        }
+        for (size_t i = 0; i < ids.size(); i++) {
+            auto j = velocity_index.find(ids[i]);
+            if (j != nullptr) {
+                prev_index[i] = *j;
             }
-            else
-                pts_velocity.push_back(cv::Point3f(0, 0, 0));
-
         }
     }
-    else
-    {
-        for (unsigned int i = 0; i < cur_pts.size(); i++)
-        {
-            pts_velocity.push_back(cv::Point3f(0, 0, 0));
+
+    float inv_dt = 1.0 / (cur_time - prev_time);
+    const cv::Point3f * cur = cur_pts.data();
+    const cv::Point3f * prev = prev_pts.data();
+    cv::Point3f * vel = pts_velocity.data();
+    const int * index = prev_index.data();
+    #pragma omp simd
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (index[i] >= 0) {
+            const cv::Point3f & p = prev[index[i]];
+            vel[i] = cv::Point3f((cur[i].x - p.x) * inv_dt, (cur[i].y - p.y) * inv_dt, (cur[i].z - p.z) * inv_dt);
         }
     }
     return pts_velocity;
 }
 
+template<class CvMat>
+void BaseFisheyeFeatureTracker<CvMat>::swapFramePts()
+{
+    prev_ids_up_top = ids_up_top;
+    prev_ids_down_top = ids_down_top;
+    prev_ids_up_side = ids_up_side;
+    prev_ids_down_side = ids_down_side;
+
+    //Only drawn when showing the tracking image
+    if (SHOW_TRACK) {
+        up_top_prevLeftPtsMap = pts_map(ids_up_top, cur_up_top_pts);
+        down_top_prevLeftPtsMap = pts_map(ids_down_top, cur_down_top_pts);
+        up_side_prevLeftPtsMap = pts_map(ids_up_side, cur_up_side_pts);
+        down_side_prevLeftPtsMap = pts_map(ids_down_side, cur_down_side_pts);
+    }
+}
+
 template<class CvMat>
 void BaseFisheyeFeatureTracker<CvMat>::addPointsFisheye()
 {
@@ -419,30 +493,26 @@ void BaseFisheyeFeatureTracker<CvMat>::addPointsFisheye()
 
 template<class CvMat>
 vector<cv::Point3f> BaseFisheyeFeatureTracker<CvMat>::undistortedPtsTop(vector<cv::Point2f> &pts, FisheyeUndist & fisheye) {
-    auto & cam = fisheye.cam_top;
+    //Top view is an ideal pinhole, lifting is just K^-1
+    double cx = fisheye.imgWidth / 2;
+    Eigen::Matrix3d K_inv;
+    K_inv << 1/fisheye.f_center, 0, -cx/fisheye.f_center,
+             0, 1/fisheye.f_center, -cx/fisheye.f_center,
+             0, 0, 1;
     vector<cv::Point3f> un_pts;
-    for (unsigned int i = 0; i < pts.size(); i++)
-    {
-        Eigen::Vector2d a(pts[i].x, pts[i].y);
-        Eigen::Vector3d b;
-        cam->liftProjective(a, b);
-        b.normalize();
-#ifdef UNIT_SPHERE_ERROR
-        un_pts.push_back(cv::Point3f(b.x(), b.y(), b.z()));
-#else
-        un_pts.push_back(cv::Point3f(b.x() / b.z(), b.y() / b.z(), 1));
-#endif
-    }
+    liftPtsBatch(pts, &K_inv, 1, un_pts);
     return un_pts;
 }
 
 template<class CvMat>
 FeatureFrame BaseFisheyeFeatureTracker<CvMat>::setup_feature_frame() {
     FeatureFrame ff;
-    BaseFeatureTracker::setup_feature_frame(ff, ids_up_top, cur_up_top_pts, cur_up_top_un_pts, up_top_vel, 0);   
-    BaseFeatureTracker::setup_feature_frame(ff, ids_up_side, cur_up_side_pts, cur_up_side_un_pts, up_side_vel, 0);
-    BaseFeatureTracker::setup_feature_frame(ff, ids_down_top, cur_down_top_pts, cur_down_top_un_pts, down_top_vel, 1);
-    BaseFeatureTracker::setup_feature_frame(ff, ids_down_side, cur_down_side_pts, cur_down_side_un_pts, down_side_vel, 1);
+    BaseFeatureTracker::setup_feature_frame(ff, {
+        {&ids_up_top, &cur_up_top_pts, &cur_up_top_un_pts, &up_top_vel, 0},
+        {&ids_up_side, &cur_up_side_pts, &cur_up_side_un_pts, &up_side_vel, 0},
+        {&ids_down_top, &cur_down_top_pts, &cur_down_top_un_pts, &down_top_vel, 1},
+        {&ids_down_side, &cur_down_side_pts, &cur_down_side_un_pts, &down_side_vel, 1}
+    });
 
     return ff;
 }
@@ -450,59 +520,59 @@ FeatureFrame BaseFisheyeFeatureTracker<CvMat>::setup_feature_frame() {
 
 template<class CvMat>
 vector<cv::Point3f> BaseFisheyeFeatureTracker<CvMat>::undistortedPtsSide(vector<cv::Point2f> &pts, FisheyeUndist & fisheye, bool is_downward) {
-    auto & cam = fisheye.cam_side;
-    std::vector<cv::Point3f> un_pts;
-    //Need to rotate pts
-    //Side pos 1,2,3,4 is left front right
+    //Side pos 1,2,3,4 is left front right rear, concated along x with width WIDTH
     //For downward camera, additational rotate 180 deg on x is required
+    Eigen::Matrix3d K_inv;
+    K_inv << 1/fisheye.f_side, 0, -fisheye.cx_side/fisheye.f_side,
+             0, 1/fisheye.f_side, -fisheye.cy_side/fisheye.f_side,
+             0, 0, 1;
+    Eigen::Quaterniond t_sides[4] = {t1, t2, t3, t4};
+    Eigen::Matrix3d M[4];
+    for (int i = 0; i < 4; i ++) {
+        M[i] = (is_downward ? t_down * t_sides[i] : t_sides[i]).toRotationMatrix() * K_inv;
+    }
 
+    vector<cv::Point3f> un_pts;
+    liftPtsBatch(pts, M, 4, un_pts);
+    return un_pts;
+}
 
-    for (unsigned int i = 0; i < pts.size(); i++)
-    {
-        Eigen::Vector2d a(pts[i].x, pts[i].y);
-        Eigen::Vector3d b;
-        
-        int side_pos_id = floor(a.x() / WIDTH) + 1;
-
-        a.x() = a.x() - floor(a.x() / WIDTH)*WIDTH;
-
-        cam->liftProjective(a, b);
-
-        if (side_pos_id == 1) {
-            b = t1 * b;
-        } else if(side_pos_id == 2) {
-            b = t2 * b;
-        } else if (side_pos_id == 3) {
-            b = t3 * b;
-        } else if (side_pos_id == 4) {
-            b = t4 * b;
-        } else {
-            ROS_ERROR("Err pts img position; i %d side_pos_id %d!! x %f width %d", i, side_pos_id, a.x(), top_size.width);
-            assert(false &&"ERROR Pts img position");
+//Ray of each point is M[k] * (u - k*WIDTH, v, 1) with k the view it falls in, M folds K^-1 and the view rotation
+template<class CvMat>
+void BaseFisheyeFeatureTracker<CvMat>::liftPtsBatch(const vector<cv::Point2f> &pts, const Eigen::Matrix3d * M, int views, vector<cv::Point3f> &un_pts) {
+    float m[4][9];
+    for (int k = 0; k < views; k ++) {
+        for (int r = 0; r < 3; r ++) {
+            for (int c = 0; c < 3; c ++) {
+                m[k][r*3 + c] = M[k](r, c);
+            }
         }
+    }
 
-        if (is_downward) {
-            b = t_down * b;
-        }
+    un_pts.resize(pts.size());
+    const cv::Point2f * src = pts.data();
+    cv::Point3f * dst = un_pts.data();
+    int n = pts.size();
+    #pragma omp simd
+    for (int i = 0; i < n; i ++) {
+        float u = src[i].x, v = src[i].y;
+        int k = views > 1 ? std::min(std::max((int) std::floor(u / WIDTH), 0), views - 1) : 0;
+        u -= k * WIDTH;
+        const float * r = m[k];
+        float x = r[0]*u + r[1]*v + r[2];
+        float y = r[3]*u + r[4]*v + r[5];
+        float z = r[6]*u + r[7]*v + r[8];
+        float inv_norm = 1.f / std::sqrt(x*x + y*y + z*z);
+        dst[i] = cv::Point3f(x*inv_norm, y*inv_norm, z*inv_norm);
+    }
 
-        b.normalize();
-#ifdef UNIT_SPHERE_ERROR
-        un_pts.push_back(cv::Point3f(b.x(), b.y(), b.z()));
-#else
-        if (fabs(b.z()) < 1e-3) {
-            b.z() = 1e-3;
-        }
-        
-        if (b.z() < - 1e-2) {
-            //Is under plane, z is -1
-            un_pts.push_back(cv::Point3f(b.x() / b.z(), b.y() / b.z(), -1));
-        } else if (b.z() > 1e-2) {
-            //Is up plane, z is 1
-            un_pts.push_back(cv::Point3f(b.x() / b.z(), b.y() / b.z(), 1));
-        }
-#endif
+#ifndef UNIT_SPHERE_ERROR
+    //Normalized plane, divided by the signed z like the projection factors: z is 1 above and -1 under the plane
+    for (auto & p : un_pts) {
+        float z = p.z < 0 ? std::min(p.z, -1e-3f) : std::max(p.z, 1e-3f);
+        p = cv::Point3f(p.x / z, p.y / z, z < 0 ? -1.f : 1.f);
     }
-    return un_pts;
+#endif
 }
 
 };
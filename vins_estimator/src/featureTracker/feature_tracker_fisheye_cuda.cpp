@@ -56,17 +56,9 @@ std::vector<cv::Mat> convertCPUMat(const std::vector<cv::cuda::GpuMat> & arr) {
 FeatureFrame FisheyeFeatureTrackerCuda::trackImage(double _cur_time,   
     cv::InputArray img1, cv::InputArray img2) {
     cur_time = _cur_time;
-    static double detected_time_sum = 0;
-    static double ft_time_sum = 0;
-    static int count = 0;
-    
-    if (!is_blank_init) {
-        count += 1;
-    }
     CvCudaImages fisheye_imgs_up, fisheye_imgs_down;
     img1.getGpuMatVector(fisheye_imgs_up);
     img2.getGpuMatVector(fisheye_imgs_down);
-    TicToc t_r;
     cv::cuda::GpuMat up_side_img;
     cv::cuda::GpuMat down_side_img;
 
@@ -79,7 +71,6 @@ FeatureFrame FisheyeFeatureTrackerCuda::trackImage(double _cur_time,
     
     cv::cuda::GpuMat & up_top_img = fisheye_imgs_up[0];
     cv::cuda::GpuMat & down_top_img = fisheye_imgs_down[0];
-    double concat_cost = t_r.toc();
     TicToc t_ft;
     top_size = up_top_img.size();
     side_size = up_side_img.size();
@@ -115,43 +106,36 @@ FeatureFrame FisheyeFeatureTrackerCuda::trackImage(double _cur_time,
     if (enable_up_top) {
         // ROS_INFO("Tracking top");
         cur_up_top_pts = opticalflow_track(up_top_img, prev_up_top_pyr, prev_up_top_pts, 
-            ids_up_top, track_up_top_cnt, removed_pts, false, predict_up_top);
+            ids_up_top, track_up_top_cnt, removed_pts, false, &predict_up_top);
     }
     if (enable_up_side) {
         cur_up_side_pts = opticalflow_track(up_side_img, prev_up_side_pyr, prev_up_side_pts, 
-            ids_up_side, track_up_side_cnt, removed_pts, false, predict_up_side);
+            ids_up_side, track_up_side_cnt, removed_pts, false, &predict_up_side);
     }
 
     if (enable_down_top) {
         cur_down_top_pts = opticalflow_track(down_top_img, prev_down_top_pyr, prev_down_top_pts, 
-            ids_down_top, track_down_top_cnt, removed_pts, false, predict_down_top);
+            ids_down_top, track_down_top_cnt, removed_pts, false, &predict_down_top);
     }
     set_predict_lock.unlock();
 
-    ft_time_sum += t_ft.toc();
+    PERF_RECORD(PERF_LK, t_ft.toc());
     // setMaskFisheye();
 
-    if (ENABLE_PERF_OUTPUT) {
-        ROS_INFO("Optical flow 1 %fms", t_ft.toc());
-    }
     
     TicToc t_d;
     if (enable_up_top) {
-        detectPoints(up_top_img, n_pts_up_top, cur_up_top_pts, TOP_PTS_CNT);
+        detectPoints(up_top_img, n_pts_up_top, cur_up_top_pts, scaled_pts_cnt(TOP_PTS_CNT));
     }
     if (enable_down_top) {
-        detectPoints(down_top_img, n_pts_down_top, cur_down_top_pts, TOP_PTS_CNT);
+        detectPoints(down_top_img, n_pts_down_top, cur_down_top_pts, scaled_pts_cnt(TOP_PTS_CNT));
     }
 
     if (enable_up_side) {
-        detectPoints(up_side_img, n_pts_up_side, cur_up_side_pts, SIDE_PTS_CNT);
+        detectPoints(up_side_img, n_pts_up_side, cur_up_side_pts, scaled_pts_cnt(SIDE_PTS_CNT));
     }
 
-
-    if (ENABLE_PERF_OUTPUT) {
-        ROS_INFO("DetectPoints %fms", t_d.toc());
-    }
-    detected_time_sum = detected_time_sum + t_d.toc();
+    PERF_RECORD(PERF_DETECT, t_d.toc());
 
     addPointsFisheye();
 
@@ -160,17 +144,11 @@ FeatureFrame FisheyeFeatureTrackerCuda::trackImage(double _cur_time,
         ids_down_side = ids_up_side;
         std::vector<cv::Point2f> down_side_init_pts = cur_up_side_pts;
         cur_down_side_pts = opticalflow_track(down_side_img, prev_up_side_pyr, down_side_init_pts, ids_down_side, 
-            track_down_side_cnt, removed_pts, true, predict_down_side);
-        ft_time_sum += tic2.toc();
-        if (ENABLE_PERF_OUTPUT) {
-            ROS_INFO("Optical flow 2 %fms", tic2.toc());
-        }
+            track_down_side_cnt, removed_pts, true, &predict_down_side);
+        PERF_RECORD(PERF_LK, tic2.toc());
     }
 
     if (is_blank_init) {
-        detected_time_sum = 0;
-        ft_time_sum = 0;
-        count = 0;
         FeatureFrame ff;
 
         cur_up_top_pts.clear();
@@ -186,6 +164,7 @@ FeatureFrame FisheyeFeatureTrackerCuda::trackImage(double _cur_time,
     }
 
     //Undist points
+    TicToc t_un;
     cur_up_top_un_pts = undistortedPtsTop(cur_up_top_pts, fisheys_undists[0]);
     cur_down_top_un_pts = undistortedPtsTop(cur_down_top_pts, fisheys_undists[1]);
 
@@ -193,15 +172,14 @@ FeatureFrame FisheyeFeatureTrackerCuda::trackImage(double _cur_time,
     cur_down_side_un_pts = undistortedPtsSide(cur_down_side_pts, fisheys_undists[1], true);
 
     //Calculate Velocitys
-    //cur_up_top_un_pts_map is not been calculated!
-    up_top_vel = ptsVelocity3D(ids_up_top, cur_up_top_un_pts, cur_up_top_un_pts_map, prev_up_top_un_pts_map);
-    down_top_vel = ptsVelocity3D(ids_down_top, cur_down_top_un_pts, cur_down_top_un_pts_map, prev_down_top_un_pts_map);
+    up_top_vel = ptsVelocity3D(ids_up_top, cur_up_top_un_pts, prev_ids_up_top, prev_up_top_un_pts);
+    down_top_vel = ptsVelocity3D(ids_down_top, cur_down_top_un_pts, prev_ids_down_top, prev_down_top_un_pts);
 
-    up_side_vel = ptsVelocity3D(ids_up_side, cur_up_side_un_pts, cur_up_side_un_pts_map, prev_up_side_un_pts_map);
-    down_side_vel = ptsVelocity3D(ids_down_side, cur_down_side_un_pts, cur_down_side_un_pts_map, prev_down_side_un_pts_map);
+    up_side_vel = ptsVelocity3D(ids_up_side, cur_up_side_un_pts, prev_ids_up_side, prev_up_side_un_pts);
+    down_side_vel = ptsVelocity3D(ids_down_side, cur_down_side_un_pts, prev_ids_down_side, prev_down_side_un_pts);
+    PERF_RECORD(PERF_UNDISTORT, t_un.toc());
 
     // ROS_INFO("Up top VEL %ld", up_top_vel.size());
-    double tcost_all = t_r.toc();
     if (SHOW_TRACK) {
         drawTrackFisheye(cv::Mat(), cv::Mat(), up_top_img, down_top_img, up_side_img, down_side_img);
     }
@@ -216,29 +194,12 @@ FeatureFrame FisheyeFeatureTrackerCuda::trackImage(double _cur_time,
     prev_up_side_un_pts = cur_up_side_un_pts;
     prev_down_side_un_pts = cur_down_side_un_pts;
 
-    prev_up_top_un_pts_map = cur_up_top_un_pts_map;
-    prev_down_top_un_pts_map = cur_down_top_un_pts_map;
-    prev_up_side_un_pts_map = cur_up_side_un_pts_map;
-    prev_down_side_un_pts_map = cur_down_side_un_pts_map;
+    swapFramePts();
     prev_time = cur_time;
 
-    up_top_prevLeftPtsMap = pts_map(ids_up_top, cur_up_top_pts);
-    down_top_prevLeftPtsMap = pts_map(ids_down_top, cur_down_top_pts);
-    up_side_prevLeftPtsMap = pts_map(ids_up_side, cur_up_side_pts);
-    down_side_prevLeftPtsMap = pts_map(ids_down_side, cur_down_side_pts);
-
 
     // hasPrediction = false;
     auto ff = setup_feature_frame();
-
-    printf("%d: trackImage: %3.1fms; PT NUM: %ld, STEREO: %ld; Avg: GFTT %3.1fms LKFlow %3.1fms concat %3.1fms\n", 
-        count,
-        t_r.toc(), 
-        cur_up_top_un_pts.size() + cur_up_side_un_pts.size(),
-        cur_down_side_un_pts.size(),
-        detected_time_sum/count, 
-        ft_time_sum/count,
-        concat_cost);
     return ff;
 }
 #endif
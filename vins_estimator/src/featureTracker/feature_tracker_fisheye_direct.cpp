@@ -0,0 +1,243 @@
+#include "feature_tracker.h"
+#include "../estimator/estimator.h"
+#include "fisheye_undist.hpp"
+#include "feature_tracker_fisheye.hpp"
+
+namespace FeatureTracker {
+
+FeatureFrame FisheyeFeatureTrackerDirect::trackImage(double _cur_time, cv::InputArray img0, cv::InputArray img1) {
+    cur_time = _cur_time;
+
+    cv::Mat up_img = img0.getMat();
+    cv::Mat down_img = img1.getMat();
+
+    if (fov_masks[0].empty()) {
+        fov_masks[0] = fovMask(m_camera[0], up_img.size());
+        fov_masks[1] = fovMask(m_camera[1], down_img.size());
+    }
+
+    std::vector<cv::Mat> * up_pyr = nullptr, * down_pyr = nullptr;
+
+    cur_up_top_pts.clear();
+    cur_down_top_pts.clear();
+    cur_up_top_un_pts.clear();
+    cur_down_top_un_pts.clear();
+
+    TicToc t_pyr;
+    #pragma omp parallel sections
+    {
+        #pragma omp section
+        {
+            up_pyr = up_pyrs.build(up_img);
+        }
+
+        #pragma omp section
+        {
+            down_pyr = down_pyrs.build(down_img);
+        }
+    }
+    PERF_RECORD(PERF_PYRAMID, t_pyr.toc());
+
+    TicToc t_t;
+    set_predict_lock.lock();
+
+    std::vector<LKTrackJob> jobs(2);
+    jobs[0].img_size = up_img.size();
+    jobs[0].cur_pyr = up_pyr;
+    jobs[0].prev_pyr = up_pyrs.previous();
+    jobs[0].prev_pts = &prev_up_top_pts;
+    jobs[0].ids = &ids_up_top;
+    jobs[0].track_cnt = &track_up_top_cnt;
+    jobs[0].prediction = &predict_up_top;
+
+    jobs[1].img_size = down_img.size();
+    jobs[1].cur_pyr = down_pyr;
+    jobs[1].prev_pyr = down_pyrs.previous();
+    jobs[1].prev_pts = &prev_down_top_pts;
+    jobs[1].ids = &ids_down_top;
+    jobs[1].track_cnt = &track_down_top_cnt;
+    jobs[1].prediction = &predict_down_top;
+
+    opticalflow_track_batch(jobs, removed_pts);
+    cur_up_top_pts = std::move(jobs[0].cur_pts);
+    cur_down_top_pts = std::move(jobs[1].cur_pts);
+
+    set_predict_lock.unlock();
+
+    reduceByFov(fov_masks[0], cur_up_top_pts, ids_up_top, track_up_top_cnt);
+    reduceByFov(fov_masks[1], cur_down_top_pts, ids_down_top, track_down_top_cnt);
+    PERF_RECORD(PERF_LK, t_t.toc());
+
+    //One raw image carries the points of the top and side views
+    TicToc t_d;
+    int require_pts = scaled_pts_cnt(TOP_PTS_CNT + SIDE_PTS_CNT);
+    #pragma omp parallel sections
+    {
+        #pragma omp section
+        {
+            if (USE_ORB) {
+                detectPoints(up_img, fov_masks[0], n_pts_up_top, cur_up_top_pts, require_pts);
+            } else {
+                vector<int> _ids, _cnt;
+                detectPointsGrid(*up_pyr, n_pts_up_top, cur_up_top_pts, require_pts);
+                reduceByFov(fov_masks[0], n_pts_up_top, _ids, _cnt);
+            }
+        }
+
+        #pragma omp section
+        {
+            if (USE_ORB) {
+                detectPoints(down_img, fov_masks[1], n_pts_down_top, cur_down_top_pts, require_pts);
+            } else {
+                vector<int> _ids, _cnt;
+                detectPointsGrid(*down_pyr, n_pts_down_top, cur_down_top_pts, require_pts);
+                reduceByFov(fov_masks[1], n_pts_down_top, _ids, _cnt);
+            }
+        }
+    }
+    n_pts_up_side.clear();
+    PERF_RECORD(PERF_DETECT, t_d.toc());
+
+    addPointsFisheye();
+
+    TicToc t_un;
+    cur_up_top_un_pts = liftPtsRaw(cur_up_top_pts, m_camera[0]);
+    cur_down_top_un_pts = liftPtsRaw(cur_down_top_pts, m_camera[1]);
+
+    up_top_vel = ptsVelocity3D(ids_up_top, cur_up_top_un_pts, prev_ids_up_top, prev_up_top_un_pts);
+    down_top_vel = ptsVelocity3D(ids_down_top, cur_down_top_un_pts, prev_ids_down_top, prev_down_top_un_pts);
+    PERF_RECORD(PERF_UNDISTORT, t_un.toc());
+
+    if (SHOW_TRACK) {
+        drawTrackRaw(up_img, down_img);
+    }
+
+    up_pyrs.swap();
+    down_pyrs.swap();
+
+    prev_up_top_pts = cur_up_top_pts;
+    prev_down_top_pts = cur_down_top_pts;
+    prev_up_top_un_pts = cur_up_top_un_pts;
+    prev_down_top_un_pts = cur_down_top_un_pts;
+
+    swapFramePts();
+    prev_time = cur_time;
+
+    return setup_feature_frame();
+}
+
+cv::Mat FisheyeFeatureTrackerDirect::fovMask(const camodocal::CameraPtr & cam, cv::Size size) const {
+#ifdef UNIT_SPHERE_ERROR
+    double min_z = cos(FISHEYE_FOV / 2 * M_PI / 180);
+#else
+    //Normalized plane only covers the front hemisphere
+    double min_z = std::max(cos(FISHEYE_FOV / 2 * M_PI / 180), 0.1);
+#endif
+    cv::Mat mask(size, CV_8UC1, cv::Scalar(0));
+    #pragma omp parallel for
+    for (int v = 0; v < size.height; v ++) {
+        uchar * row = mask.ptr<uchar>(v);
+        for (int u = 0; u < size.width; u ++) {
+            Eigen::Vector3d b;
+            cam->liftSphere(Eigen::Vector2d(u, v), b);
+            if (!b.hasNaN() && b.z() > min_z) {
+                row[u] = 255;
+            }
+        }
+    }
+    return mask;
+}
+
+void FisheyeFeatureTrackerDirect::reduceByFov(const cv::Mat & fov_mask, vector<cv::Point2f> & pts, vector<int> & ids, vector<int> & track_cnt) {
+    vector<uchar> status(pts.size(), 0);
+    for (size_t i = 0; i < pts.size(); i ++) {
+        cv::Point pt(cvRound(pts[i].x), cvRound(pts[i].y));
+        status[i] = pt.inside(cv::Rect(0, 0, fov_mask.cols, fov_mask.rows)) && fov_mask.at<uchar>(pt) > 0;
+    }
+    reduceVector(pts, status);
+    if (ids.size() == status.size()) {
+        reduceVector(ids, status);
+        reduceVector(track_cnt, status);
+    }
+}
+
+vector<cv::Point3f> FisheyeFeatureTrackerDirect::liftPtsRaw(const vector<cv::Point2f> & pts, const camodocal::CameraPtr & cam) {
+    vector<cv::Point3f> un_pts;
+    un_pts.reserve(pts.size());
+    for (auto & pt : pts) {
+        Eigen::Vector3d b;
+        cam->liftSphere(Eigen::Vector2d(pt.x, pt.y), b);
+#ifdef UNIT_SPHERE_ERROR
+        un_pts.push_back(cv::Point3f(b.x(), b.y(), b.z()));
+#else
+        un_pts.push_back(cv::Point3f(b.x() / b.z(), b.y() / b.z(), 1));
+#endif
+    }
+    return un_pts;
+}
+
+void FisheyeFeatureTrackerDirect::addRawPrediction(int cam_id, int _id, const Eigen::Vector3d & pt, FeatureIdTable<cv::Point2f> & predict) {
+    Eigen::Vector2d uv;
+    m_camera[cam_id]->spaceToPlane(pt, uv);
+    if (!uv.hasNaN()) {
+        predict.set(_id, cv::Point2f(uv.x(), uv.y()));
+    }
+}
+
+void FisheyeFeatureTrackerDirect::setPrediction(const map<int, Eigen::Vector3d> &predictPts_cam0, const map<int, Eigen::Vector3d> &predictPts_cam1) {
+    set_predict_lock.lock();
+    predict_up_top.clear();
+    predict_down_top.clear();
+
+    for (auto it : predictPts_cam0) {
+        addRawPrediction(0, it.first, it.second, predict_up_top);
+    }
+
+    for (auto it : predictPts_cam1) {
+        addRawPrediction(1, it.first, it.second, predict_down_top);
+    }
+    set_predict_lock.unlock();
+}
+
+void FisheyeFeatureTrackerDirect::setRotationPrediction(const Eigen::Matrix3d & R_c0, const Eigen::Matrix3d & R_c1) {
+    set_predict_lock.lock();
+    predict_up_top.clear();
+    predict_down_top.clear();
+
+    Eigen::Matrix3d R_inv[2] = {R_c0.transpose(), R_c1.transpose()};
+    vector<cv::Point3f> * un_pts[2] = {&prev_up_top_un_pts, &prev_down_top_un_pts};
+    vector<int> * ids[2] = {&ids_up_top, &ids_down_top};
+    FeatureIdTable<cv::Point2f> * predict[2] = {&predict_up_top, &predict_down_top};
+    for (int c = 0; c < 2; c ++) {
+        if (ids[c]->size() != un_pts[c]->size()) {
+            continue;
+        }
+        for (size_t i = 0; i < ids[c]->size(); i ++) {
+            auto & p = (*un_pts[c])[i];
+            addRawPrediction(c, (*ids[c])[i], R_inv[c] * Eigen::Vector3d(p.x, p.y, p.z), *predict[c]);
+        }
+    }
+    set_predict_lock.unlock();
+}
+
+void FisheyeFeatureTrackerDirect::drawTrackRaw(const cv::Mat & img_up, const cv::Mat & img_down) {
+    cv::Mat im_up, im_down, imTrack;
+    if (img_up.channels() != 3) {
+        cv::cvtColor(img_up, im_up, cv::COLOR_GRAY2BGR);
+        cv::cvtColor(img_down, im_down, cv::COLOR_GRAY2BGR);
+    } else {
+        im_up = img_up.clone();
+        im_down = img_down.clone();
+    }
+
+    drawTrackImage(im_up, cur_up_top_pts, ids_up_top, up_top_prevLeftPtsMap);
+    drawTrackImage(im_down, cur_down_top_pts, ids_down_top, down_top_prevLeftPtsMap);
+    cv::hconcat(im_up, im_down, imTrack);
+
+    double fx = ((double)SHOW_WIDTH) / ((double) imTrack.size().width);
+    cv::resize(imTrack, imTrack, cv::Size(), fx, fx);
+    cv::imshow("tracking", imTrack);
+    cv::waitKey(2);
+}
+
+};
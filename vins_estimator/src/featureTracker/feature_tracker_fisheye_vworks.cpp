@@ -251,7 +251,6 @@ FeatureFrame  FisheyeFeatureTrackerVWorks::trackImage(double _cur_time, cv::Inpu
     cur_up_side_un_pts.clear();
     cur_down_top_un_pts.clear();
     cur_down_side_un_pts.clear();
-    TicToc tic;
     //TODO: simpified this to make no copy
     if (enable_up_top) {
         up_top_img.copyTo(up_top_img_fix);
@@ -269,7 +268,6 @@ FeatureFrame  FisheyeFeatureTrackerVWorks::trackImage(double _cur_time, cv::Inpu
         down_side_img.copyTo(down_side_img_fix);
     }
 
-    ROS_INFO("Copy Image cost %fms", tic.toc());
     if(first_frame) {
         setMaskFisheye();
         if (enable_up_top) {
@@ -283,7 +281,6 @@ FeatureFrame  FisheyeFeatureTrackerVWorks::trackImage(double _cur_time, cv::Inpu
         if(enable_up_side) {
             mask_up_side_fix.upload(mask_up_side);
         }
-        ROS_INFO("setFisheyeMask Image cost %fms", tic.toc());
 
         init_vworks_tracker(up_top_img_fix, down_top_img_fix, up_side_img_fix, down_side_img_fix);
         first_frame = false;
@@ -301,7 +298,6 @@ FeatureFrame  FisheyeFeatureTrackerVWorks::trackImage(double _cur_time, cv::Inpu
         }
     }
     
-    ROS_INFO("Track only cost %fms", tic.toc());
 
     if (enable_up_top) {
         process_vworks_tracking(tracker_up_top,  ids_up_top, prev_up_top_pts, cur_up_top_pts, 
@@ -318,7 +314,6 @@ FeatureFrame  FisheyeFeatureTrackerVWorks::trackImage(double _cur_time, cv::Inpu
             track_up_side_cnt, n_pts_up_side, up_side_id_by_index);
     }
     
-    ROS_INFO("Visionworks cost %fms", tic.toc());
 
     if (enable_down_side) {
         ids_down_side = ids_up_side;
@@ -336,11 +331,11 @@ FeatureFrame  FisheyeFeatureTrackerVWorks::trackImage(double _cur_time, cv::Inpu
     cur_down_side_un_pts = undistortedPtsSide(cur_down_side_pts, fisheys_undists[1], true);
 
     //Calculate Velocitys
-    up_top_vel = ptsVelocity3D(ids_up_top, cur_up_top_un_pts, cur_up_top_un_pts_map, prev_up_top_un_pts_map);
-    down_top_vel = ptsVelocity3D(ids_down_top, cur_down_top_un_pts, cur_down_top_un_pts_map, prev_down_top_un_pts_map);
+    up_top_vel = ptsVelocity3D(ids_up_top, cur_up_top_un_pts, prev_ids_up_top, prev_up_top_un_pts);
+    down_top_vel = ptsVelocity3D(ids_down_top, cur_down_top_un_pts, prev_ids_down_top, prev_down_top_un_pts);
 
-    up_side_vel = ptsVelocity3D(ids_up_side, cur_up_side_un_pts, cur_up_side_un_pts_map, prev_up_side_un_pts_map);
-    down_side_vel = ptsVelocity3D(ids_down_side, cur_down_side_un_pts, cur_down_side_un_pts_map, prev_down_side_un_pts_map);
+    up_side_vel = ptsVelocity3D(ids_up_side, cur_up_side_un_pts, prev_ids_up_side, prev_up_side_un_pts);
+    down_side_vel = ptsVelocity3D(ids_down_side, cur_down_side_un_pts, prev_ids_down_side, prev_down_side_un_pts);
 
     // ROS_INFO("Up top VEL %ld", up_top_vel.size());
     double tcost_all = t_r.toc();
@@ -362,17 +357,9 @@ FeatureFrame  FisheyeFeatureTrackerVWorks::trackImage(double _cur_time, cv::Inpu
     prev_up_side_un_pts = cur_up_side_un_pts;
     prev_down_side_un_pts = cur_down_side_un_pts;
 
-    prev_up_top_un_pts_map = cur_up_top_un_pts_map;
-    prev_down_top_un_pts_map = cur_down_top_un_pts_map;
-    prev_up_side_un_pts_map = cur_up_side_un_pts_map;
-    prev_down_side_un_pts_map = cur_up_side_un_pts_map;
+    swapFramePts();
     prev_time = cur_time;
 
-    up_top_prevLeftPtsMap = pts_map(ids_up_top, cur_up_top_pts);
-    down_top_prevLeftPtsMap = pts_map(ids_down_top, cur_down_top_pts);
-    up_side_prevLeftPtsMap = pts_map(ids_up_side, cur_up_side_pts);
-    down_side_prevLeftPtsMap = pts_map(ids_down_side, cur_down_side_pts);
-
     // hasPrediction = false;
     auto ff = setup_feature_frame();
 
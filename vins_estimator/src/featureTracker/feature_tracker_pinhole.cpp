@@ -24,7 +24,7 @@ void PinholeFeatureTracker<CvMat>::setMask()
 
     for (auto &it : cnt_pts_id)
     {
-        if (removed_pts.find(it.second.second) == removed_pts.end()) {
+        if (!removed_pts.contains(it.second.second)) {
             if (mask.at<uchar>(it.second.first) == 255)
             {
                 cur_pts.push_back(it.second.first);
@@ -115,7 +115,7 @@ std::vector<cv::Point3f> PinholeFeatureTracker<CvMat>::ptsVelocity(vector<int> &
     }
     else
     {
-        for (unsigned int i = 0; i < cur_pts.size(); i++)
+        for (unsigned int i = 0; i < pts.size(); i++)
         {
             pts_velocity.push_back(cv::Point3f(0, 0, 0));
         }
@@ -195,4 +195,170 @@ void PinholeFeatureTracker<CvMat>::setPrediction(const map<int, Eigen::Vector3d>
             predict_pts.push_back(prev_pts[i]);
     }
 }
+
+FeatureFrame PinholeFeatureTrackerOpenMP::trackImage(double _cur_time, cv::InputArray _img, 
+        cv::InputArray _img1)
+{
+    cur_time = _cur_time;
+    cv::Mat left_img = _img.getMat();
+    cv::Mat right_img = _img1.getMat();
+    bool stereo = !right_img.empty() && stereo_cam;
+
+    height = left_img.rows;
+    width = left_img.cols;
+
+    vector<cv::Mat> * left_pyr = nullptr, * right_pyr = nullptr;
+
+    TicToc t_pyr;
+    #pragma omp parallel sections
+    {
+        #pragma omp section
+        {
+            left_pyr = left_pyrs.build(left_img);
+        }
+
+        #pragma omp section
+        {
+            if (stereo) {
+                right_pyr = right_pyrs.build(right_img);
+            }
+        }
+    }
+    PERF_RECORD(PERF_PYRAMID, t_pyr.toc());
+
+    TicToc t_ft;
+    set_predict_lock.lock();
+    vector<LKTrackJob> jobs(1);
+    jobs[0].img_size = left_img.size();
+    jobs[0].cur_pyr = left_pyr;
+    jobs[0].prev_pyr = left_pyrs.previous();
+    jobs[0].prev_pts = &prev_pts;
+    jobs[0].ids = &ids;
+    jobs[0].track_cnt = &track_cnt;
+    jobs[0].prediction = &predict_left;
+    opticalflow_track_batch(jobs, removed_pts);
+    cur_pts = std::move(jobs[0].cur_pts);
+    set_predict_lock.unlock();
+    PERF_RECORD(PERF_LK, t_ft.toc());
+
+    //Keep long tracked points first and mask their neighbourhood for detection
+    setMask();
+
+    //Tracked points go to the right image while new points are detected on the left
+    vector<int> ids_tracked_right = ids;
+    vector<cv::Point2f> right_tracked_pts;
+    #pragma omp parallel sections
+    {
+        #pragma omp section
+        {
+            PERF_SCOPE(PERF_DETECT);
+            if (USE_ORB) {
+                detectPoints(left_img, mask, n_pts, cur_pts, scaled_pts_cnt(MAX_CNT));
+            } else {
+                detectPointsGrid(*left_pyr, n_pts, cur_pts, scaled_pts_cnt(MAX_CNT));
+            }
+        }
+
+        #pragma omp section
+        {
+            if (stereo) {
+                PERF_SCOPE(PERF_LK);
+                vector<cv::Point2f> right_init_pts = cur_pts;
+                right_tracked_pts = stereoTrack(left_pyr, right_pyr, right_img.size(), right_init_pts, ids_tracked_right);
+            }
+        }
+    }
+
+    addPoints();
+
+    ids_right.clear();
+    cur_right_pts.clear();
+    if (stereo) {
+        //Only the new points are left for the right image
+        TicToc t_s;
+        vector<int> ids_new_right(ids.end() - n_pts.size(), ids.end());
+        vector<cv::Point2f> right_init_pts = n_pts;
+        auto right_new_pts = stereoTrack(left_pyr, right_pyr, right_img.size(), right_init_pts, ids_new_right);
+
+        //Tracked ids keep the setMask() order, not increasing: setup_feature_frame sorts them
+        ids_right = std::move(ids_tracked_right);
+        ids_right.insert(ids_right.end(), ids_new_right.begin(), ids_new_right.end());
+        cur_right_pts = std::move(right_tracked_pts);
+        cur_right_pts.insert(cur_right_pts.end(), right_new_pts.begin(), right_new_pts.end());
+        PERF_RECORD(PERF_LK, t_s.toc());
+    }
+
+    TicToc t_un;
+    #pragma omp parallel sections
+    {
+        #pragma omp section
+        {
+            cur_un_pts = undistortedPts(cur_pts, m_camera[0]);
+            pts_velocity = ptsVelocity(ids, cur_un_pts, cur_un_pts_map, prev_un_pts_map);
+        }
+
+        #pragma omp section
+        {
+            if (stereo) {
+                cur_un_right_pts = undistortedPts(cur_right_pts, m_camera[1]);
+                right_pts_velocity = ptsVelocity(ids_right, cur_un_right_pts, cur_un_right_pts_map, prev_un_right_pts_map);
+            } else {
+                cur_un_right_pts.clear();
+                right_pts_velocity.clear();
+            }
+        }
+    }
+    PERF_RECORD(PERF_UNDISTORT, t_un.toc());
+
+    if(SHOW_TRACK)
+    {
+        drawTrack(left_img, right_img, ids, cur_pts, cur_right_pts, prevLeftPtsMap);
+        prevLeftPtsMap = pts_map(ids, cur_pts);
+    }
+
+    left_pyrs.swap();
+    prev_pts = cur_pts;
+    prev_un_pts = cur_un_pts;
+    prev_un_pts_map = cur_un_pts_map;
+    prev_un_right_pts_map = cur_un_right_pts_map;
+    prev_time = cur_time;
+
+    FeatureFrame featureFrame;
+    BaseFeatureTracker::setup_feature_frame(featureFrame, {
+        {&ids, &cur_pts, &cur_un_pts, &pts_velocity, 0},
+        {&ids_right, &cur_right_pts, &cur_un_right_pts, &right_pts_velocity, 1}
+    });
+
+    return featureFrame;
+}
+
+//Left to right LK as one batch job; inside an omp section it runs on that section's thread
+vector<cv::Point2f> PinholeFeatureTrackerOpenMP::stereoTrack(vector<cv::Mat> * left_pyr, vector<cv::Mat> * right_pyr, cv::Size size,
+        vector<cv::Point2f> & pts, vector<int> & _ids)
+{
+    vector<int> _track_cnt;
+    vector<LKTrackJob> jobs(1);
+    jobs[0].img_size = size;
+    jobs[0].cur_pyr = right_pyr;
+    jobs[0].prev_pyr = left_pyr;
+    jobs[0].prev_pts = &pts;
+    jobs[0].ids = &_ids;
+    jobs[0].track_cnt = &_track_cnt;
+    opticalflow_track_batch(jobs, removed_pts);
+    return std::move(jobs[0].cur_pts);
+}
+
+void PinholeFeatureTrackerOpenMP::setPrediction(const map<int, Eigen::Vector3d> &predictPts_cam0, const map<int, Eigen::Vector3d> &predictPt_cam1)
+{
+    set_predict_lock.lock();
+    predict_left.clear();
+    for (auto & it : predictPts_cam0)
+    {
+        Eigen::Vector2d tmp_uv;
+        m_camera[0]->spaceToPlane(it.second, tmp_uv);
+        predict_left.set(it.first, cv::Point2f(tmp_uv.x(), tmp_uv.y()));
+    }
+    set_predict_lock.unlock();
+}
+
 }
@@ -63,11 +63,24 @@ public:
         cv::InputArray _img1 = cv::noArray()) override;
 };
 
-// class PinholeFeatureTrackerCPU: public PinholeFeatureTracker<cv::Mat> {
-// public:
-//     virtual FeatureFrame trackImage(double _cur_time, cv::InputArray _img, 
-//         cv::InputArray _img1 = cv::noArray()) override;
-// };
+//Left and right pyramids are built together, LK runs as chunked batches on all threads
+//and stereo tracking of the tracked points overlaps with detection of new points
+class PinholeFeatureTrackerOpenMP: public PinholeFeatureTracker<cv::Mat> {
+public:
+    PinholeFeatureTrackerOpenMP(Estimator * _estimator): 
+            PinholeFeatureTracker<cv::Mat>(_estimator) {}
+    virtual FeatureFrame trackImage(double _cur_time, cv::InputArray _img, 
+        cv::InputArray _img1 = cv::noArray()) override;
+    virtual void setPrediction(const map<int, Eigen::Vector3d> &predictPts_cam0, const map<int, Eigen::Vector3d> &predictPt_cam1 =  map<int, Eigen::Vector3d>()) override;
+
+protected:
+    vector<cv::Point2f> stereoTrack(vector<cv::Mat> * left_pyr, vector<cv::Mat> * right_pyr, cv::Size size,
+        vector<cv::Point2f> & pts, vector<int> & _ids);
+
+    PyramidPool left_pyrs, right_pyrs;
+    FeatureIdTable<cv::Point2f> predict_left;
+    std::mutex set_predict_lock;
+};
 
 template<class CvMat>
 bool PinholeFeatureTracker<CvMat>::inBorder(const cv::Point2f &pt) const
@@ -81,12 +94,6 @@ bool PinholeFeatureTracker<CvMat>::inBorder(const cv::Point2f &pt) const
 FeatureFrame PinholeFeatureTrackerCuda::trackImage(double _cur_time, cv::InputArray _img, 
         cv::InputArray _img1)
 {
-    static double detected_time_sum = 0;
-    static double ft_time_sum = 0;
-    static int count = 0;
-    count += 1;
-
-    TicToc t_r;
     cur_time = _cur_time;
     cv::Mat rightImg;
     cv::cuda::GpuMat cur_gpu_img = cv::cuda::GpuMat(_img);
@@ -98,26 +105,30 @@ FeatureFrame PinholeFeatureTrackerCuda::trackImage(double _cur_time, cv::InputAr
     cur_pts.clear();
     TicToc t_ft;
     cur_pts = opticalflow_track(cur_gpu_img, prev_pyr, prev_pts, ids, track_cnt, removed_pts, false);
-    ft_time_sum += t_ft.toc();
+    PERF_RECORD(PERF_LK, t_ft.toc());
 
     TicToc t_d;
-    detectPoints(cur_gpu_img, n_pts, cur_pts, MAX_CNT);
-    detected_time_sum = detected_time_sum + t_d.toc();
+    detectPoints(cur_gpu_img, n_pts, cur_pts, scaled_pts_cnt(MAX_CNT));
+    PERF_RECORD(PERF_DETECT, t_d.toc());
 
     addPoints();
 
+    TicToc t_un;
     cur_un_pts = undistortedPts(cur_pts, m_camera[0]);
     pts_velocity = ptsVelocity(ids, cur_un_pts, cur_un_pts_map, prev_un_pts_map);
+    PERF_RECORD(PERF_UNDISTORT, t_un.toc());
 
     if(!_img1.empty() && stereo_cam)
     {
-        t_ft.tic();
+        TicToc t_right;
         ids_right = ids;
         std::vector<cv::Point2f> right_side_init_pts = cur_pts;
         cur_right_pts = opticalflow_track(right_gpu_img, prev_pyr, right_side_init_pts, ids_right, track_right_cnt, removed_pts, true);
+        PERF_RECORD(PERF_LK, t_right.toc());
+        TicToc t_un_right;
         cur_un_right_pts = undistortedPts(cur_right_pts, m_camera[1]);
         right_pts_velocity = ptsVelocity(ids_right, cur_un_right_pts, cur_un_right_pts_map, prev_un_right_pts_map);
-        ft_time_sum += t_ft.toc();
+        PERF_RECORD(PERF_UNDISTORT, t_un_right.toc());
     }
 
     if(SHOW_TRACK)
@@ -141,16 +152,11 @@ FeatureFrame PinholeFeatureTrackerCuda::trackImage(double _cur_time, cv::InputAr
         prevLeftPtsMap[ids[i]] = cur_pts[i];
 
     FeatureFrame featureFrame;
-    BaseFeatureTracker::setup_feature_frame(featureFrame, ids, cur_pts, cur_un_pts, pts_velocity, 0);   
-    BaseFeatureTracker::setup_feature_frame(featureFrame, ids_right, cur_right_pts, cur_un_right_pts, right_pts_velocity, 1);   
-
-    printf("Img: %d: trackImage: %3.1fms; PT NUM: %ld, STEREO: %ld; Avg: GFTT %3.1fms LKFlow %3.1fms\n", 
-        count,
-        t_r.toc(), 
-        cur_pts.size(),
-        cur_right_pts.size(),
-        detected_time_sum/count, 
-        ft_time_sum/count);
+    BaseFeatureTracker::setup_feature_frame(featureFrame, {
+        {&ids, &cur_pts, &cur_un_pts, &pts_velocity, 0},
+        {&ids_right, &cur_right_pts, &cur_un_right_pts, &right_pts_velocity, 1}
+    });
+
     return featureFrame;
 }
 
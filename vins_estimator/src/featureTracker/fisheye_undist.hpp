@@ -10,6 +10,7 @@
 #include "cv_bridge/cv_bridge.h"
 #include "../utility/opencv_cuda.h"
 #include "../utility/tic_toc.h"
+#include "../utility/perf.h"
 
 #define DEG_TO_RAD (M_PI / 180.0)
 #define REMAP_FUNC cv::INTER_LINEAR
@@ -80,7 +81,7 @@ public:
     cv::cuda::GpuMat img_cuda;
     std::vector<cv::Mat> undist_all_cuda_cpu(const cv::Mat & image, bool use_rgb = false, std::vector<bool> mask = std::vector<bool>(0)) {
 #ifndef WITHOUT_CUDA
-        TicToc up;
+        PERF_SCOPE(PERF_FLATTEN);
         bool has_mask = mask.size() == undistMaps.size();
         if (use_rgb) {
             img_cuda.upload(image);
@@ -90,20 +91,13 @@ public:
             img_cuda.upload(_tmp);
         }
 
-        std::cout << "Upload cost " << up.toc() << std::endl;
-
-
         std::vector<cv::Mat> ret;
         for (unsigned int i = 0; i < undistMaps.size(); i++) {
             cv::Mat tmp;
             if (!has_mask || (has_mask && mask[i]) ) {
                 cv::cuda::GpuMat output;
-                TicToc remap;
                 cv::cuda::remap(img_cuda, output, undistMapsGPUX[i], undistMapsGPUY[i], REMAP_FUNC);
-                std::cout << "Remap cost " << remap.toc() << std::endl;
-                TicToc down;
                 output.download(tmp);
-                std::cout << "Download cost " << down.toc() << std::endl;
             }
             ret.push_back(tmp);
         }
@@ -208,6 +202,23 @@ public:
         }
     }
 
+    //Flatten only the selected views of two gray images, others are left empty
+    void stereo_flatten_views(const cv::Mat & gray1, const cv::Mat & gray2, FisheyeUndist * undist2,
+        std::vector<cv::Mat> & lefts, std::vector<cv::Mat> & rights, const std::vector<bool> & views) {
+        lefts.resize(5);
+        rights.resize(5);
+#pragma omp parallel for num_threads(10)
+        for (unsigned int i = 0; i < 10; i++) {
+            if (views.size() == 5 && views[i%5]) {
+                if (i > 4) {
+                    cv::remap(gray2, rights[i%5], undist2->undistMaps[i%5].first, undist2->undistMaps[i%5].second, REMAP_FUNC);
+                } else {
+                    cv::remap(gray1, lefts[i], undistMaps[i%5].first, undistMaps[i%5].second, REMAP_FUNC);
+                }
+            }
+        }
+    }
+
 
     std::vector<std::pair<cv::Mat, cv::Mat>> generateAllUndistMap(camodocal::CameraPtr p_cam,
                                           Eigen::Vector3d rotation,
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <cfloat>
+#include <opencv2/core/core.hpp>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace FeatureTracker {
+
+//Pyramidal Lucas-Kanade with the window size and pyramid depth fixed at compile time.
+//Follows cv::calcOpticalFlowPyrLK step by step (fixed point bilinear weights, min eigen value
+//test, oscillation check), so results match OpenCV up to float rounding.
+//Works on pyramids built by cv::buildOpticalFlowPyramid with derivatives: Scharr gradients are
+//computed once per level when the pyramid is built and shared by every pass that starts from it.
+template<int WIN, int LEVELS>
+class FixedWindowLK {
+public:
+    static const int HALF_WIN = (WIN - 1) / 2;
+    //Fixed point bits of the bilinear weights
+    static const int W_BITS = 14;
+    static constexpr float MIN_EIG_THRESHOLD = 1e-4f;
+
+    //Return false if the pyramids are not in the expected layout, nothing is written then
+    static bool calc(const std::vector<cv::Mat> & prev_pyr, const std::vector<cv::Mat> & cur_pyr,
+            const std::vector<cv::Point2f> & prev_pts, std::vector<cv::Point2f> & next_pts, std::vector<unsigned char> & status,
+            int max_count = 30, float eps = 0.01, bool use_initial_flow = true) {
+        //Image and derivative interleaved, derivatives only required on prev
+        if (prev_pyr.size() < 2 || prev_pyr.size() % 2 != 0 || prev_pyr[1].type() != CV_16SC2 ||
+                prev_pyr[0].type() != CV_8UC1 || cur_pyr.empty() || cur_pyr[0].type() != CV_8UC1) {
+            return false;
+        }
+        int cur_step = cur_pyr.size() % 2 == 0 && cur_pyr.size() > 1 && cur_pyr[1].type() == CV_16SC2 ? 2 : 1;
+        int max_level = std::min<int>({LEVELS, (int)prev_pyr.size() / 2 - 1, (int)cur_pyr.size() / cur_step - 1});
+
+        if (!use_initial_flow || next_pts.size() != prev_pts.size()) {
+            next_pts = prev_pts;
+        }
+        status.assign(prev_pts.size(), 1);
+
+        for (int level = max_level; level >= 0; level --) {
+            const cv::Mat & I = prev_pyr[level*2];
+            const cv::Mat & dI = prev_pyr[level*2 + 1];
+            const cv::Mat & J = cur_pyr[level*cur_step];
+            float scale = 1.f / (1 << level);
+
+            for (size_t i = 0; i < prev_pts.size(); i ++) {
+                cv::Point2f prev_pt = prev_pts[i] * scale;
+                cv::Point2f next_pt = level == max_level ? next_pts[i] * scale : next_pts[i] * 2.f;
+                bool ok = trackPoint(I.ptr<unsigned char>(), (int) I.step, dI.ptr<short>(), (int) (dI.step / sizeof(short)),
+                    I.cols, I.rows, J.ptr<unsigned char>(), (int) J.step, J.cols, J.rows, prev_pt, next_pt, max_count, eps*eps);
+                next_pts[i] = next_pt;
+                if (level == 0 && !ok) {
+                    status[i] = 0;
+                }
+            }
+        }
+        return true;
+    }
+
+    //Track one point on one level. Pointers are the level ROI, which must be padded by WIN on every side.
+    //next_pt is the initial guess and the result; return false if the point is lost on this level
+    static bool trackPoint(const unsigned char * I, int stepI, const short * dI, int stepD, int cols, int rows,
+            const unsigned char * J, int stepJ, int colsJ, int rowsJ,
+            cv::Point2f prev_pt, cv::Point2f & next_pt, int max_count, float eps2) {
+        const float FLT_SCALE = 1.f/(1 << 20);
+
+        //Window patch and gradients, stored planar so the inner loops vectorize
+        short Iwin[WIN*WIN];
+        short Ixwin[WIN*WIN];
+        short Iywin[WIN*WIN];
+
+        prev_pt.x -= HALF_WIN;
+        prev_pt.y -= HALF_WIN;
+        int ix = cvFloor(prev_pt.x);
+        int iy = cvFloor(prev_pt.y);
+        if (ix < -WIN || ix >= cols || iy < -WIN || iy >= rows) {
+            return false;
+        }
+
+        float a = prev_pt.x - ix;
+        float b = prev_pt.y - iy;
+        int iw00 = cvRound((1.f - a)*(1.f - b)*(1 << W_BITS));
+        int iw01 = cvRound(a*(1.f - b)*(1 << W_BITS));
+        int iw10 = cvRound((1.f - a)*b*(1 << W_BITS));
+        int iw11 = (1 << W_BITS) - iw00 - iw01 - iw10;
+
+        //Products fit in int, sums are accumulated in float as OpenCV does
+        float iA11 = 0, iA12 = 0, iA22 = 0;
+        for (int y = 0; y < WIN; y ++) {
+            const unsigned char * src = I + (y + iy)*stepI + ix;
+            const short * dsrc = dI + (y + iy)*stepD + ix*2;
+            short * Iptr = Iwin + y*WIN;
+            short * Ixptr = Ixwin + y*WIN;
+            short * Iyptr = Iywin + y*WIN;
+            #pragma omp simd reduction(+:iA11,iA12,iA22)
+            for (int x = 0; x < WIN; x ++) {
+                int ival = descale(src[x]*iw00 + src[x+1]*iw01 + src[x+stepI]*iw10 + src[x+stepI+1]*iw11, W_BITS - 5);
+                int ixval = descale(dsrc[x*2]*iw00 + dsrc[x*2+2]*iw01 + dsrc[x*2+stepD]*iw10 + dsrc[x*2+stepD+2]*iw11, W_BITS);
+                int iyval = descale(dsrc[x*2+1]*iw00 + dsrc[x*2+3]*iw01 + dsrc[x*2+stepD+1]*iw10 + dsrc[x*2+stepD+3]*iw11, W_BITS);
+                Iptr[x] = (short) ival;
+                Ixptr[x] = (short) ixval;
+                Iyptr[x] = (short) iyval;
+                iA11 += (float)(ixval*ixval);
+                iA12 += (float)(ixval*iyval);
+                iA22 += (float)(iyval*iyval);
+            }
+        }
+
+        float A11 = iA11*FLT_SCALE, A12 = iA12*FLT_SCALE, A22 = iA22*FLT_SCALE;
+        float D = A11*A22 - A12*A12;
+        float min_eig = (A22 + A11 - std::sqrt((A11-A22)*(A11-A22) + 4.f*A12*A12))/(2*WIN*WIN);
+        if (min_eig < MIN_EIG_THRESHOLD || D < FLT_EPSILON) {
+            return false;
+        }
+        D = 1.f/D;
+
+        next_pt.x -= HALF_WIN;
+        next_pt.y -= HALF_WIN;
+        cv::Point2f prev_delta;
+        for (int j = 0; j < max_count; j ++) {
+            int jx = cvFloor(next_pt.x);
+            int jy = cvFloor(next_pt.y);
+            if (jx < -WIN || jx >= colsJ || jy < -WIN || jy >= rowsJ) {
+                next_pt.x += HALF_WIN;
+                next_pt.y += HALF_WIN;
+                return false;
+            }
+
+            a = next_pt.x - jx;
+            b = next_pt.y - jy;
+            iw00 = cvRound((1.f - a)*(1.f - b)*(1 << W_BITS));
+            iw01 = cvRound(a*(1.f - b)*(1 << W_BITS));
+            iw10 = cvRound((1.f - a)*b*(1 << W_BITS));
+            iw11 = (1 << W_BITS) - iw00 - iw01 - iw10;
+
+            float ib1 = 0, ib2 = 0;
+            for (int y = 0; y < WIN; y ++) {
+                rowMismatch(J + (y + jy)*stepJ + jx, stepJ, Iwin + y*WIN, Ixwin + y*WIN, Iywin + y*WIN,
+                    iw00, iw01, iw10, iw11, ib1, ib2);
+            }
+
+            float b1 = ib1*FLT_SCALE, b2 = ib2*FLT_SCALE;
+            cv::Point2f delta((A12*b2 - A22*b1) * D, (A12*b1 - A11*b2) * D);
+            next_pt += delta;
+            if (delta.dot(delta) <= eps2) {
+                break;
+            }
+            if (j > 0 && std::abs(delta.x + prev_delta.x) < 0.01 && std::abs(delta.y + prev_delta.y) < 0.01) {
+                next_pt -= delta*0.5f;
+                break;
+            }
+            prev_delta = delta;
+        }
+
+        next_pt.x += HALF_WIN;
+        next_pt.y += HALF_WIN;
+        return true;
+    }
+
+    //Adds the window row's image mismatch times gradient to ib1, ib2
+    static inline void rowMismatch(const unsigned char * Jptr, int stepJ, const short * Iptr, const short * Ixptr, const short * Iyptr,
+            int iw00, int iw01, int iw10, int iw11, float & ib1, float & ib2) {
+        int x0 = 0;
+#ifdef __AVX2__
+        //8 pixels per step in 32 bit lanes, products summed in float as in the scalar loop
+        const __m256i w00 = _mm256_set1_epi32(iw00), w01 = _mm256_set1_epi32(iw01);
+        const __m256i w10 = _mm256_set1_epi32(iw10), w11 = _mm256_set1_epi32(iw11);
+        const __m256i half = _mm256_set1_epi32(1 << (W_BITS - 6));
+        __m256 sum1 = _mm256_setzero_ps(), sum2 = _mm256_setzero_ps();
+        for (; x0 + 8 <= WIN; x0 += 8) {
+            const int x = x0;
+            __m256i j00 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (Jptr + x)));
+            __m256i j01 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (Jptr + x + 1)));
+            __m256i j10 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (Jptr + x + stepJ)));
+            __m256i j11 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (Jptr + x + stepJ + 1)));
+            __m256i ival = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(j00, w00), _mm256_mullo_epi32(j01, w01)),
+                _mm256_add_epi32(_mm256_mullo_epi32(j10, w10), _mm256_mullo_epi32(j11, w11)));
+            ival = _mm256_srai_epi32(_mm256_add_epi32(ival, half), W_BITS - 5);
+            __m256i diff = _mm256_sub_epi32(ival, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (Iptr + x))));
+            __m256i dx = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (Ixptr + x)));
+            __m256i dy = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (Iyptr + x)));
+            sum1 = _mm256_add_ps(sum1, _mm256_cvtepi32_ps(_mm256_mullo_epi32(diff, dx)));
+            sum2 = _mm256_add_ps(sum2, _mm256_cvtepi32_ps(_mm256_mullo_epi32(diff, dy)));
+        }
+        ib1 += hsum(sum1);
+        ib2 += hsum(sum2);
+#endif
+        #pragma omp simd reduction(+:ib1,ib2)
+        for (int x = x0; x < WIN; x ++) {
+            int diff = descale(Jptr[x]*iw00 + Jptr[x+1]*iw01 + Jptr[x+stepJ]*iw10 + Jptr[x+stepJ+1]*iw11, W_BITS - 5) - Iptr[x];
+            ib1 += (float)(diff*Ixptr[x]);
+            ib2 += (float)(diff*Iyptr[x]);
+        }
+    }
+
+private:
+    static inline int descale(int x, int n) {
+        return (x + (1 << (n - 1))) >> n;
+    }
+
+#ifdef __AVX2__
+    static inline float hsum(__m256 v) {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+#endif
+};
+
+}
@@ -0,0 +1,146 @@
+#include "feature_tracker.h"
+
+namespace FeatureTracker {
+
+struct GridCorner {
+    float response;
+    cv::Point2f pt;
+    int cell;
+};
+
+//Shi-Tomasi response of the pixels in rect, 3x3 block as goodFeaturesToTrack.
+//Local maxima are appended to corners.
+static void cellCorners(const short * deriv, int dstep, const cv::Rect & rect, int cell, vector<GridCorner> & corners) {
+    int w = rect.width + 2, h = rect.height + 2;
+    vector<float> gxx(w*h), gxy(w*h), gyy(w*h);
+
+    //Gradient products with one pixel margin, the derivative image is padded by WIN_SIZE
+    for (int y = 0; y < h; y ++) {
+        const short * d = deriv + (rect.y + y - 1)*dstep + (rect.x - 1)*2;
+        for (int x = 0; x < w; x ++) {
+            float ix = d[x*2], iy = d[x*2+1];
+            gxx[y*w + x] = ix*ix;
+            gxy[y*w + x] = ix*iy;
+            gyy[y*w + x] = iy*iy;
+        }
+    }
+
+    vector<float> resp(w*h, 0);
+    for (int y = 1; y < h - 1; y ++) {
+        for (int x = 1; x < w - 1; x ++) {
+            float a = 0, b = 0, c = 0;
+            for (int dy = -1; dy <= 1; dy ++) {
+                int i = (y + dy)*w + x;
+                a += gxx[i-1] + gxx[i] + gxx[i+1];
+                b += gxy[i-1] + gxy[i] + gxy[i+1];
+                c += gyy[i-1] + gyy[i] + gyy[i+1];
+            }
+            a *= 0.5f;
+            c *= 0.5f;
+            resp[y*w + x] = (a + c) - std::sqrt((a - c)*(a - c) + b*b);
+        }
+    }
+
+    for (int y = 1; y < h - 1; y ++) {
+        for (int x = 1; x < w - 1; x ++) {
+            float r = resp[y*w + x];
+            if (r <= 0) {
+                continue;
+            }
+            bool is_max = true;
+            for (int dy = -1; dy <= 1 && is_max; dy ++) {
+                for (int dx = -1; dx <= 1; dx ++) {
+                    if ((dx || dy) && resp[(y+dy)*w + x + dx] > r) {
+                        is_max = false;
+                        break;
+                    }
+                }
+            }
+            if (is_max) {
+                corners.push_back({r, cv::Point2f(rect.x + x - 1, rect.y + y - 1), cell});
+            }
+        }
+    }
+}
+
+void detectPointsGrid(const vector<cv::Mat> & pyr, vector<cv::Point2f> & n_pts, const vector<cv::Point2f> & cur_pts, int require_pts) {
+    n_pts.clear();
+    int lack_pts = require_pts - static_cast<int>(cur_pts.size());
+    if (lack_pts <= require_pts/4 || require_pts <= 0) {
+        return;
+    }
+
+    const cv::Mat & deriv = pyr[1];
+    int dstep = (int)(deriv.step / sizeof(short));
+    const short * dptr = deriv.ptr<short>();
+
+    //Cells are at least MIN_DIST wide, so distance checks only look at the 3x3 neighbour cells
+    int cell_size = std::max(MIN_DIST, 1) * 2;
+    int grid_cols = (deriv.cols + cell_size - 1) / cell_size;
+    int grid_rows = (deriv.rows + cell_size - 1) / cell_size;
+    int quota = std::max(1, (require_pts + grid_cols*grid_rows - 1) / (grid_cols*grid_rows));
+    auto cell_of = [&](const cv::Point2f & pt) {
+        int cx = std::min(std::max(cvFloor(pt.x / cell_size), 0), grid_cols - 1);
+        int cy = std::min(std::max(cvFloor(pt.y / cell_size), 0), grid_rows - 1);
+        return cy*grid_cols + cx;
+    };
+
+    vector<vector<cv::Point2f>> cell_pts(grid_cols*grid_rows);
+    for (auto & pt : cur_pts) {
+        cell_pts[cell_of(pt)].push_back(pt);
+    }
+
+    //Corner response is only computed in cells short of their quota
+    const int BORDER = 2;
+    vector<GridCorner> corners;
+    cv::Rect valid(BORDER, BORDER, deriv.cols - 2*BORDER, deriv.rows - 2*BORDER);
+    for (int c = 0; c < grid_cols*grid_rows; c ++) {
+        if ((int)cell_pts[c].size() >= quota) {
+            continue;
+        }
+        cv::Rect rect = cv::Rect((c % grid_cols)*cell_size, (c / grid_cols)*cell_size, cell_size, cell_size) & valid;
+        if (rect.area() > 0) {
+            cellCorners(dptr, dstep, rect, c, corners);
+        }
+    }
+
+    if (corners.empty()) {
+        return;
+    }
+
+    std::sort(corners.begin(), corners.end(), [](const GridCorner & a, const GridCorner & b) {
+        return a.response > b.response;
+    });
+    float threshold = corners[0].response * 0.01f;
+    float min_dist2 = MIN_DIST*MIN_DIST;
+
+    for (auto & corner : corners) {
+        if (corner.response < threshold || (int)n_pts.size() >= lack_pts) {
+            break;
+        }
+        if ((int)cell_pts[corner.cell].size() >= quota) {
+            continue;
+        }
+
+        int cx = corner.cell % grid_cols, cy = corner.cell / grid_cols;
+        bool too_close = false;
+        for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, grid_rows - 1) && !too_close; y ++) {
+            for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, grid_cols - 1) && !too_close; x ++) {
+                for (auto & pt : cell_pts[y*grid_cols + x]) {
+                    cv::Point2f d = pt - corner.pt;
+                    if (d.dot(d) < min_dist2) {
+                        too_close = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (!too_close) {
+            cell_pts[corner.cell].push_back(corner.pt);
+            n_pts.push_back(corner.pt);
+        }
+    }
+}
+
+}
@@ -6,7 +6,10 @@
 #include "depth_generation/depth_camera_manager.h"
 
 using namespace FeatureTracker;     
-FisheyeFlattenHandler::FisheyeFlattenHandler(ros::NodeHandle & n, bool _is_color): mask_up(5, 0), mask_down(5, 0), is_color(_is_color)
+FisheyeFlattenHandler::FisheyeFlattenHandler(ros::NodeHandle & n, bool _is_color): 
+    raw_buf(PIPELINE_QUEUE_SIZE, (QueueDropPolicy) INPUT_DROP_POLICY),
+    flattened_buf(PIPELINE_QUEUE_SIZE, QUEUE_BLOCK),
+    mask_up(5, 0), mask_down(5, 0), direct_views(5, false), is_color(_is_color)
 {
 
     readIntrinsicParameter(CAM_NAMES);
@@ -53,19 +56,56 @@ int FisheyeFlattenHandler::raw_width() {
 
 void FisheyeFlattenHandler::imgs_callback(const sensor_msgs::ImageConstPtr &img1_msg, const sensor_msgs::ImageConstPtr &img2_msg)
 {
-    auto img1 = getImageFromMsg(img1_msg);
-    auto img2 = getImageFromMsg(img2_msg);
-    stamp = img1_msg->header.stamp;
-    imgs_callback(img1_msg->header.stamp.toSec(), img1->image, img2->image);
+    RawStereoFrame frame;
+    frame.t = img1_msg->header.stamp.toSec();
+    frame.img1_ptr = getImageFromMsg(img1_msg);
+    frame.img2_ptr = getImageFromMsg(img2_msg);
+    frame.img1 = frame.img1_ptr->image;
+    frame.img2 = frame.img2_ptr->image;
+    input_raw_images(std::move(frame));
 }
 
-void FisheyeFlattenHandler::imgs_callback(double t, const cv::Mat & img1, const cv::Mat img2, bool is_blank_init) {
+void FisheyeFlattenHandler::input_raw_images(RawStereoFrame && frame) {
+    if (!raw_buf.push(std::move(frame))) {
+        ROS_WARN("Flatten stage is busy, drop input frame; total dropped %ld", raw_buf.dropped_count());
+    }
+}
+
+void FisheyeFlattenHandler::start_flatten_thread() {
+    flatten_thread = std::thread(&FisheyeFlattenHandler::flatten_loop, this);
+}
+
+FisheyeFlattenHandler::~FisheyeFlattenHandler() {
+    stop();
+}
+
+void FisheyeFlattenHandler::stop() {
+    raw_buf.stop();
+    flattened_buf.stop();
+    if (flatten_thread.joinable()) {
+        flatten_thread.join();
+    }
+}
+
+void FisheyeFlattenHandler::flatten_loop() {
+    RawStereoFrame frame;
+    while (ros::ok() && !raw_buf.is_stopped()) {
+        if (!raw_buf.pop(frame, 10)) {
+            continue;
+        }
 
-    static double flatten_time_sum = 0;
-    static double count = 0;
+        imgs_callback(frame.t, frame.img1, frame.img2);
 
-    count += 1;
+        auto wait_hist = raw_buf.wait_histogram();
+        if (ENABLE_PERF_OUTPUT && wait_hist.count() % 100 == 0) {
+            ROS_INFO("[Pipeline] input queue wait %s dropped %ld", wait_hist.summary().c_str(), 
+                raw_buf.dropped_count());
+        }
+    }
+    flattened_buf.stop();
+}
 
+void FisheyeFlattenHandler::imgs_callback(double t, const cv::Mat & img1, const cv::Mat img2, bool is_blank_init) {
     TicToc t_f;
 
     if (USE_GPU) {
@@ -99,16 +139,36 @@ void FisheyeFlattenHandler::imgs_callback(double t, const cv::Mat & img1, const
         }
 
         if (!is_blank_init) {
-            buf_lock.lock();
-            fisheye_buf_t.push(t);
-            fisheye_cuda_buf_up.push(fisheye_up_imgs_cuda_gray);
-            fisheye_cuda_buf_down.push(fisheye_down_imgs_cuda_gray);
+            FlattenedFrame frame;
+            frame.t = t;
+            frame.up_gray_cuda = fisheye_up_imgs_cuda_gray;
+            frame.down_gray_cuda = fisheye_down_imgs_cuda_gray;
             if(is_color) {
-                fisheye_cuda_buf_up_color.push(fisheye_up_imgs_cuda);
-                fisheye_cuda_buf_down_color.push(fisheye_down_imgs_cuda);
+                frame.up_color_cuda = fisheye_up_imgs_cuda;
+                frame.down_color_cuda = fisheye_down_imgs_cuda;
             }
-            buf_lock.unlock();
+            PERF_RECORD(PERF_FLATTEN, t_f.toc());
+            //Block here when tracking falls behind
+            flattened_buf.push(std::move(frame));
+        }
+    } else if (FISHEYE_DIRECT) {
+        FlattenedFrame frame;
+        frame.t = t;
+        if (img1.channels() == 3) {
+            cv::cvtColor(img1, frame.up_raw, cv::COLOR_BGR2GRAY);
+            cv::cvtColor(img2, frame.down_raw, cv::COLOR_BGR2GRAY);
+        } else {
+            frame.up_raw = img1;
+            frame.down_raw = img2;
+        }
+
+        if (ENABLE_DEPTH) {
+            fisheys_undists[0].stereo_flatten_views(frame.up_raw, frame.down_raw, &fisheys_undists[1], 
+                frame.up_gray, frame.down_gray, direct_views);
         }
+
+        PERF_RECORD(PERF_FLATTEN, t_f.toc());
+        flattened_buf.push(std::move(frame));
     } else {
         if (is_color) {
             fisheys_undists[0].stereo_flatten(img1, img2, &fisheys_undists[1], 
@@ -137,93 +197,24 @@ void FisheyeFlattenHandler::imgs_callback(double t, const cv::Mat & img1, const
                 enable_up_top, enable_rear_side, enable_down_top, enable_rear_side);
         }
 
-        buf_lock.lock();
-        fisheye_buf_t.push(t);
-        fisheye_buf_up.push(fisheye_up_imgs_gray);
-        fisheye_buf_down.push(fisheye_down_imgs_gray);
+        FlattenedFrame frame;
+        frame.t = t;
+        frame.up_gray = fisheye_up_imgs_gray;
+        frame.down_gray = fisheye_down_imgs_gray;
 
         if (is_color) {
-            fisheye_buf_up_color.push(fisheye_up_imgs);
-            fisheye_buf_down_color.push(fisheye_down_imgs);
+            frame.up_color = fisheye_up_imgs;
+            frame.down_color = fisheye_down_imgs;
         }
 
-        buf_lock.unlock();
-    }
-
-    double tf = t_f.toc();
-    if (ENABLE_PERF_OUTPUT) {
-        ROS_INFO("img_callback cost %fms flatten %fms Flatten AVG %fms", t_f.toc(), tf, flatten_time_sum/count);
+        PERF_RECORD(PERF_FLATTEN, t_f.toc());
+        //Block here when tracking falls behind
+        flattened_buf.push(std::move(frame));
     }
-
-    flatten_time_sum += t_f.toc();
 }
 
-bool FisheyeFlattenHandler::has_image_in_buffer() {
-    return fisheye_buf_t.size() > 0;
-}
-
-double FisheyeFlattenHandler::pop_from_buffer(
-            CvCudaImages & up_gray, CvCudaImages & down_gray,
-            CvCudaImages & up_color, CvCudaImages & down_color) {
-    if (USE_GPU) {
-        buf_lock.lock();
-        if (fisheye_buf_t.size() > 0) {
-            auto t = fisheye_buf_t.front();
-            up_gray = fisheye_cuda_buf_up.front();
-            down_gray = fisheye_cuda_buf_down.front();
-
-            if(is_color) {
-                up_color = fisheye_cuda_buf_up_color.front();
-                down_color = fisheye_cuda_buf_down_color.front();
-            }
-
-
-            fisheye_buf_t.pop();
-            fisheye_cuda_buf_up.pop();
-            fisheye_cuda_buf_down.pop();
-
-            if(is_color) {
-                fisheye_cuda_buf_up_color.pop();
-                fisheye_cuda_buf_down_color.pop();
-            }
-
-            buf_lock.unlock();
-            return t;
-        }
-    }
-    return -1;
-}
-
-double FisheyeFlattenHandler::pop_from_buffer(
-            CvImages & up_gray, CvImages & down_gray,
-            CvImages & up_color, CvImages & down_color) {
-    if(!USE_GPU) {
-        buf_lock.lock();
-        if (fisheye_buf_t.size() > 0) {
-            auto t = fisheye_buf_t.front();
-
-            up_gray = fisheye_buf_up.front();
-            down_gray = fisheye_buf_down.front();
-
-            if(is_color) {
-                up_color = fisheye_buf_up_color.front();
-                down_color = fisheye_buf_down_color.front();
-            }
-
-            fisheye_buf_t.pop();
-            fisheye_buf_up.pop();
-            fisheye_buf_down.pop();
-
-            if(is_color) {
-                fisheye_buf_up_color.pop();
-                fisheye_buf_down_color.pop();
-            }
-            
-            buf_lock.unlock();
-            return t;
-        }
-    }
-    return -1;
+bool FisheyeFlattenHandler::pop_from_buffer(FlattenedFrame & frame, double timeout_ms) {
+    return flattened_buf.pop(frame, timeout_ms);
 }
 
 void FisheyeFlattenHandler::setup_extrinsic(vins::FlattenImages & images, const Estimator & estimator) {
@@ -251,18 +242,15 @@ void FisheyeFlattenHandler::pack_and_send(ros::Time stamp,
         cv::InputArray fisheye_up_imgs, cv::InputArray fisheye_down_imgs, 
         cv::InputArray fisheye_up_imgs_gray, cv::InputArray fisheye_down_imgs_gray, 
         const Estimator & estimator) {
-    TicToc t_p;
+    PERF_SCOPE(PERF_PUBLISH);
     vins::FlattenImages images;
     vins::FlattenImages images_gray;
-    static double pack_send_time = 0;
 
     setup_extrinsic(images, estimator);
     setup_extrinsic(images_gray, estimator);
 
     images.header.stamp = stamp;
     images_gray.header.stamp = stamp;
-    static int count = 0;
-    count ++;
 
     CvCudaImages fisheye_up_imgs_cuda, fisheye_down_imgs_cuda;
     CvCudaImages fisheye_up_imgs_cuda_gray, fisheye_down_imgs_cuda_gray;
@@ -344,11 +332,6 @@ void FisheyeFlattenHandler::pack_and_send(ros::Time stamp,
     }
 
     flatten_gray_pub.publish(images_gray);
-    pack_send_time += t_p.toc();
-
-    if (ENABLE_PERF_OUTPUT) {
-        ROS_INFO("Pack and send AVG %fms this %fms", pack_send_time/count, t_p.toc());
-    }
 }
 
 
@@ -387,48 +370,62 @@ void VinsNodeBaseClass::pack_and_send_thread(const ros::TimerEvent & e) {
     }
 }
 
-void VinsNodeBaseClass::processFlattened(const ros::TimerEvent & e) {
-    TicToc t0;
-    if (fisheye_handler->has_image_in_buffer()) {
-        pack_and_send_mtx.lock();
+void VinsNodeBaseClass::processFlattened() {
+    FlattenedFrame frame;
+    while (ros::ok()) {
+        if (!fisheye_handler->pop_from_buffer(frame, 10)) {
+            if (fisheye_handler->stopped()) {
+                break;
+            }
+            continue;
+        }
 
-        if (USE_GPU) {
-            cur_frame_t = fisheye_handler->pop_from_buffer(
-                cur_up_gray_cuda,
-                cur_down_gray_cuda,
-                cur_up_color_cuda,
-                cur_down_color_cuda
-            );
+        pack_and_send_mtx.lock();
+        cur_frame_t = frame.t;
+        bool is_odometry_frame = estimator.is_next_odometry_frame();
 
-            bool is_odometry_frame = estimator.is_next_odometry_frame();
+        if (is_odometry_frame) {
+            need_to_pack_and_send = true;
+        }
 
-            if (is_odometry_frame) {
-                need_to_pack_and_send = true;
-            }
+        if (USE_GPU) {
+            cur_up_gray_cuda = frame.up_gray_cuda;
+            cur_down_gray_cuda = frame.down_gray_cuda;
+            cur_up_color_cuda = frame.up_color_cuda;
+            cur_down_color_cuda = frame.down_color_cuda;
             estimator.inputFisheyeImage(cur_frame_t, cur_up_gray_cuda, cur_down_gray_cuda);
+        } else if (FISHEYE_DIRECT) {
+            estimator.inputFisheyeRawImage(cur_frame_t, frame.up_raw, frame.down_raw, frame.up_gray, frame.down_gray);
         } else {
-            cur_frame_t = fisheye_handler->pop_from_buffer(
-                cur_up_gray,
-                cur_down_gray,
-                cur_up_color,
-                cur_down_color
-            );
-
-            bool is_odometry_frame = estimator.is_next_odometry_frame();
-
-            if (is_odometry_frame) {
-                need_to_pack_and_send = true;
-            }
+            cur_up_gray = frame.up_gray;
+            cur_down_gray = frame.down_gray;
+            cur_up_color = frame.up_color;
+            cur_down_color = frame.down_color;
             estimator.inputFisheyeImage(cur_frame_t, cur_up_gray, cur_down_gray);
         }
-        double t_0 = t0.toc();
         //Need to wait for pack and send to endft
         pack_and_send_mtx.unlock();
+    }
+}
 
-        if(ENABLE_PERF_OUTPUT) {
-            ROS_INFO("[processFlattened]Input Image: %fms, whole %fms", t_0, t0.toc());
-        }
+void VinsNodeBaseClass::perf_callback(const ros::TimerEvent & e) {
+    std::vector<LatencyHistogram> hists;
+    perf::collect(hists);
+
+    std_msgs::Header header;
+    header.stamp = e.current_real;
+    pubPerfStats(hists, header);
 
+    if (perf_csv.is_open()) {
+        perf::write_csv(perf_csv, e.current_real.toSec(), hists, false);
+    }
+
+    if (ENABLE_PERF_OUTPUT) {
+        for (size_t i = 0; i < hists.size(); i ++) {
+            if (hists[i].count() > 0) {
+                ROS_INFO("[Perf] %-12s %s", perf::stage_name(i), hists[i].summary().c_str());
+            }
+        }
     }
 }
 
@@ -444,10 +441,12 @@ void VinsNodeBaseClass::fisheye_imgs_callback(const sensor_msgs::ImageConstPtr &
 
 void VinsNodeBaseClass::fisheye_comp_imgs_callback(const sensor_msgs::CompressedImageConstPtr &img1_msg, const sensor_msgs::CompressedImageConstPtr &img2_msg) {
     TicToc tic_input;
-    auto img1 = getImageFromMsg(img1_msg);
-    auto img2 = getImageFromMsg(img2_msg);
+    RawStereoFrame frame;
+    frame.t = img1_msg->header.stamp.toSec();
+    frame.img1 = getImageFromMsg(img1_msg);
+    frame.img2 = getImageFromMsg(img2_msg);
 
-    fisheye_handler->imgs_callback(img1_msg->header.stamp.toSec(), img1, img2);
+    fisheye_handler->input_raw_images(std::move(frame));
 
     if (img1_msg->header.stamp.toSec() - t_last > 0.11) {
         ROS_WARN("Duration between two images is %fms", img1_msg->header.stamp.toSec() - t_last);
@@ -489,13 +488,26 @@ void VinsNodeBaseClass::restart_callback(const std_msgs::BoolConstPtr &restart_m
     if (restart_msg->data == true)
     {
         ROS_WARN("restart the estimator!");
-        estimator.clearState();
-        estimator.setParameter();
+        estimator.requestRestart();
     }
     return;
 }
 
 
+void VinsNodeBaseClass::stop() {
+    timer2.stop();
+    if (fisheye_handler != nullptr) {
+        fisheye_handler->stop();
+    }
+    if (track_thread.joinable()) {
+        track_thread.join();
+    }
+}
+
+VinsNodeBaseClass::~VinsNodeBaseClass() {
+    stop();
+}
+
 void VinsNodeBaseClass::Init(ros::NodeHandle & n)
 {
     std::string config_file;
@@ -533,6 +545,9 @@ void VinsNodeBaseClass::Init(ros::NodeHandle & n)
 
     if (FISHEYE) {
         fisheye_handler = new FisheyeFlattenHandler(n, FLATTEN_COLOR);
+        if (FISHEYE_DIRECT && cam_manager != nullptr) {
+            fisheye_handler->set_direct_views(cam_manager->consumed_views());
+        }
     }
 
     //We use blank images to initialize cuda before every thing
@@ -571,9 +586,18 @@ void VinsNodeBaseClass::Init(ros::NodeHandle & n)
     }
 
     if (FISHEYE) {
-        timer1 = n.createTimer(ros::Duration(0.004), boost::bind(&VinsNodeBaseClass::processFlattened, (VinsNodeBaseClass*)this, _1 ));
-        if (PUB_FLATTEN) {
+        fisheye_handler->start_flatten_thread();
+        track_thread = std::thread(&VinsNodeBaseClass::processFlattened, this);
+        if (PUB_FLATTEN && FISHEYE_DIRECT) {
+            ROS_WARN("Flattened images are not published in direct fisheye tracking mode");
+        } else if (PUB_FLATTEN) {
             timer2 = n.createTimer(ros::Duration(1/PUB_FLATTEN_FREQ), boost::bind(&VinsNodeBaseClass::pack_and_send_thread, (VinsNodeBaseClass*)this, _1 ));
         }
     }
+
+#ifdef WITH_PERF_STATS
+    perf_csv.open(OUTPUT_FOLDER + "/perf.csv", std::ios::out);
+    perf::write_csv(perf_csv, 0, std::vector<LatencyHistogram>(), true);
+    perf_timer = n.createTimer(ros::Duration(PERF_REPORT_PERIOD), boost::bind(&VinsNodeBaseClass::perf_callback, (VinsNodeBaseClass*)this, _1 ));
+#endif
 }
\ No newline at end of file
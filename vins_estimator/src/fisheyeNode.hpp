@@ -2,11 +2,15 @@
 #include <queue>
 #include <map>
 #include <mutex>
+#include <thread>
 #include <ros/ros.h>
 #include <cv_bridge/cv_bridge.h>
 #include <opencv2/opencv.hpp>
 #include "utility/visualization.h"
 #include "utility/tic_toc.h"
+#include "utility/bounded_queue.h"
+#include "utility/perf.h"
+#include <fstream>
 
 #include <boost/thread.hpp>
 #include "vins/FlattenImages.h"
@@ -21,6 +25,23 @@ class Estimator;
 class FisheyeUndist;
 class DepthCamManager;
 
+struct RawStereoFrame {
+    double t = -1;
+    cv::Mat img1, img2;
+    //Keep the ros messages alive when images are shared with them
+    cv_bridge::CvImageConstPtr img1_ptr, img2_ptr;
+};
+
+struct FlattenedFrame {
+    double t = -1;
+    CvCudaImages up_gray_cuda, down_gray_cuda;
+    CvCudaImages up_color_cuda, down_color_cuda;
+    CvImages up_gray, down_gray;
+    CvImages up_color, down_color;
+    //Gray raw fisheye images, direct tracking only
+    cv::Mat up_raw, down_raw;
+};
+
 class FisheyeFlattenHandler
 {
     vector<FisheyeUndist> fisheys_undists;
@@ -28,11 +49,17 @@ class FisheyeFlattenHandler
     ros::Publisher flatten_gray_pub;
     ros::Publisher flatten_pub;
     std::vector<bool> mask_up, mask_down;
-    ros::Time stamp;
+    //Views flattened in direct tracking mode
+    std::vector<bool> direct_views;
 
     bool is_color = false;
 
-    std::mutex buf_lock;
+    //Pipeline: raw_buf -> flatten thread -> flattened_buf -> tracking
+    BoundedQueue<RawStereoFrame> raw_buf;
+    BoundedQueue<FlattenedFrame> flattened_buf;
+    std::thread flatten_thread;
+
+    void flatten_loop();
 
     public:
 
@@ -40,16 +67,6 @@ class FisheyeFlattenHandler
         int raw_height();
         int raw_width();
 
-
-        std::queue<CvCudaImages> fisheye_cuda_buf_up, fisheye_cuda_buf_down;
-        std::queue<CvCudaImages> fisheye_cuda_buf_up_color, fisheye_cuda_buf_down_color;
-
-        std::queue<CvImages> fisheye_buf_up, fisheye_buf_down;
-        std::queue<CvImages> fisheye_buf_up_color, fisheye_buf_down_color;
-
-        std::queue<double> fisheye_buf_t;
-        //Only gray image will be saved in buf now
-
         CvCudaImages fisheye_up_imgs_cuda, fisheye_down_imgs_cuda;
         CvCudaImages fisheye_up_imgs_cuda_gray, fisheye_down_imgs_cuda_gray;
         
@@ -59,20 +76,25 @@ class FisheyeFlattenHandler
         
         FisheyeFlattenHandler(ros::NodeHandle & n, bool _is_color = true);
 
+        ~FisheyeFlattenHandler();
+
 
         void imgs_callback(const sensor_msgs::ImageConstPtr &img1_msg, const sensor_msgs::ImageConstPtr &img2_msg);
 
         void imgs_callback(double t, const cv::Mat & img1, const cv::Mat img2, bool is_blank_init = false);
 
-        bool has_image_in_buffer();
+        void input_raw_images(RawStereoFrame && frame);
 
-        double pop_from_buffer(CvCudaImages & up_gray, CvCudaImages & down_gray,
-            CvCudaImages & up_color_gray, CvCudaImages & down_color_gray
-        );
-        
-        double pop_from_buffer(CvImages & up_gray, CvImages & down_gray,
-            CvImages & up_color_gray, CvImages & down_color_gray
-        );
+        void start_flatten_thread();
+
+        //Stop both queues and join the flatten thread
+        void stop();
+
+        bool stopped() const {
+            return flattened_buf.is_stopped();
+        }
+
+        bool pop_from_buffer(FlattenedFrame & frame, double timeout_ms);
 
         void setup_extrinsic(vins::FlattenImages & images, const Estimator & estimator);
 
@@ -84,6 +106,9 @@ class FisheyeFlattenHandler
 
         void readIntrinsicParameter(const vector<string> &calib_file);
 
+        void set_direct_views(const std::vector<bool> & views) {
+            direct_views = views;
+        }
 };
 
 
@@ -96,8 +121,11 @@ class VinsNodeBaseClass {
         message_filters::Subscriber<sensor_msgs::CompressedImage> * comp_image_sub_r;
         message_filters::TimeSynchronizer<sensor_msgs::CompressedImage, sensor_msgs::CompressedImage> * comp_sync;
 
-        FisheyeFlattenHandler * fisheye_handler;
-        ros::Timer timer1, timer2;
+        FisheyeFlattenHandler * fisheye_handler = nullptr;
+        ros::Timer timer2;
+        ros::Timer perf_timer;
+        std::ofstream perf_csv;
+        std::thread track_thread;
 
         DepthCamManager * cam_manager = nullptr;
 
@@ -130,7 +158,9 @@ class VinsNodeBaseClass {
 
         void pack_and_send_thread(const ros::TimerEvent & e);
 
-        void processFlattened(const ros::TimerEvent & e);
+        void processFlattened();
+
+        void perf_callback(const ros::TimerEvent & e);
 
         void fisheye_imgs_callback(const sensor_msgs::ImageConstPtr &img1_msg, const sensor_msgs::ImageConstPtr &img2_msg);
         
@@ -145,4 +175,10 @@ class VinsNodeBaseClass {
         void restart_callback(const std_msgs::BoolConstPtr &restart_msg);
 
         virtual void Init(ros::NodeHandle & n);
+
+        //Stop the flatten and tracking stages and join their threads
+        void stop();
+
+    public:
+        virtual ~VinsNodeBaseClass();
 };
\ No newline at end of file
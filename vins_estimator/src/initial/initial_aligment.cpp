@@ -11,7 +11,7 @@
 
 #include "initial_alignment.h"
 
-void solveGyroscopeBias(map<double, ImageFrame> &all_image_frame, Vector3d* Bgs)
+void solveGyroscopeBias(map<double, ImageFrame> &all_image_frame, WindowVector3d &Bgs)
 {
     Matrix3d A;
     Vector3d b;
@@ -23,10 +23,8 @@ void solveGyroscopeBias(map<double, ImageFrame> &all_image_frame, Vector3d* Bgs)
     for (frame_i = all_image_frame.begin(); next(frame_i) != all_image_frame.end(); frame_i++)
     {
         frame_j = next(frame_i);
-        MatrixXd tmp_A(3, 3);
-        tmp_A.setZero();
-        VectorXd tmp_b(3);
-        tmp_b.setZero();
+        Matrix3d tmp_A;
+        Vector3d tmp_b;
         Eigen::Quaterniond q_ij(frame_i->second.R.transpose() * frame_j->second.R);
         tmp_A = frame_j->second.pre_integration->jacobian.template block<3, 3>(O_R, O_BG);
         tmp_b = 2 * (frame_j->second.pre_integration->delta_q.inverse() * q_ij).vec();
@@ -39,15 +37,17 @@ void solveGyroscopeBias(map<double, ImageFrame> &all_image_frame, Vector3d* Bgs)
     for (int i = 0; i <= WINDOW_SIZE; i++)
         Bgs[i] += delta_bg;
 
-    for (frame_i = all_image_frame.begin(); next(frame_i) != all_image_frame.end( ); frame_i++)
-    {
-        frame_j = next(frame_i);
-        frame_j->second.pre_integration->repropagate(Vector3d::Zero(), Bgs[0]);
-    }
+    //Repropagation replays the raw imu samples of each interval independently
+    vector<IntegrationBase *> intervals;
+    for (frame_i = next(all_image_frame.begin()); frame_i != all_image_frame.end(); frame_i++)
+        intervals.push_back(frame_i->second.pre_integration);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < (int)intervals.size(); i++)
+        intervals[i]->repropagate(Vector3d::Zero(), Bgs[0]);
 }
 
 
-MatrixXd TangentBasis(Vector3d &g0)
+Matrix<double, 3, 2> TangentBasis(Vector3d &g0)
 {
     Vector3d b, c;
     Vector3d a = g0.normalized();
@@ -56,7 +56,7 @@ MatrixXd TangentBasis(Vector3d &g0)
         tmp << 1, 0, 0;
     b = (tmp - a * (a.transpose() * tmp)).normalized();
     c = a.cross(b);
-    MatrixXd bc(3, 2);
+    Matrix<double, 3, 2> bc;
     bc.block<3, 1>(0, 0) = b;
     bc.block<3, 1>(0, 1) = c;
     return bc;
@@ -79,17 +79,14 @@ void RefineGravity(map<double, ImageFrame> &all_image_frame, Vector3d &g, Vector
     map<double, ImageFrame>::iterator frame_j;
     for(int k = 0; k < 4; k++)
     {
-        MatrixXd lxly(3, 2);
-        lxly = TangentBasis(g0);
+        Matrix<double, 3, 2> lxly = TangentBasis(g0);
         int i = 0;
         for (frame_i = all_image_frame.begin(); next(frame_i) != all_image_frame.end(); frame_i++, i++)
         {
             frame_j = next(frame_i);
 
-            MatrixXd tmp_A(6, 9);
-            tmp_A.setZero();
-            VectorXd tmp_b(6);
-            tmp_b.setZero();
+            Matrix<double, 6, 9> tmp_A = Matrix<double, 6, 9>::Zero();
+            Matrix<double, 6, 1> tmp_b = Matrix<double, 6, 1>::Zero();
 
             double dt = frame_j->second.pre_integration->sum_dt;
 
@@ -110,8 +107,8 @@ void RefineGravity(map<double, ImageFrame> &all_image_frame, Vector3d &g, Vector
             //MatrixXd cov_inv = cov.inverse();
             cov_inv.setIdentity();
 
-            MatrixXd r_A = tmp_A.transpose() * cov_inv * tmp_A;
-            VectorXd r_b = tmp_A.transpose() * cov_inv * tmp_b;
+            Matrix<double, 9, 9> r_A = tmp_A.transpose() * cov_inv * tmp_A;
+            Matrix<double, 9, 1> r_b = tmp_A.transpose() * cov_inv * tmp_b;
 
             A.block<6, 6>(i * 3, i * 3) += r_A.topLeftCorner<6, 6>();
             b.segment<6>(i * 3) += r_b.head<6>();
@@ -125,7 +122,7 @@ void RefineGravity(map<double, ImageFrame> &all_image_frame, Vector3d &g, Vector
             A = A * 1000.0;
             b = b * 1000.0;
             x = A.ldlt().solve(b);
-            VectorXd dg = x.segment<2>(n_state - 3);
+            Vector2d dg = x.segment<2>(n_state - 3);
             g0 = (g0 + lxly * dg).normalized() * G.norm();
             //double s = x(n_state - 1);
     }   
@@ -149,10 +146,8 @@ bool LinearAlignment(map<double, ImageFrame> &all_image_frame, Vector3d &g, Vect
     {
         frame_j = next(frame_i);
 
-        MatrixXd tmp_A(6, 10);
-        tmp_A.setZero();
-        VectorXd tmp_b(6);
-        tmp_b.setZero();
+        Matrix<double, 6, 10> tmp_A = Matrix<double, 6, 10>::Zero();
+        Matrix<double, 6, 1> tmp_b = Matrix<double, 6, 1>::Zero();
 
         double dt = frame_j->second.pre_integration->sum_dt;
 
@@ -172,8 +167,8 @@ bool LinearAlignment(map<double, ImageFrame> &all_image_frame, Vector3d &g, Vect
         //MatrixXd cov_inv = cov.inverse();
         cov_inv.setIdentity();
 
-        MatrixXd r_A = tmp_A.transpose() * cov_inv * tmp_A;
-        VectorXd r_b = tmp_A.transpose() * cov_inv * tmp_b;
+        Matrix<double, 10, 10> r_A = tmp_A.transpose() * cov_inv * tmp_A;
+        Matrix<double, 10, 1> r_b = tmp_A.transpose() * cov_inv * tmp_b;
 
         A.block<6, 6>(i * 3, i * 3) += r_A.topLeftCorner<6, 6>();
         b.segment<6>(i * 3) += r_b.head<6>();
@@ -206,7 +201,7 @@ bool LinearAlignment(map<double, ImageFrame> &all_image_frame, Vector3d &g, Vect
         return true;
 }
 
-bool VisualIMUAlignment(map<double, ImageFrame> &all_image_frame, Vector3d* Bgs, Vector3d &g, VectorXd &x)
+bool VisualIMUAlignment(map<double, ImageFrame> &all_image_frame, WindowVector3d &Bgs, Vector3d &g, VectorXd &x)
 {
     solveGyroscopeBias(all_image_frame, Bgs);
 
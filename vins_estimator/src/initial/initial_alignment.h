@@ -33,8 +33,8 @@ class ImageFrame
         double t;
         Matrix3d R;
         Vector3d T;
-        IntegrationBase *pre_integration;
+        IntegrationBase *pre_integration = nullptr;
         bool is_key_frame;
 };
-void solveGyroscopeBias(map<double, ImageFrame> &all_image_frame, Vector3d* Bgs);
-bool VisualIMUAlignment(map<double, ImageFrame> &all_image_frame, Vector3d* Bgs, Vector3d &g, VectorXd &x);
\ No newline at end of file
+void solveGyroscopeBias(map<double, ImageFrame> &all_image_frame, WindowVector3d &Bgs);
+bool VisualIMUAlignment(map<double, ImageFrame> &all_image_frame, WindowVector3d &Bgs, Vector3d &g, VectorXd &x);
\ No newline at end of file
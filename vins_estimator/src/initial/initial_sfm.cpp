@@ -10,6 +10,7 @@
  *******************************************************/
 
 #include "initial_sfm.h"
+#include <omp.h>
 
 GlobalSFM::GlobalSFM(){}
 
@@ -87,6 +88,8 @@ void GlobalSFM::triangulateTwoFrames(int frame0, Eigen::Matrix<double, 3, 4> &Po
 									 vector<SFMFeature> &sfm_f)
 {
 	assert(frame0 != frame1);
+	//Every feature only touches its own entry
+	#pragma omp parallel for schedule(dynamic, 64)
 	for (int j = 0; j < feature_num; j++)
 	{
 		if (sfm_f[j].state == true)
@@ -206,6 +209,7 @@ bool GlobalSFM::construct(int frame_num, Quaterniond* q, Vector3d* T, int l,
 		triangulateTwoFrames(i, Pose[i], l, Pose[l], sfm_f);
 	}
 	//5: triangulate all other points
+	#pragma omp parallel for schedule(dynamic, 64)
 	for (int j = 0; j < feature_num; j++)
 	{
 		if (sfm_f[j].state == true)
@@ -284,6 +288,8 @@ bool GlobalSFM::construct(int frame_num, Quaterniond* q, Vector3d* T, int l,
 	}
 	ceres::Solver::Options options;
 	options.linear_solver_type = ceres::DENSE_SCHUR;
+	//Schur elimination and jacobian evaluation split over the landmarks
+	options.num_threads = omp_get_max_threads();
 	//options.minimizer_progress_to_stdout = true;
 	options.max_solver_time_in_seconds = 0.2;
 	ceres::Solver::Summary summary;
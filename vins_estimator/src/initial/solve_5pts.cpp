@@ -12,221 +12,343 @@
 #include "solve_5pts.h"
 
 
-namespace cv {
-    void decomposeEssentialMat( InputArray _E, OutputArray _R1, OutputArray _R2, OutputArray _t )
-    {
-
-        Mat E = _E.getMat().reshape(1, 3);
-        CV_Assert(E.cols == 3 && E.rows == 3);
-
-        Mat D, U, Vt;
-        SVD::compute(E, D, U, Vt);
-
-        if (determinant(U) < 0) U *= -1.;
-        if (determinant(Vt) < 0) Vt *= -1.;
-
-        Mat W = (Mat_<double>(3, 3) << 0, 1, 0, -1, 0, 0, 0, 0, 1);
-        W.convertTo(W, E.type());
+namespace
+{
+//Polynomials in x, y, z up to degree 3, monomials sorted by degree:
+//1 | x y z | x^2 xy xz y^2 yz z^2 | x^3 x^2y x^2z xy^2 xyz xz^2 y^3 y^2z yz^2 z^3
+typedef Matrix<double, 20, 1> Poly;
+const int MONOMIALS[4] = {1, 4, 10, 20};
 
-        Mat R1, R2, t;
-        R1 = U * W * Vt;
-        R2 = U * W.t() * Vt;
-        t = U.col(2) * 1.0;
+struct MonomialTable
+{
+    //Index of the product of two monomials, -1 above degree 3
+    int product[20][20];
 
-        R1.copyTo(_R1);
-        R2.copyTo(_R2);
-        t.copyTo(_t);
+    MonomialTable()
+    {
+        int exps[20][3], n = 0;
+        for (int d = 0; d <= 3; d++)
+            for (int a = d; a >= 0; a--)
+                for (int b = d - a; b >= 0; b--)
+                {
+                    exps[n][0] = a;
+                    exps[n][1] = b;
+                    exps[n][2] = d - a - b;
+                    n++;
+                }
+        for (int i = 0; i < 20; i++)
+            for (int j = 0; j < 20; j++)
+            {
+                product[i][j] = -1;
+                for (int k = 0; k < 20; k++)
+                    if (exps[k][0] == exps[i][0] + exps[j][0] && exps[k][1] == exps[i][1] + exps[j][1] &&
+                        exps[k][2] == exps[i][2] + exps[j][2])
+                        product[i][j] = k;
+            }
     }
+};
 
-    int recoverPose( InputArray E, InputArray _points1, InputArray _points2, InputArray _cameraMatrix,
-                         OutputArray _R, OutputArray _t, InputOutputArray _mask)
-    {
+const MonomialTable &monomials()
+{
+    static const MonomialTable table;
+    return table;
+}
 
-        Mat points1, points2, cameraMatrix;
-        _points1.getMat().convertTo(points1, CV_64F);
-        _points2.getMat().convertTo(points2, CV_64F);
-        _cameraMatrix.getMat().convertTo(cameraMatrix, CV_64F);
+//Product of a degree dp and a degree dq polynomial
+Poly mul(const Poly &p, int dp, const Poly &q, int dq)
+{
+    const MonomialTable &table = monomials();
+    Poly r = Poly::Zero();
+    for (int i = 0; i < MONOMIALS[dp]; i++)
+        for (int j = 0; j < MONOMIALS[dq]; j++)
+            r(table.product[i][j]) += p(i) * q(j);
+    return r;
+}
 
-        int npoints = points1.checkVector(2);
-        CV_Assert( npoints >= 0 && points2.checkVector(2) == npoints &&
-                                  points1.type() == points2.type());
+//Ranges along both bearings, least squares of x2 * d2 = R * x1 * d1 + T, false without parallax
+bool triangulateBearings(const Vector3d &x1, const Vector3d &x2, const Matrix3d &R, const Vector3d &T,
+                         double &d1, double &d2)
+{
+    Vector3d a = R * x1.normalized(), b = x2.normalized();
+    double ab = a.dot(b), at = a.dot(T), bt = b.dot(T);
+    double det = 1 - ab * ab;
+    if (det < 1e-12)
+        return false;
+    d1 = (ab * bt - at) / det;
+    d2 = (bt - ab * at) / det;
+    return true;
+}
+}
 
-        CV_Assert(cameraMatrix.rows == 3 && cameraMatrix.cols == 3 && cameraMatrix.channels() == 1);
+int MotionEstimator::solveFivePoint(const vector<pair<Vector3d, Vector3d>> &corres, const int sample[5], Matrix3d E[10])
+{
+    //Null space of the 5 epipolar constraints, E = x * N0 + y * N1 + z * N2 + N3
+    Matrix<double, 9, 5> At;
+    for (int k = 0; k < 5; k++)
+    {
+        const Vector3d &x1 = corres[sample[k]].first, &x2 = corres[sample[k]].second;
+        for (int i = 0; i < 3; i++)
+            At.block<3, 1>(3 * i, k) = x2(i) * x1;
+    }
+    HouseholderQR<Matrix<double, 9, 5>> qr(At);
+    Matrix<double, 9, 9> Q = qr.householderQ();
+    Matrix<double, 9, 4> N = Q.rightCols<4>();
 
-        if (points1.channels() > 1)
+    Poly e[3][3];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
         {
-            points1 = points1.reshape(1, npoints);
-            points2 = points2.reshape(1, npoints);
+            e[i][j] = Poly::Zero();
+            e[i][j](0) = N(3 * i + j, 3);
+            e[i][j].segment<3>(1) = N.block<1, 3>(3 * i + j, 0).transpose();
         }
 
-        double fx = cameraMatrix.at<double>(0,0);
-        double fy = cameraMatrix.at<double>(1,1);
-        double cx = cameraMatrix.at<double>(0,2);
-        double cy = cameraMatrix.at<double>(1,2);
-
-        points1.col(0) = (points1.col(0) - cx) / fx;
-        points2.col(0) = (points2.col(0) - cx) / fx;
-        points1.col(1) = (points1.col(1) - cy) / fy;
-        points2.col(1) = (points2.col(1) - cy) / fy;
-
-        points1 = points1.t();
-        points2 = points2.t();
-
-        Mat R1, R2, t;
-        decomposeEssentialMat(E, R1, R2, t);
-        Mat P0 = Mat::eye(3, 4, R1.type());
-        Mat P1(3, 4, R1.type()), P2(3, 4, R1.type()), P3(3, 4, R1.type()), P4(3, 4, R1.type());
-        P1(Range::all(), Range(0, 3)) = R1 * 1.0; P1.col(3) = t * 1.0;
-        P2(Range::all(), Range(0, 3)) = R2 * 1.0; P2.col(3) = t * 1.0;
-        P3(Range::all(), Range(0, 3)) = R1 * 1.0; P3.col(3) = -t * 1.0;
-        P4(Range::all(), Range(0, 3)) = R2 * 1.0; P4.col(3) = -t * 1.0;
-
-        // Do the cheirality check.
-        // Notice here a threshold dist is used to filter
-        // out far away points (i.e. infinite points) since
-        // there depth may vary between postive and negtive.
-        double dist = 50.0;
-        Mat Q;
-        triangulatePoints(P0, P1, points1, points2, Q);
-        Mat mask1 = Q.row(2).mul(Q.row(3)) > 0;
-        Q.row(0) /= Q.row(3);
-        Q.row(1) /= Q.row(3);
-        Q.row(2) /= Q.row(3);
-        Q.row(3) /= Q.row(3);
-        mask1 = (Q.row(2) < dist) & mask1;
-        Q = P1 * Q;
-        mask1 = (Q.row(2) > 0) & mask1;
-        mask1 = (Q.row(2) < dist) & mask1;
-
-        triangulatePoints(P0, P2, points1, points2, Q);
-        Mat mask2 = Q.row(2).mul(Q.row(3)) > 0;
-        Q.row(0) /= Q.row(3);
-        Q.row(1) /= Q.row(3);
-        Q.row(2) /= Q.row(3);
-        Q.row(3) /= Q.row(3);
-        mask2 = (Q.row(2) < dist) & mask2;
-        Q = P2 * Q;
-        mask2 = (Q.row(2) > 0) & mask2;
-        mask2 = (Q.row(2) < dist) & mask2;
-
-        triangulatePoints(P0, P3, points1, points2, Q);
-        Mat mask3 = Q.row(2).mul(Q.row(3)) > 0;
-        Q.row(0) /= Q.row(3);
-        Q.row(1) /= Q.row(3);
-        Q.row(2) /= Q.row(3);
-        Q.row(3) /= Q.row(3);
-        mask3 = (Q.row(2) < dist) & mask3;
-        Q = P3 * Q;
-        mask3 = (Q.row(2) > 0) & mask3;
-        mask3 = (Q.row(2) < dist) & mask3;
-
-        triangulatePoints(P0, P4, points1, points2, Q);
-        Mat mask4 = Q.row(2).mul(Q.row(3)) > 0;
-        Q.row(0) /= Q.row(3);
-        Q.row(1) /= Q.row(3);
-        Q.row(2) /= Q.row(3);
-        Q.row(3) /= Q.row(3);
-        mask4 = (Q.row(2) < dist) & mask4;
-        Q = P4 * Q;
-        mask4 = (Q.row(2) > 0) & mask4;
-        mask4 = (Q.row(2) < dist) & mask4;
-
-        mask1 = mask1.t();
-        mask2 = mask2.t();
-        mask3 = mask3.t();
-        mask4 = mask4.t();
-
-        // If _mask is given, then use it to filter outliers.
-        if (!_mask.empty())
-        {
-            Mat mask = _mask.getMat();
-            CV_Assert(mask.size() == mask1.size());
-            bitwise_and(mask, mask1, mask1);
-            bitwise_and(mask, mask2, mask2);
-            bitwise_and(mask, mask3, mask3);
-            bitwise_and(mask, mask4, mask4);
-        }
-        if (_mask.empty() && _mask.needed())
+    //det(E) = 0 and 2 E E^T E - trace(E E^T) E = 0
+    Matrix<double, 10, 20> M;
+    Poly det = mul(e[0][0], 1, mul(e[1][1], 1, e[2][2], 1) - mul(e[1][2], 1, e[2][1], 1), 2) -
+               mul(e[0][1], 1, mul(e[1][0], 1, e[2][2], 1) - mul(e[1][2], 1, e[2][0], 1), 2) +
+               mul(e[0][2], 1, mul(e[1][0], 1, e[2][1], 1) - mul(e[1][1], 1, e[2][0], 1), 2);
+    M.row(9) = det.transpose();
+
+    Poly eet[3][3];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            eet[i][j] = mul(e[i][0], 1, e[j][0], 1) + mul(e[i][1], 1, e[j][1], 1) + mul(e[i][2], 1, e[j][2], 1);
+    Poly trace = eet[0][0] + eet[1][1] + eet[2][2];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
         {
-            _mask.create(mask1.size(), CV_8U);
+            Poly c = -mul(trace, 2, e[i][j], 1);
+            for (int k = 0; k < 3; k++)
+                c += 2 * mul(eet[i][k], 2, e[k][j], 1);
+            M.row(3 * i + j) = c.transpose();
         }
 
-        CV_Assert(_R.needed() && _t.needed());
-        _R.create(3, 3, R1.type());
-        _t.create(3, 1, t.type());
-
-        int good1 = countNonZero(mask1);
-        int good2 = countNonZero(mask2);
-        int good3 = countNonZero(mask3);
-        int good4 = countNonZero(mask4);
+    //Eliminate the cubic monomials, the quotient ring basis is then all monomials up to degree 2
+    Matrix<double, 10, 10> R = M.rightCols<10>().partialPivLu().solve(M.leftCols<10>());
+    if (!R.allFinite())
+        return 0;
 
-        if (good1 >= good2 && good1 >= good3 && good1 >= good4)
-        {
-            R1.copyTo(_R);
-            t.copyTo(_t);
-            if (_mask.needed()) mask1.copyTo(_mask);
-            return good1;
-        }
-        else if (good2 >= good1 && good2 >= good3 && good2 >= good4)
-        {
-            R2.copyTo(_R);
-            t.copyTo(_t);
-            if (_mask.needed()) mask2.copyTo(_mask);
-            return good2;
-        }
-        else if (good3 >= good1 && good3 >= good2 && good3 >= good4)
-        {
-            t = -t;
-            R1.copyTo(_R);
-            t.copyTo(_t);
-            if (_mask.needed()) mask3.copyTo(_mask);
-            return good3;
-        }
+    //Action matrix of multiplication by x, its eigenvectors are the basis evaluated at the solutions
+    const MonomialTable &table = monomials();
+    Matrix<double, 10, 10> action = Matrix<double, 10, 10>::Zero();
+    for (int r = 0; r < 10; r++)
+    {
+        int k = table.product[1][r];
+        if (k < 10)
+            action(r, k) = 1;
         else
-        {
-            t = -t;
-            R2.copyTo(_R);
-            t.copyTo(_t);
-            if (_mask.needed()) mask4.copyTo(_mask);
-            return good4;
-        }
+            action.row(r) = -R.row(k - 10);
     }
+    EigenSolver<Matrix<double, 10, 10>> es(action);
+    if (es.info() != Success)
+        return 0;
 
-    int recoverPose( InputArray E, InputArray _points1, InputArray _points2, OutputArray _R,
-                         OutputArray _t, double focal, Point2d pp, InputOutputArray _mask)
+    int n = 0;
+    for (int i = 0; i < 10; i++)
     {
-        Mat cameraMatrix = (Mat_<double>(3,3) << focal, 0, pp.x, 0, focal, pp.y, 0, 0, 1);
-        return cv::recoverPose(E, _points1, _points2, cameraMatrix, _R, _t, _mask);
+        if (fabs(es.eigenvalues()(i).imag()) > 1e-8 * max(1.0, fabs(es.eigenvalues()(i).real())))
+            continue;
+        Matrix<double, 10, 1> v = es.eigenvectors().col(i).real();
+        if (fabs(v(0)) < 1e-12)
+            continue;
+        Matrix<double, 9, 1> e_vec = N * Vector4d(v(1) / v(0), v(2) / v(0), v(3) / v(0), 1);
+        E[n++] = Map<Matrix<double, 3, 3, RowMajor>>(e_vec.data()).normalized();
     }
+    return n;
 }
 
+double MotionEstimator::epipolarError(const Matrix3d &E, const Vector3d &x1, const Vector3d &x2)
+{
+    Vector3d l2 = E * x1, l1 = E.transpose() * x2;
+    double r = fabs(x2.dot(l2));
+    double n1 = l1.norm() * x1.norm(), n2 = l2.norm() * x2.norm();
+    if (n1 < 1e-12 || n2 < 1e-12)
+        return M_PI;
+    return r / min(n1, n2);
+}
+
+void MotionEstimator::updateSPRT(double inlier_ratio)
+{
+    //Chum and Matas, optimal randomized RANSAC: a hypothesis costs about 200
+    //point checks and yields 4 models on average
+    const double t_M = 200, m_S = 4;
+    sprt_epsilon = max(sprt_epsilon, inlier_ratio);
+    double C = (1 - sprt_delta) * log((1 - sprt_delta) / (1 - sprt_epsilon)) + sprt_delta * log(sprt_delta / sprt_epsilon);
+    double A0 = t_M * C / m_S + 1;
+    sprt_A = A0;
+    for (int i = 0; i < 10; i++)
+        sprt_A = A0 + log(sprt_A);
+}
+
+int MotionEstimator::verify(const vector<pair<Vector3d, Vector3d>> &corres, const Matrix3d &E, double threshold,
+                            vector<unsigned char> &_mask)
+{
+    double lambda = 1;
+    int inliers = 0;
+    for (int i = 0; i < (int)corres.size(); i++)
+    {
+        _mask[i] = epipolarError(E, corres[i].first, corres[i].second) < threshold;
+        inliers += _mask[i];
+        lambda *= _mask[i] ? sprt_delta / sprt_epsilon : (1 - sprt_delta) / (1 - sprt_epsilon);
+        if (lambda > sprt_A)
+            return -1;
+    }
+    return inliers;
+}
+
+bool MotionEstimator::refine(const vector<pair<Vector3d, Vector3d>> &corres, const vector<unsigned char> &_mask, Matrix3d &E)
+{
+    Matrix<double, 9, 9> AtA = Matrix<double, 9, 9>::Zero();
+    int n = 0;
+    for (int i = 0; i < (int)corres.size(); i++)
+    {
+        if (!_mask[i])
+            continue;
+        Vector3d x1 = corres[i].first.normalized(), x2 = corres[i].second.normalized();
+        Matrix<double, 9, 1> a;
+        for (int j = 0; j < 3; j++)
+            a.segment<3>(3 * j) = x2(j) * x1;
+        AtA.selfadjointView<Lower>().rankUpdate(a);
+        n++;
+    }
+    if (n < 8)
+        return false;
+
+    SelfAdjointEigenSolver<Matrix<double, 9, 9>> es(AtA.selfadjointView<Lower>());
+    Matrix<double, 9, 1> e_vec = es.eigenvectors().col(0);
+    Matrix3d F = Map<Matrix<double, 3, 3, RowMajor>>(e_vec.data());
+    JacobiSVD<Matrix3d> svd(F, ComputeFullU | ComputeFullV);
+    E = svd.matrixU() * Vector3d(1, 1, 0).asDiagonal() * svd.matrixV().transpose();
+    E.normalize();
+    return true;
+}
+
+int MotionEstimator::recoverPose(const vector<pair<Vector3d, Vector3d>> &corres, const Matrix3d &E,
+                                 const vector<unsigned char> &_mask, Matrix3d &R, Vector3d &T)
+{
+    JacobiSVD<Matrix3d> svd(E, ComputeFullU | ComputeFullV);
+    Matrix3d U = svd.matrixU(), V = svd.matrixV();
+    if (U.determinant() < 0)
+        U = -U;
+    if (V.determinant() < 0)
+        V = -V;
+    Matrix3d W;
+    W << 0, -1, 0, 1, 0, 0, 0, 0, 1;
+
+    Matrix3d Rs[4] = {U * W * V.transpose(), U * W.transpose() * V.transpose(),
+                      U * W * V.transpose(), U * W.transpose() * V.transpose()};
+    Vector3d Ts[4] = {U.col(2), U.col(2), -U.col(2), -U.col(2)};
+
+    //Points over 50 baselines away are too close to infinity to tell the sides apart
+    const double dist = 50.0;
+    int best = -1;
+    for (int k = 0; k < 4; k++)
+    {
+        int good = 0;
+        for (int i = 0; i < (int)corres.size(); i++)
+        {
+            double d1, d2;
+            if (_mask[i] && triangulateBearings(corres[i].first, corres[i].second, Rs[k], Ts[k], d1, d2) &&
+                d1 > 0 && d2 > 0 && d1 < dist && d2 < dist)
+                good++;
+        }
+        if (good > best)
+        {
+            best = good;
+            R = Rs[k];
+            T = Ts[k];
+        }
+    }
+    return best;
+}
 
 bool MotionEstimator::solveRelativeRT(const vector<pair<Vector3d, Vector3d>> &corres, Matrix3d &Rotation, Vector3d &Translation)
 {
     if (corres.size() >= 15)
     {
-        vector<cv::Point2f> ll, rr;
-        for (int i = 0; i < int(corres.size()); i++)
+        //0.3 pixel at 460 focal length, as an angle on the unit sphere
+        const double threshold = 0.3 / 460;
+        const double confidence = 0.99;
+        const int max_iterations = 1000;
+        int n = corres.size();
+        mask.resize(n);
+        best_mask.resize(n);
+
+        sprt_epsilon = 0.2;
+        sprt_delta = 0.05;
+        updateSPRT(0);
+
+        int best_inliers = 0, iterations = max_iterations, hypotheses = 0, rejected = 0;
+        Matrix3d best_E;
+        Matrix3d Es[10];
+        for (int it = 0; it < iterations; it++)
         {
-            ll.push_back(cv::Point2f(corres[i].first(0), corres[i].first(1)));
-            rr.push_back(cv::Point2f(corres[i].second(0), corres[i].second(1)));
+            int sample[5];
+            for (int k = 0; k < 5; k++)
+            {
+                bool unique;
+                do
+                {
+                    sample[k] = rng() % n;
+                    unique = true;
+                    for (int j = 0; j < k; j++)
+                        unique = unique && sample[j] != sample[k];
+                } while (!unique);
+            }
+
+            int solutions = solveFivePoint(corres, sample, Es);
+            for (int s = 0; s < solutions; s++)
+            {
+                hypotheses++;
+                int inliers = verify(corres, Es[s], threshold, mask);
+                if (inliers < 0)
+                {
+                    rejected++;
+                    continue;
+                }
+                if (inliers > best_inliers)
+                {
+                    best_inliers = inliers;
+                    best_E = Es[s];
+                    mask.swap(best_mask);
+                    double w = (double)inliers / n;
+                    updateSPRT(w);
+                    double p_fail = 1 - pow(w, 5);
+                    if (p_fail < 1e-12)
+                        iterations = 0;
+                    else
+                        iterations = min(max_iterations, (int)ceil(log(1 - confidence) / log(p_fail)));
+                }
+            }
         }
-        cv::Mat mask;
-        cv::Mat E = cv::findFundamentalMat(ll, rr, cv::FM_RANSAC, 0.3 / 460, 0.99, mask);
-        cv::Mat cameraMatrix = (cv::Mat_<double>(3, 3) << 1, 0, 0, 0, 1, 0, 0, 0, 1);
-        cv::Mat rot, trans;
-        int inlier_cnt = cv::recoverPose(E, ll, rr, cameraMatrix, rot, trans, mask);
-        //cout << "inlier_cnt " << inlier_cnt << endl;
+        ROS_DEBUG("5pt ransac %d hypotheses, %d rejected early, %d inliers", hypotheses, rejected, best_inliers);
+        if (best_inliers < 5)
+            return false;
 
-        Eigen::Matrix3d R;
-        Eigen::Vector3d T;
-        for (int i = 0; i < 3; i++)
-        {   
-            T(i) = trans.at<double>(i, 0);
-            for (int j = 0; j < 3; j++)
-                R(i, j) = rot.at<double>(i, j);
+        //Refit on all inliers, kept if it explains at least as many
+        Matrix3d E = best_E;
+        if (refine(corres, best_mask, E))
+        {
+            int inliers = 0;
+            for (int i = 0; i < n; i++)
+            {
+                mask[i] = epipolarError(E, corres[i].first, corres[i].second) < threshold;
+                inliers += mask[i];
+            }
+            if (inliers >= best_inliers)
+            {
+                best_inliers = inliers;
+                best_E = E;
+                mask.swap(best_mask);
+            }
         }
 
+        Matrix3d R;
+        Vector3d T;
+        int inlier_cnt = recoverPose(corres, best_E, best_mask, R, T);
+        //cout << "inlier_cnt " << inlier_cnt << endl;
+
         Rotation = R.transpose();
         Translation = -R.transpose() * T;
         if(inlier_cnt > 12)
@@ -236,6 +358,3 @@ bool MotionEstimator::solveRelativeRT(const vector<pair<Vector3d, Vector3d>> &co
     }
     return false;
 }
-
-
-
@@ -12,15 +12,18 @@
 #pragma once
 
 #include <vector>
+#include <random>
 using namespace std;
 
-#include <opencv2/opencv.hpp>
-//#include <opencv2/core/eigen.hpp>
 #include <eigen3/Eigen/Dense>
 using namespace Eigen;
 
 #include <ros/console.h>
 
+//Relative pose of two frames from unit bearing correspondences.
+//5-point RANSAC (Stewenius' Groebner basis solver) with SPRT early rejection of
+//bad hypotheses, so it works on fisheye bearings far off the optical axis too.
+//Buffers are kept between calls and nothing is allocated per hypothesis.
 class MotionEstimator
 {
   public:
@@ -28,12 +31,23 @@ class MotionEstimator
     bool solveRelativeRT(const vector<pair<Vector3d, Vector3d>> &corres, Matrix3d &R, Vector3d &T);
 
   private:
-    double testTriangulation(const vector<cv::Point2f> &l,
-                             const vector<cv::Point2f> &r,
-                             cv::Mat_<double> R, cv::Mat_<double> t);
-    void decomposeE(cv::Mat E,
-                    cv::Mat_<double> &R1, cv::Mat_<double> &R2,
-                    cv::Mat_<double> &t1, cv::Mat_<double> &t2);
+    //Essential matrices x2^T E x1 = 0 of 5 correspondences, returns their number (up to 10)
+    static int solveFivePoint(const vector<pair<Vector3d, Vector3d>> &corres, const int sample[5], Matrix3d E[10]);
+    //Angle between a bearing and the epipolar plane of its match, worse of both frames
+    static double epipolarError(const Matrix3d &E, const Vector3d &x1, const Vector3d &x2);
+    //Inliers of E into mask, or -1 once the SPRT rejects it
+    int verify(const vector<pair<Vector3d, Vector3d>> &corres, const Matrix3d &E, double threshold, vector<unsigned char> &_mask);
+    //Linear least squares E over the inliers, projected to an essential matrix
+    bool refine(const vector<pair<Vector3d, Vector3d>> &corres, const vector<unsigned char> &_mask, Matrix3d &E);
+    //Decomposition of E with most inliers triangulated in front of both frames
+    int recoverPose(const vector<pair<Vector3d, Vector3d>> &corres, const Matrix3d &E, const vector<unsigned char> &_mask,
+                    Matrix3d &R, Vector3d &T);
+    void updateSPRT(double inlier_ratio);
+
+    std::mt19937 rng{0};
+    vector<unsigned char> mask, best_mask;
+
+    //SPRT state: inlier ratio of good and bad models, likelihood ratio threshold
+    double sprt_epsilon, sprt_delta, sprt_A;
 };
 
-
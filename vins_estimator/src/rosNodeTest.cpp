@@ -166,7 +166,7 @@ void imu_callback(const sensor_msgs::ImuConstPtr &imu_msg)
 
 void feature_callback(const sensor_msgs::PointCloudConstPtr &feature_msg)
 {
-    FeatureFrame featureFrame;
+    map<int, FeatureFramenoId> features;
     for (unsigned int i = 0; i < feature_msg->points.size(); i++)
     {
         int feature_id = feature_msg->channels[0].values[i];
@@ -189,10 +189,11 @@ void feature_callback(const sensor_msgs::PointCloudConstPtr &feature_msg)
         ROS_ASSERT(z == 1);
         TrackFeatureNoId xyz_uv_velocity;
         xyz_uv_velocity << x, y, z, p_u, p_v, velocity_x, velocity_y, 0;
-        featureFrame[feature_id].emplace_back(camera_id,  xyz_uv_velocity);
+        features[feature_id].emplace_back(camera_id,  xyz_uv_velocity);
     }
+    FeatureFrame featureFrame(features.begin(), features.end());
     double t = feature_msg->header.stamp.toSec();
-    estimator.inputFeature(t, featureFrame);
+    estimator.inputFeature(t, std::move(featureFrame));
     return;
 }
 
@@ -207,8 +208,7 @@ void restart_callback(const std_msgs::BoolConstPtr &restart_msg)
         while(!imu_buf.empty())
             imu_buf.pop();
         m_buf.unlock();
-        estimator.clearState();
-        estimator.setParameter();
+        estimator.requestRestart();
     }
     return;
 }
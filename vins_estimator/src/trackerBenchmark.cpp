@@ -0,0 +1,158 @@
+/*******************************************************
+ * Tracker only benchmark on a KITTI style sequence folder:
+ * times.txt, image_0/%06d.png, image_1/%06d.png.
+ * For fisheye configs image_0/image_1 are the raw up/down fisheye images.
+ *
+ * Images are loaded and flattened before timing and the tracker runs without an
+ * estimator, so disk IO, flattening and featureBuf backpressure are excluded.
+ *******************************************************/
+
+#include <iostream>
+#include <stdio.h>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <ros/ros.h>
+#include "estimator/parameters.h"
+#include "featureTracker/feature_tracker_fisheye.hpp"
+#include "featureTracker/feature_tracker_pinhole.hpp"
+#include "utility/tic_toc.h"
+#include "utility/perf.h"
+#include "utility/latency_histogram.h"
+
+using namespace std;
+
+struct BenchFrame
+{
+    double t;
+    cv::Mat left, right;
+    vector<cv::Mat> up, down;
+};
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "tracker_benchmark");
+    ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn);
+
+    if(argc < 3)
+    {
+        printf("please intput: rosrun vins tracker_benchmark [config file] [data folder] [max frames] [warmup frames]\n"
+               "for example: rosrun vins tracker_benchmark "
+               "~/catkin_ws/src/VINS-Fisheye/config/kitti_odom/kitti_config00-02.yaml "
+               "/media/tony-ws1/disk_D/kitti/odometry/sequences/00/ 1000 20\n");
+        return 1;
+    }
+
+    string dataPath = string(argv[2]) + "/";
+    int max_frames = argc > 3 ? atoi(argv[3]) : 1000;
+    int warmup = argc > 4 ? atoi(argv[4]) : 20;
+
+    readParameters(argv[1]);
+    //Drawing publishes on ROS topics, not part of tracking
+    SHOW_TRACK = 0;
+
+    FeatureTracker::BaseFeatureTracker * tracker = nullptr;
+    if (FISHEYE) {
+        if (FISHEYE_DIRECT) {
+            tracker = new FeatureTracker::FisheyeFeatureTrackerDirect(nullptr);
+        } else {
+            tracker = new FeatureTracker::FisheyeFeatureTrackerOpenMP(nullptr);
+        }
+    } else {
+        tracker = new FeatureTracker::PinholeFeatureTrackerOpenMP(nullptr);
+    }
+    if (USE_GPU) {
+        ROS_WARN("tracker_benchmark runs the CPU trackers, use_gpu is ignored");
+    }
+    tracker->readIntrinsicParameter(CAM_NAMES);
+
+    FILE* file = std::fopen((dataPath + "times.txt").c_str() , "r");
+    if(file == NULL){
+        printf("cannot find file: %stimes.txt\n", dataPath.c_str());
+        return 1;
+    }
+    vector<double> imageTimeList;
+    double imageTime;
+    while (fscanf(file, "%lf", &imageTime) != EOF && (int)imageTimeList.size() < max_frames)
+    {
+        imageTimeList.push_back(imageTime);
+    }
+    std::fclose(file);
+
+    vector<BenchFrame> frames(imageTimeList.size());
+    for (size_t i = 0; i < imageTimeList.size(); i++)
+    {
+        stringstream ss;
+        ss << setfill('0') << setw(6) << i;
+        auto & f = frames[i];
+        f.t = imageTimeList[i];
+        if (FISHEYE && !FISHEYE_DIRECT) {
+            auto ft = (FeatureTracker::BaseFisheyeFeatureTracker<cv::Mat> *) tracker;
+            cv::Mat up = cv::imread(dataPath + "image_0/" + ss.str() + ".png", cv::IMREAD_COLOR);
+            cv::Mat down = cv::imread(dataPath + "image_1/" + ss.str() + ".png", cv::IMREAD_COLOR);
+            if (up.empty() || down.empty()) {
+                frames.resize(i);
+                break;
+            }
+            ft->get_fisheye_undist(0)->stereo_flatten(up, down, ft->get_fisheye_undist(1), f.up, f.down);
+        } else {
+            f.left = cv::imread(dataPath + "image_0/" + ss.str() + ".png", cv::IMREAD_GRAYSCALE);
+            f.right = cv::imread(dataPath + "image_1/" + ss.str() + ".png", cv::IMREAD_GRAYSCALE);
+            if (f.left.empty()) {
+                frames.resize(i);
+                break;
+            }
+        }
+    }
+    if ((int)frames.size() <= warmup) {
+        printf("only %ld frames loaded, need more than %d warmup frames\n", frames.size(), warmup);
+        return 1;
+    }
+    printf("loaded %ld frames from %s\n", frames.size(), dataPath.c_str());
+
+    LatencyHistogram track_hist;
+    vector<LatencyHistogram> stage_hists;
+    double sum_ms = 0;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        auto & f = frames[i];
+        if ((int)i == warmup) {
+            //Drop stage timings of the warmup frames
+            perf::collect(stage_hists);
+        }
+        TicToc t_track;
+        if (FISHEYE && !FISHEYE_DIRECT) {
+            tracker->trackImage(f.t, f.up, f.down);
+        } else {
+            tracker->trackImage(f.t, f.left, f.right);
+        }
+        double ms = t_track.toc();
+        if ((int)i >= warmup) {
+            track_hist.record(ms);
+            sum_ms += ms;
+        }
+    }
+    perf::collect(stage_hists);
+
+    int n = frames.size() - warmup;
+    printf("tracker: %d frames, %.2fms per frame, %.1f frames/sec\n", n, sum_ms / n, 1000.0 * n / sum_ms);
+    printf("%-12s %s\n", "track", track_hist.summary().c_str());
+    //Stages can run on several threads at once, the rest of the track time is bookkeeping
+    double stage_sum = 0;
+    for (int stage : {PERF_PYRAMID, PERF_LK, PERF_DETECT, PERF_UNDISTORT}) {
+        auto & h = stage_hists[stage];
+        if (h.count() == 0) {
+            continue;
+        }
+        printf("%-12s %s\n", perf::stage_name(stage), h.summary().c_str());
+        stage_sum += h.mean() * h.count() / n;
+    }
+    if (stage_sum > 0) {
+        printf("other        %.2fms per frame (%.1f%% of track)\n", sum_ms / n - stage_sum,
+            100.0 * (sum_ms / n - stage_sum) / (sum_ms / n));
+    }
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "latency_histogram.h"
+
+enum QueueDropPolicy
+{
+    QUEUE_BLOCK = 0,        //Producer waits for space: backpressure to the previous stage
+    QUEUE_DROP_OLDEST = 1,  //Oldest queued item is discarded
+    QUEUE_DROP_NEWEST = 2   //Incoming item is discarded
+};
+
+//Thread safe FIFO between two pipeline stages.
+//Time each item waits in the queue is recorded into a latency histogram.
+template<typename T>
+class BoundedQueue
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::deque<std::pair<T, Clock::time_point>> buf;
+    mutable std::mutex mtx;
+    std::condition_variable not_empty, not_full;
+
+    size_t capacity;
+    QueueDropPolicy policy;
+    bool stopped = false;
+    long dropped = 0;
+    LatencyHistogram wait_hist;
+
+  public:
+    BoundedQueue(size_t _capacity = 1, QueueDropPolicy _policy = QUEUE_BLOCK):
+        capacity(std::max<size_t>(_capacity, 1)), policy(_policy)
+    {}
+
+    void configure(size_t _capacity, QueueDropPolicy _policy)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        capacity = std::max<size_t>(_capacity, 1);
+        policy = _policy;
+    }
+
+    //Return false if this item is dropped
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (buf.size() >= capacity) {
+            if (policy == QUEUE_DROP_NEWEST) {
+                dropped ++;
+                return false;
+            } else if (policy == QUEUE_DROP_OLDEST) {
+                while (buf.size() >= capacity) {
+                    buf.pop_front();
+                    dropped ++;
+                }
+            } else {
+                not_full.wait(lock, [&] { return buf.size() < capacity || stopped; });
+                if (stopped) {
+                    return false;
+                }
+            }
+        }
+        buf.emplace_back(std::move(item), Clock::now());
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    //Wait at most timeout_ms for an item; return false on timeout or once stopped and drained
+    bool pop(T & item, double timeout_ms = 0)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!not_empty.wait_for(lock, std::chrono::duration<double, std::milli>(timeout_ms),
+                [&] { return !buf.empty() || stopped; }) || buf.empty()) {
+            return false;
+        }
+        item = std::move(buf.front().first);
+        wait_hist.record(std::chrono::duration<double, std::milli>(Clock::now() - buf.front().second).count());
+        buf.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return true;
+    }
+
+    //Release producers waiting on a full queue and consumers waiting on an empty one, e.g. on shutdown
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopped = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+    bool is_stopped() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return stopped;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        buf.clear();
+        not_full.notify_all();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return buf.size();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    long dropped_count() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return dropped;
+    }
+
+    LatencyHistogram wait_histogram() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return wait_hist;
+    }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+
+//Fixed size log-scale histogram of latencies in ms.
+//Bucket i covers [MIN_MS * 2^(i/4), MIN_MS * 2^((i+1)/4)), so percentiles are accurate to ~19%.
+class LatencyHistogram
+{
+  public:
+    static const int BUCKETS_PER_OCTAVE = 4;
+    static const int BUCKETS = 80;
+    static constexpr double MIN_MS = 0.05;
+
+    LatencyHistogram()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(counts, counts + BUCKETS, 0);
+        total = 0;
+        sum = 0;
+        max_ms = 0;
+    }
+
+    void record(double ms)
+    {
+        counts[bucket(ms)] ++;
+        total ++;
+        sum += ms;
+        max_ms = std::max(max_ms, ms);
+    }
+
+    //Add n samples of bucket i, used when buckets are counted outside this class
+    void record_bucket(int i, uint64_t n, double sum_ms, double max_sample)
+    {
+        counts[i] += n;
+        total += n;
+        sum += sum_ms;
+        max_ms = std::max(max_ms, max_sample);
+    }
+
+    void merge(const LatencyHistogram & other)
+    {
+        for (int i = 0; i < BUCKETS; i ++) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        max_ms = std::max(max_ms, other.max_ms);
+    }
+
+    //Upper bound of the bucket containing the p-th (0-1) sample
+    double percentile(double p) const
+    {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>(1, std::ceil(p * total));
+        uint64_t acc = 0;
+        for (int i = 0; i < BUCKETS; i ++) {
+            acc += counts[i];
+            if (acc >= rank) {
+                return std::min(max_ms, upper(i));
+            }
+        }
+        return max_ms;
+    }
+
+    uint64_t count() const
+    {
+        return total;
+    }
+
+    double mean() const
+    {
+        return total > 0 ? sum / total : 0;
+    }
+
+    double max() const
+    {
+        return max_ms;
+    }
+
+    std::string summary() const
+    {
+        char buf[128] = {0};
+        snprintf(buf, sizeof(buf), "n %lu avg %.2fms p50 %.2fms p95 %.2fms p99 %.2fms max %.2fms",
+            (unsigned long) total, mean(), percentile(0.5), percentile(0.95), percentile(0.99), max_ms);
+        return std::string(buf);
+    }
+
+    static int bucket(double ms)
+    {
+        if (ms <= MIN_MS) {
+            return 0;
+        }
+        int i = std::log2(ms / MIN_MS) * BUCKETS_PER_OCTAVE;
+        return std::min(std::max(i, 0), BUCKETS - 1);
+    }
+
+  private:
+    static double upper(int i)
+    {
+        return MIN_MS * std::pow(2.0, (double)(i + 1) / BUCKETS_PER_OCTAVE);
+    }
+
+    uint64_t counts[BUCKETS];
+    uint64_t total;
+    double sum;
+    double max_ms;
+};
@@ -0,0 +1,124 @@
+#include "perf.h"
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cmath>
+
+namespace perf {
+
+static const char * STAGE_NAMES[PERF_STAGE_NUM] = {
+    "flatten", "pyramid", "lk", "detect", "undistort", "track",
+    "add_feature", "triangulate", "solve", "motion_only", "marginalize", "slide", "estimate",
+    "depth", "publish"
+};
+
+const char * stage_name(int stage)
+{
+    if (stage < 0 || stage >= PERF_STAGE_NUM) {
+        return "unknown";
+    }
+    return STAGE_NAMES[stage];
+}
+
+void write_csv(std::ostream & os, double t, const std::vector<LatencyHistogram> & hists, bool with_header)
+{
+    if (with_header) {
+        os << "t,stage,count,mean,p50,p95,p99,max" << std::endl;
+    }
+    for (size_t i = 0; i < hists.size(); i ++) {
+        auto & h = hists[i];
+        if (h.count() == 0) {
+            continue;
+        }
+        os << std::fixed << t << "," << stage_name(i) << "," << h.count() << "," << h.mean() << "," 
+            << h.percentile(0.5) << "," << h.percentile(0.95) << "," << h.percentile(0.99) << "," << h.max() << std::endl;
+    }
+}
+
+#ifdef WITH_PERF_STATS
+
+//Written only by its owner thread, so plain load/store on the atomics is enough.
+//The collector reads them concurrently and keeps the previous snapshot to compute the window.
+struct ThreadStats
+{
+    std::atomic<uint64_t> counts[PERF_STAGE_NUM][LatencyHistogram::BUCKETS];
+    std::atomic<double> sum[PERF_STAGE_NUM];
+    std::atomic<double> max[PERF_STAGE_NUM];
+
+    uint64_t last_counts[PERF_STAGE_NUM][LatencyHistogram::BUCKETS];
+    double last_sum[PERF_STAGE_NUM];
+
+    ThreadStats()
+    {
+        for (int i = 0; i < PERF_STAGE_NUM; i ++) {
+            for (int j = 0; j < LatencyHistogram::BUCKETS; j ++) {
+                counts[i][j].store(0, std::memory_order_relaxed);
+                last_counts[i][j] = 0;
+            }
+            sum[i].store(0, std::memory_order_relaxed);
+            max[i].store(0, std::memory_order_relaxed);
+            last_sum[i] = 0;
+        }
+    }
+};
+
+static std::mutex registry_mtx;
+static std::vector<std::shared_ptr<ThreadStats>> registry;
+
+static ThreadStats * local_stats()
+{
+    //Registration takes the lock once per thread
+    thread_local ThreadStats * stats = nullptr;
+    if (stats == nullptr) {
+        auto ptr = std::make_shared<ThreadStats>();
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        registry.push_back(ptr);
+        stats = ptr.get();
+    }
+    return stats;
+}
+
+void record(PerfStage stage, double ms)
+{
+    ThreadStats * stats = local_stats();
+    auto & cnt = stats->counts[stage][LatencyHistogram::bucket(ms)];
+    cnt.store(cnt.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    stats->sum[stage].store(stats->sum[stage].load(std::memory_order_relaxed) + ms, std::memory_order_relaxed);
+    //May lose a max that races with the collector reset, acceptable for statistics
+    if (ms > stats->max[stage].load(std::memory_order_relaxed)) {
+        stats->max[stage].store(ms, std::memory_order_relaxed);
+    }
+}
+
+void collect(std::vector<LatencyHistogram> & hists)
+{
+    hists.assign(PERF_STAGE_NUM, LatencyHistogram());
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    for (auto & stats : registry) {
+        for (int i = 0; i < PERF_STAGE_NUM; i ++) {
+            double sum = stats->sum[i].load(std::memory_order_relaxed);
+            double max = stats->max[i].exchange(0, std::memory_order_relaxed);
+            int top = -1;
+            for (int j = 0; j < LatencyHistogram::BUCKETS; j ++) {
+                uint64_t cnt = stats->counts[i][j].load(std::memory_order_relaxed);
+                uint64_t n = cnt - stats->last_counts[i][j];
+                if (n == 0) {
+                    continue;
+                }
+                stats->last_counts[i][j] = cnt;
+                //Sum and max are added with the first non empty bucket
+                hists[i].record_bucket(j, n, top < 0 ? sum - stats->last_sum[i] : 0, top < 0 ? max : 0);
+                top = j;
+            }
+            if (top >= 0) {
+                //Lower bound of the highest bucket in case the max was lost
+                hists[i].record_bucket(top, 0, 0, LatencyHistogram::MIN_MS * std::pow(2.0, (double) top / LatencyHistogram::BUCKETS_PER_OCTAVE));
+            }
+            stats->last_sum[i] = sum;
+        }
+    }
+}
+
+#endif
+
+}
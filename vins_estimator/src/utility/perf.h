@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <ostream>
+#include "latency_histogram.h"
+
+//Stages timed on the hot path
+enum PerfStage
+{
+    PERF_FLATTEN = 0,
+    PERF_PYRAMID,
+    PERF_LK,
+    PERF_DETECT,
+    PERF_UNDISTORT,
+    PERF_TRACK,
+    PERF_ADD_FEATURE,
+    PERF_TRIANGULATE,
+    PERF_SOLVE,
+    PERF_MOTION_ONLY,
+    PERF_MARGINALIZE,
+    PERF_SLIDE,
+    PERF_ESTIMATE,
+    PERF_DEPTH,
+    PERF_PUBLISH,
+    PERF_STAGE_NUM
+};
+
+//Stage timers are aggregated per thread without locks and collected periodically.
+//Everything compiles out unless built with WITH_PERF_STATS.
+namespace perf {
+
+const char * stage_name(int stage);
+
+//Write one row per stage with samples: t,stage,count,mean,p50,p95,p99,max
+void write_csv(std::ostream & os, double t, const std::vector<LatencyHistogram> & hists, bool with_header);
+
+#ifdef WITH_PERF_STATS
+
+void record(PerfStage stage, double ms);
+
+//Histograms of all threads since the last collect, indexed by PerfStage
+void collect(std::vector<LatencyHistogram> & hists);
+
+class ScopedTimer
+{
+    typedef std::chrono::steady_clock Clock;
+    PerfStage stage;
+    Clock::time_point start;
+
+  public:
+    ScopedTimer(PerfStage _stage):
+        stage(_stage), start(Clock::now())
+    {}
+
+    ~ScopedTimer()
+    {
+        record(stage, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+};
+
+#define PERF_CONCAT_IMPL(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_IMPL(a, b)
+#define PERF_SCOPE(stage) perf::ScopedTimer PERF_CONCAT(perf_timer_, __LINE__)(stage)
+#define PERF_RECORD(stage, ms) perf::record(stage, ms)
+
+#else
+
+inline void collect(std::vector<LatencyHistogram> & hists)
+{
+    hists.assign(PERF_STAGE_NUM, LatencyHistogram());
+}
+
+#define PERF_SCOPE(stage)
+#define PERF_RECORD(stage, ms)
+
+#endif
+
+}
@@ -11,6 +11,9 @@
 #include <vins/VIOKeyframe.h>
 #include <sensor_msgs/PointCloud.h>
 #include <vins/FlattenImages.h>
+#include <vins/SolverBudget.h>
+#include <vins/PerfStats.h>
+#include "perf.h"
 #include "cv_bridge/cv_bridge.h"
 #include "../utility/ros_utility.h"
 
@@ -33,6 +36,8 @@ ros::Publisher pub_extrinsic;
 ros::Publisher pub_viokeyframe;
 ros::Publisher pub_viononkeyframe;
 ros::Publisher pub_bias;
+ros::Publisher pub_solver_budget;
+ros::Publisher pub_perf_stats;
 
 CameraPoseVisualization cameraposevisual(1, 0, 0, 1);
 static double sum_of_path = 0;
@@ -60,6 +65,8 @@ void registerPub(ros::NodeHandle &n)
     pub_viononkeyframe = n.advertise<vins::VIOKeyframe>("viononkeyframe", 1000);
     pub_flatten_images = n.advertise<vins::FlattenImages>("flatten_images", 1000);
     pub_bias = n.advertise<sensor_msgs::Imu>("imu_bias", 1000);
+    pub_solver_budget = n.advertise<vins::SolverBudget>("solver_budget", 1000);
+    pub_perf_stats = n.advertise<vins::PerfStats>("perf_stats", 10);
 
     cameraposevisual.setScale(0.1);
     cameraposevisual.setLineWidth(0.01);
@@ -80,6 +87,43 @@ void pubIMUBias(const Eigen::Vector3d &Ba, const Eigen::Vector3d Bg, const std_m
     pub_bias.publish(bias);
 }
 
+void pubSolverBudget(const Estimator &estimator, const std_msgs::Header &header) {
+    const SolverBudget & sb = estimator.solver_budget;
+    vins::SolverBudget msg;
+    msg.header = header;
+    msg.period = sb.period_ms;
+    msg.target = sb.target_ms;
+    msg.budget = sb.budget_ms;
+    msg.margin_old = sb.budget_margin_old;
+    msg.iterations = sb.last_iterations;
+    msg.prepare = sb.average.prepare;
+    msg.solve = sb.average.solve;
+    msg.marginalize = sb.average.marginalize;
+    msg.slide = sb.average.slide;
+    msg.other = sb.average.other;
+    msg.total = sb.average.total;
+    pub_solver_budget.publish(msg);
+}
+
+void pubPerfStats(const std::vector<LatencyHistogram> & hists, const std_msgs::Header &header) {
+    vins::PerfStats msg;
+    msg.header = header;
+    for (size_t i = 0; i < hists.size(); i ++) {
+        auto & h = hists[i];
+        if (h.count() == 0) {
+            continue;
+        }
+        msg.stage.push_back(perf::stage_name(i));
+        msg.count.push_back(h.count());
+        msg.mean.push_back(h.mean());
+        msg.p50.push_back(h.percentile(0.5));
+        msg.p95.push_back(h.percentile(0.95));
+        msg.p99.push_back(h.percentile(0.99));
+        msg.max.push_back(h.max());
+    }
+    pub_perf_stats.publish(msg);
+}
+
 void pubLatestOdometry(const Eigen::Vector3d &P, const Eigen::Quaterniond &Q, const Eigen::Vector3d &V, double t)
 {
     nav_msgs::Odometry odometry;
@@ -46,6 +46,10 @@ void pubLatestOdometry(const Eigen::Vector3d &P, const Eigen::Quaterniond &Q, co
 
 void pubIMUBias(const Eigen::Vector3d &Ba, const Eigen::Vector3d Bg, const std_msgs::Header &header);
 
+void pubSolverBudget(const Estimator &estimator, const std_msgs::Header &header);
+
+void pubPerfStats(const std::vector<LatencyHistogram> & hists, const std_msgs::Header &header);
+
 void printStatistics(const Estimator &estimator, double t);
 
 void pubOdometry(const Estimator &estimator, const std_msgs::Header &header);
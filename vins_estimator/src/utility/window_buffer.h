@@ -0,0 +1,45 @@
+#pragma once
+
+#include <eigen3/Eigen/Dense>
+#include "../estimator/parameters.h"
+
+//Fixed size circular buffer of sliding window slots, indexed by logical slot.
+//Logical slot i lives in physical slot (head + i) % N, so dropping the oldest
+//slot only moves head and never copies the other slots.
+template<class T, int N>
+class WindowBuffer
+{
+  public:
+    T & operator[](int i)
+    {
+        return slots[physical(i)];
+    }
+
+    const T & operator[](int i) const
+    {
+        return slots[physical(i)];
+    }
+
+    //Logical slot 0 becomes slot N - 1, every other slot moves one forward
+    void rotate()
+    {
+        head = (head + 1) % N;
+    }
+
+    void reset()
+    {
+        head = 0;
+    }
+
+  private:
+    int physical(int i) const
+    {
+        return (head + i) % N;
+    }
+
+    T slots[N]{};
+    int head = 0;
+};
+
+typedef WindowBuffer<Eigen::Vector3d, WINDOW_SIZE + 1> WindowVector3d;
+typedef WindowBuffer<Eigen::Matrix3d, WINDOW_SIZE + 1> WindowMatrix3d;
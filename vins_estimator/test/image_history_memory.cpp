@@ -0,0 +1,136 @@
+/*******************************************************
+ * RSS growth of the image frame history after initialization, old vs new bookkeeping.
+ *
+ * Replays what processIMU, processImage and slideWindow do with all_image_frame and
+ * tmp_pre_integration once solver_flag is NON_LINEAR, with the real IntegrationBase and
+ * FeatureFrame types, and prints the VmRSS growth.
+ *   old: every frame is inserted with tmp_pre_integration, MARGIN_OLD erases the frames
+ *        before t_0 but only deletes the preintegration of t_0
+ *   new: no history after initialization, only the window preintegrations (user-048)
+ *
+ * Model: 10 Hz backend frames, 20 IMU samples per frame, 150 features seen by both
+ * cameras, MARGIN_OLD on a random half of the frames.
+ *
+ * rosrun vins image_history_memory old 36000
+ * rosrun vins image_history_memory new 36000
+ *******************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include "../src/factor/integration_base.h"
+#include "../src/featureTracker/feature_frame.h"
+
+static const int IMU_PER_FRAME = 20;
+static const int FEATURES = 150;
+
+//Same members as ImageFrame in initial/initial_alignment.h, which pulls in the tracker headers
+class ImageFrame
+{
+  public:
+    ImageFrame(const FeatureFrame &_points, double _t): points(_points), t(_t), is_key_frame(false) {}
+    FeatureFrame points;
+    double t;
+    Matrix3d R;
+    Vector3d T;
+    IntegrationBase *pre_integration = nullptr;
+    bool is_key_frame;
+};
+
+static long rssKb()
+{
+    std::ifstream f("/proc/self/status");
+    std::string key;
+    long value;
+    while (f >> key)
+    {
+        if (key == "VmRSS:")
+        {
+            f >> value;
+            return value;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printf("usage: image_history_memory [old|new] [frames]\n");
+        return 1;
+    }
+    bool old_code = std::string(argv[1]) == "old";
+    int frames = atoi(argv[2]);
+
+    std::mt19937 rng(0);
+    Vector3d zero = Vector3d::Zero(), g(0, 0, 9.8);
+    map<double, ImageFrame> all_image_frame;
+    IntegrationBase *tmp_pre_integration = new IntegrationBase(g, zero, zero, zero);
+    //Window headers and preintegrations, the same in both versions
+    std::deque<double> headers;
+    std::deque<IntegrationBase *> pre_integrations;
+
+    FeatureFrame image;
+    for (int i = 0; i < FEATURES; i++)
+    {
+        TrackFeatureNoId pt = TrackFeatureNoId::Random();
+        image.emplace_back(i, FeatureFramenoId());
+        image.back().second.emplace_back(0, pt);
+        image.back().second.emplace_back(1, pt);
+    }
+
+    long rss0 = rssKb();
+    for (int k = 0; k < frames; k++)
+    {
+        double header = k * 0.1;
+        IntegrationBase *pre_integration = new IntegrationBase(g, zero, zero, zero);
+        for (int j = 0; j < IMU_PER_FRAME; j++)
+        {
+            Vector3d acc = g + Vector3d::Random() * 0.1, gyr = Vector3d::Random() * 0.01;
+            pre_integration->push_back(0.005, acc, gyr);
+            if (old_code)
+                tmp_pre_integration->push_back(0.005, acc, gyr);
+        }
+        if (old_code)
+        {
+            ImageFrame imageframe(image, header);
+            imageframe.pre_integration = tmp_pre_integration;
+            all_image_frame.insert(make_pair(header, imageframe));
+            tmp_pre_integration = new IntegrationBase(g, zero, zero, zero);
+        }
+        headers.push_back(header);
+        pre_integrations.push_back(pre_integration);
+
+        if ((int)headers.size() <= WINDOW_SIZE + 1)
+            continue;
+        if (rng() % 2 == 0)
+        {
+            //MARGIN_OLD
+            double t_0 = headers.front();
+            if (old_code)
+            {
+                auto it_0 = all_image_frame.find(t_0);
+                delete it_0->second.pre_integration;
+                all_image_frame.erase(all_image_frame.begin(), it_0);
+            }
+            headers.pop_front();
+            delete pre_integrations.front();
+            pre_integrations.pop_front();
+        }
+        else
+        {
+            //MARGIN_SECOND_NEW
+            headers.erase(headers.end() - 2);
+            delete *(pre_integrations.end() - 2);
+            pre_integrations.erase(pre_integrations.end() - 2);
+        }
+    }
+    printf("%s: %d frames, all_image_frame %zu, rss growth %.1f MB\n", old_code ? "old" : "new",
+        frames, all_image_frame.size(), (rssKb() - rss0) / 1024.0);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include "../src/featureTracker/feature_id_table.h"
+
+//Ids sharing a slot must both stay reachable, a long lived track next to an id 1<<15 newer.
+
+using FeatureTracker::FeatureIdTable;
+
+TEST(FeatureIdTable, CollidingIdsKeepBothValues)
+{
+    FeatureIdTable<int> table;
+    const int old_id = 17;
+    const int new_id = old_id + (1 << 15);
+    table.set(old_id, 1);
+    table.set(new_id, 2);
+    ASSERT_NE(table.find(old_id), nullptr);
+    ASSERT_NE(table.find(new_id), nullptr);
+    EXPECT_EQ(*table.find(old_id), 1);
+    EXPECT_EQ(*table.find(new_id), 2);
+    EXPECT_EQ(table.size(), 2);
+
+    //Overwriting either id keeps one entry each
+    table.set(new_id, 3);
+    table.set(old_id, 4);
+    EXPECT_EQ(*table.find(old_id), 4);
+    EXPECT_EQ(*table.find(new_id), 3);
+    EXPECT_EQ(table.size(), 2);
+    EXPECT_FALSE(table.contains(old_id + (2 << 15)));
+}
+
+TEST(FeatureIdTable, ClearDropsAllIds)
+{
+    FeatureIdTable<int> table;
+    table.set(5, 1);
+    table.set(5 + (1 << 15), 2);
+    table.clear();
+    EXPECT_FALSE(table.contains(5));
+    EXPECT_FALSE(table.contains(5 + (1 << 15)));
+    EXPECT_EQ(table.size(), 0);
+    table.set(5 + (1 << 15), 3);
+    EXPECT_FALSE(table.contains(5));
+    EXPECT_EQ(*table.find(5 + (1 << 15)), 3);
+}
+
+TEST(FeatureIdTable, GrowsWhenHalfFull)
+{
+    FeatureIdTable<int> table(4);
+    for (int i = 0; i < 100; i++) {
+        table.set(i * 16, i);
+    }
+    EXPECT_GE(table.capacity(), 200);
+    for (int i = 0; i < 100; i++) {
+        ASSERT_NE(table.find(i * 16), nullptr);
+        EXPECT_EQ(*table.find(i * 16), i);
+    }
+    EXPECT_FALSE(table.contains(100 * 16));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
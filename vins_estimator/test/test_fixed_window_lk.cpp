@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <opencv2/video/tracking.hpp>
+#include "../src/featureTracker/fixed_window_lk.hpp"
+
+//Accuracy and per point cost of FixedWindowLK against cv::calcOpticalFlowPyrLK on a
+//textured image moved by a known subpixel shift, with the tracker's window and pyramid.
+
+typedef FeatureTracker::FixedWindowLK<21, 3> LK;
+
+static const cv::Size WIN_SIZE(21, 21);
+static const int PYR_LEVEL = 3;
+static const cv::Point2f FLOW(4.3f, -2.6f);
+
+class FixedWindowLKTest : public ::testing::Test
+{
+  protected:
+    cv::Mat img0, img1;
+    std::vector<cv::Mat> prev_pyr, cur_pyr;
+    std::vector<cv::Point2f> pts;
+
+    void SetUp() override
+    {
+        cv::Mat noise(480, 640, CV_8UC1);
+        cv::RNG rng(1);
+        rng.fill(noise, cv::RNG::UNIFORM, 0, 256);
+        cv::GaussianBlur(noise, img0, cv::Size(0, 0), 2.0);
+        cv::normalize(img0, img0, 0, 255, cv::NORM_MINMAX);
+        cv::Mat M = (cv::Mat_<double>(2, 3) << 1, 0, FLOW.x, 0, 1, FLOW.y);
+        cv::warpAffine(img0, img1, M, img0.size(), cv::INTER_LINEAR, cv::BORDER_REFLECT);
+
+        cv::buildOpticalFlowPyramid(img0, prev_pyr, WIN_SIZE, PYR_LEVEL, true);
+        cv::buildOpticalFlowPyramid(img1, cur_pyr, WIN_SIZE, PYR_LEVEL, true);
+        cv::goodFeaturesToTrack(img0, pts, 500, 0.01, 10);
+        ASSERT_GT(pts.size(), 100u);
+    }
+};
+
+TEST_F(FixedWindowLKTest, MatchesOpenCV)
+{
+    std::vector<cv::Point2f> cv_pts, lk_pts;
+    std::vector<unsigned char> cv_status, lk_status;
+    std::vector<float> err;
+    cv::TermCriteria criteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 30, 0.01);
+
+    const int reps = 20;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; i++)
+        cv::calcOpticalFlowPyrLK(prev_pyr, cur_pyr, pts, cv_pts, cv_status, err, WIN_SIZE, PYR_LEVEL, criteria);
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; i++)
+        ASSERT_TRUE(LK::calc(prev_pyr, cur_pyr, pts, lk_pts, lk_status, 30, 0.01, false));
+    auto t2 = std::chrono::steady_clock::now();
+
+    double cv_us = std::chrono::duration<double, std::micro>(t1 - t0).count() / (reps * pts.size());
+    double lk_us = std::chrono::duration<double, std::micro>(t2 - t1).count() / (reps * pts.size());
+
+    int both = 0, status_diff = 0;
+    double max_diff = 0, cv_err = 0, lk_err = 0;
+    for (size_t i = 0; i < pts.size(); i++)
+    {
+        status_diff += cv_status[i] != lk_status[i];
+        if (!cv_status[i] || !lk_status[i])
+            continue;
+        both++;
+        cv::Point2f truth = pts[i] + FLOW;
+        max_diff = std::max(max_diff, (double)cv::norm(cv_pts[i] - lk_pts[i]));
+        cv_err += cv::norm(cv_pts[i] - truth);
+        lk_err += cv::norm(lk_pts[i] - truth);
+    }
+    cv_err /= both;
+    lk_err /= both;
+
+    std::cout << "[FixedWindowLK] points " << pts.size() << " status mismatch " << status_diff
+              << " max diff to OpenCV " << max_diff << "px"
+              << " mean error OpenCV " << cv_err << "px fixed " << lk_err << "px"
+              << " cost OpenCV " << cv_us << "us/pt fixed " << lk_us << "us/pt" << std::endl;
+    RecordProperty("opencv_us_per_point", std::to_string(cv_us));
+    RecordProperty("fixed_us_per_point", std::to_string(lk_us));
+
+    EXPECT_LE(status_diff, (int)pts.size() / 100);
+    EXPECT_LT(max_diff, 0.05);
+    EXPECT_LT(lk_err, cv_err + 0.01);
+}
+
+TEST_F(FixedWindowLKTest, ForwardBackwardConsistent)
+{
+    std::vector<cv::Point2f> fwd, bwd;
+    std::vector<unsigned char> st_fwd, st_bwd;
+    ASSERT_TRUE(LK::calc(prev_pyr, cur_pyr, pts, fwd, st_fwd, 30, 0.01, false));
+    //Reverse check as in the tracker, seeded with the original points
+    bwd = pts;
+    ASSERT_TRUE(LK::calc(cur_pyr, prev_pyr, fwd, bwd, st_bwd, 30, 0.01, true));
+
+    int ok = 0;
+    double max_err = 0;
+    for (size_t i = 0; i < pts.size(); i++)
+    {
+        if (!st_fwd[i] || !st_bwd[i])
+            continue;
+        ok++;
+        max_err = std::max(max_err, (double)cv::norm(bwd[i] - pts[i]));
+    }
+    EXPECT_GT(ok, (int)pts.size() * 9 / 10);
+    EXPECT_LT(max_err, 0.1);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
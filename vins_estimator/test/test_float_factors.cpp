@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <type_traits>
+#include "../src/factor/projectionTwoFrameOneCamFactor.h"
+#include "../src/factor/projectionTwoFrameTwoCamFactor.h"
+#include "../src/factor/projectionOneFrameTwoCamFactor.h"
+
+//Float evaluation of the projection factors against double, with the poses 300 m from the origin.
+//The test target is built with WITH_FLOAT_FACTORS, Evaluate() must match evaluate<FactorScalar>().
+
+static const double FOCAL = 460.0;
+
+//Residual and jacobian buffers of one evaluation, sized from the factor
+struct Evaluation
+{
+    std::vector<double> residuals;
+    std::vector<std::vector<double>> jacobians;
+    std::vector<double *> jacobian_ptrs;
+
+    Evaluation(const ceres::CostFunction & f):
+        residuals(f.num_residuals())
+    {
+        for (int size : f.parameter_block_sizes()) {
+            jacobians.emplace_back(f.num_residuals() * size, 0.0);
+        }
+        for (auto & j : jacobians) {
+            jacobian_ptrs.push_back(j.data());
+        }
+    }
+
+    double max_abs() const
+    {
+        double m = 0;
+        for (double r : residuals)
+            m = std::max(m, std::fabs(r));
+        for (auto & j : jacobians)
+            for (double v : j)
+                m = std::max(m, std::fabs(v));
+        return m;
+    }
+};
+
+//Largest difference of residuals and jacobians, relative to the largest entry of a
+static double max_relative_diff(const Evaluation & a, const Evaluation & b)
+{
+    double d = 0;
+    for (size_t i = 0; i < a.residuals.size(); i++)
+        d = std::max(d, std::fabs(a.residuals[i] - b.residuals[i]));
+    for (size_t k = 0; k < a.jacobians.size(); k++)
+        for (size_t i = 0; i < a.jacobians[k].size(); i++)
+            d = std::max(d, std::fabs(a.jacobians[k][i] - b.jacobians[k][i]));
+    return d / std::max(1.0, a.max_abs());
+}
+
+template <typename Factor>
+static void compare(const Factor & f, std::vector<double *> params, double tol)
+{
+    Evaluation ed(f), ef(f), ee(f);
+    ASSERT_TRUE(f.template evaluate<double>(params.data(), ed.residuals.data(), ed.jacobian_ptrs.data()));
+    ASSERT_TRUE(f.template evaluate<float>(params.data(), ef.residuals.data(), ef.jacobian_ptrs.data()));
+    ASSERT_TRUE(f.Evaluate(params.data(), ee.residuals.data(), ee.jacobian_ptrs.data()));
+
+    double diff = max_relative_diff(ed, ef);
+    std::cout << "float vs double max relative difference " << diff << std::endl;
+    ::testing::Test::RecordProperty("max_relative_diff", std::to_string(diff));
+    EXPECT_LT(diff, tol);
+    const Evaluation & expected = std::is_same<FactorScalar, float>::value ? ef : ed;
+    EXPECT_EQ(max_relative_diff(expected, ee), 0.0) << "Evaluate() does not use FactorScalar";
+    //The residual stays meaningful, not only small relative to the jacobians
+    for (size_t i = 0; i < ed.residuals.size(); i++)
+        EXPECT_NEAR(ed.residuals[i], ef.residuals[i], 1e-3);
+}
+
+class FloatFactorTest : public ::testing::Test
+{
+  protected:
+    //Two nearby poses 300 m from the origin, the camera sees the point about 5 m ahead
+    double pose_i[7] = {300.1, 200.2, 10.3, 0.01, 0.02, 0.03, 0.9993};
+    double pose_j[7] = {300.3, 200.1, 10.35, 0.011, 0.021, 0.03, 0.9993};
+    double ex0[7] = {0.05, 0.01, 0.02, 0.5, -0.5, 0.5, 0.5};
+    double ex1[7] = {0.05, -0.11, 0.02, 0.5, -0.5, 0.5, 0.5};
+    double inv_dep[1] = {0.2};
+    double td[1] = {0.0015};
+
+    Eigen::Vector3d pts_i{0.1, 0.2, 1}, pts_j{0.12, 0.18, 1};
+    Eigen::Vector3d vel_i{0.01, 0.02, 0}, vel_j{0.012, 0.018, 0};
+
+    void SetUp() override
+    {
+        for (double * q : {pose_i + 3, pose_j + 3, ex0 + 3, ex1 + 3}) {
+            Eigen::Map<Eigen::Vector4d>(q).normalize();
+        }
+        ProjectionTwoFrameOneCamFactor::sqrt_info = FOCAL / 1.5 * Eigen::Matrix2d::Identity();
+        ProjectionTwoFrameTwoCamFactor::sqrt_info = FOCAL / 1.5 * Eigen::Matrix2d::Identity();
+        ProjectionOneFrameTwoCamFactor::sqrt_info = FOCAL / 1.5 * Eigen::Matrix2d::Identity();
+    }
+};
+
+TEST_F(FloatFactorTest, TwoFrameOneCam)
+{
+    ProjectionTwoFrameOneCamFactor f(pts_i, pts_j, vel_i, vel_j, 0.001, 0.002);
+    compare(f, {pose_i, pose_j, ex0, inv_dep, td}, 1e-5);
+}
+
+TEST_F(FloatFactorTest, TwoFrameTwoCam)
+{
+    ProjectionTwoFrameTwoCamFactor f(pts_i, pts_j, vel_i, vel_j, 0.001, 0.002);
+    compare(f, {pose_i, pose_j, ex0, ex1, inv_dep, td}, 1e-5);
+}
+
+TEST_F(FloatFactorTest, OneFrameTwoCam)
+{
+    ProjectionOneFrameTwoCamFactor f(pts_i, pts_j, vel_i, vel_j, 0.001, 0.002);
+    compare(f, {ex0, ex1, inv_dep, td}, 1e-5);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,314 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <future>
+#include <iostream>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include "../src/factor/marginalization_factor.h"
+#include "../src/factor/projectionTwoFrameOneCamFactor.h"
+
+//Priors from MarginalizationInfo on a synthetic window: three poses, the oldest one and the
+//landmarks first seen in it are marginalized, as in Estimator::optimization with MARGIN_OLD.
+//Built twice, the test_marginalization_float target checks the WITH_FLOAT_FACTORS prior.
+
+static const int POSES = 3;
+static const int LANDMARKS = 30;
+
+//Stiff 6 dof constraint on one pose or between two, standing in for the IMU and old prior factors
+template <int BLOCKS>
+class PoseConstraint;
+
+template <>
+class PoseConstraint<1> : public ceres::SizedCostFunction<6, 7>
+{
+  public:
+    PoseConstraint(const double *_pose0, double _weight): weight(_weight)
+    {
+        std::copy(_pose0, _pose0 + 7, pose0);
+    }
+
+    virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+    {
+        Eigen::Map<Eigen::Matrix<double, 6, 1>> r(residuals);
+        r.head<3>() = weight * (Eigen::Map<const Eigen::Vector3d>(parameters[0]) - Eigen::Map<const Eigen::Vector3d>(pose0));
+        r.tail<3>() = weight * 2 * (Eigen::Map<const Eigen::Quaterniond>(pose0 + 3).inverse() * Eigen::Map<const Eigen::Quaterniond>(parameters[0] + 3)).vec();
+        if (jacobians && jacobians[0])
+        {
+            Eigen::Map<Eigen::Matrix<double, 6, 7, Eigen::RowMajor>> j(jacobians[0]);
+            j.setZero();
+            j.leftCols<6>() = weight * Eigen::Matrix<double, 6, 6>::Identity();
+        }
+        return true;
+    }
+
+    double pose0[7];
+    double weight;
+};
+
+template <>
+class PoseConstraint<2> : public ceres::SizedCostFunction<6, 7, 7>
+{
+  public:
+    PoseConstraint(double _weight): weight(_weight) {}
+
+    virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+    {
+        Eigen::Map<Eigen::Matrix<double, 6, 1>> r(residuals);
+        r.head<3>() = weight * (Eigen::Map<const Eigen::Vector3d>(parameters[1]) - Eigen::Map<const Eigen::Vector3d>(parameters[0]));
+        r.tail<3>() = weight * 2 * (Eigen::Map<const Eigen::Quaterniond>(parameters[0] + 3).inverse() * Eigen::Map<const Eigen::Quaterniond>(parameters[1] + 3)).vec();
+        for (int k = 0; jacobians && k < 2; k++)
+        {
+            if (!jacobians[k])
+                continue;
+            Eigen::Map<Eigen::Matrix<double, 6, 7, Eigen::RowMajor>> j(jacobians[k]);
+            j.setZero();
+            j.leftCols<6>() = (k == 0 ? -weight : weight) * Eigen::Matrix<double, 6, 6>::Identity();
+        }
+        return true;
+    }
+
+    double weight;
+};
+
+//Fixed jacobians and residual on any blocks, for random linear systems
+class LinearFactor : public ceres::CostFunction
+{
+  public:
+    LinearFactor(const std::vector<Eigen::MatrixXd> &_jacobians, const Eigen::VectorXd &_residual):
+        jacobians(_jacobians), residual(_residual)
+    {
+        for (auto &j : jacobians)
+            mutable_parameter_block_sizes()->push_back(j.cols());
+        set_num_residuals(residual.size());
+    }
+
+    virtual bool Evaluate(double const *const *parameters, double *residuals, double **_jacobians) const
+    {
+        Eigen::Map<Eigen::VectorXd>(residuals, residual.size()) = residual;
+        for (int k = 0; _jacobians && k < (int)jacobians.size(); k++)
+        {
+            if (_jacobians[k])
+                Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(_jacobians[k], residual.size(), jacobians[k].cols()) = jacobians[k];
+        }
+        return true;
+    }
+
+    std::vector<Eigen::MatrixXd> jacobians;
+    Eigen::VectorXd residual;
+};
+
+//Schur complement of the normal equation of the evaluated factors in double, in the block order marginalize() chose
+static void schurComplement(const MarginalizationInfo &info, Eigen::MatrixXd &S, Eigen::VectorXd &s)
+{
+    int pos = info.m + info.n;
+    Eigen::MatrixXd A = Eigen::MatrixXd::Zero(pos, pos);
+    Eigen::VectorXd b = Eigen::VectorXd::Zero(pos);
+    for (auto it : info.factors)
+    {
+        Eigen::MatrixXd J = Eigen::MatrixXd::Zero(it->residuals.size(), pos);
+        for (int i = 0; i < (int)it->parameter_blocks.size(); i++)
+        {
+            long addr = reinterpret_cast<long>(it->parameter_blocks[i]);
+            int size = info.localSize(info.parameter_block_size.at(addr));
+            J.middleCols(info.parameter_block_idx.at(addr), size) += it->jacobians[i].leftCols(size);
+        }
+        A += J.transpose() * J;
+        b += J.transpose() * it->residuals;
+    }
+    int m = info.m, n = info.n;
+    Eigen::LDLT<Eigen::MatrixXd> Amm(A.topLeftCorner(m, m));
+    S = A.bottomRightCorner(n, n) - A.bottomLeftCorner(n, m) * Amm.solve(A.topRightCorner(m, n));
+    s = b.tail(n) - A.bottomLeftCorner(n, m) * Amm.solve(b.head(m));
+}
+
+//J^T J and J^T r of the prior against the double Schur complement. With WITH_FLOAT_FACTORS
+//only the jacobian products are float, so the prior stays within float rounding of double.
+static void expectMatchesSchur(const MarginalizationInfo &info, const char *name)
+{
+    Eigen::MatrixXd S;
+    Eigen::VectorXd s;
+    schurComplement(info, S, s);
+
+    const Eigen::MatrixXd &J = info.linearized_jacobians;
+    const Eigen::VectorXd &r = info.linearized_residuals;
+    double err_S = (J.transpose() * J - S).norm() / S.norm();
+    double err_s = (J.transpose() * r - s).norm() / s.norm();
+    std::cout << name << (info.sqrt_marginalization ? " sqrt" : " eigen") << " prior vs Schur complement: relative error "
+              << err_S << " (J^T J) " << err_s << " (J^T r)" << std::endl;
+    double tol = std::is_same<FactorScalar, float>::value ? 1e-6 : 1e-12;
+    EXPECT_LT(err_S, tol);
+    EXPECT_LT(err_s, tol);
+}
+
+struct Window
+{
+    double pose[POSES][7];
+    double ex[7] = {0.05, 0.01, 0.02, 0, 0, 0, 1};
+    double td[1] = {0.001};
+    double inv_dep[LANDMARKS][1];
+    ceres::LossFunction *loss_function = new ceres::HuberLoss(1.0);
+
+    Window()
+    {
+        ProjectionTwoFrameOneCamFactor::sqrt_info = 460.0 / 1.5 * Eigen::Matrix2d::Identity();
+        for (int i = 0; i < POSES; i++)
+        {
+            double p[7] = {300 + 0.2 * i, 200 - 0.1 * i, 10 + 0.05 * i, 0.01 * i, 0.02, 0.03, 1};
+            Eigen::Map<Eigen::Quaterniond>(p + 3).normalize();
+            std::copy(p, p + 7, pose[i]);
+        }
+    }
+
+    ~Window()
+    {
+        delete loss_function;
+    }
+
+    //Projection factors of every landmark from pose 0 to the newer poses, a prior and an IMU like factor on pose 0
+    MarginalizationInfo *build(bool sqrt_marginalization)
+    {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<double> uv(-0.5, 0.5), dep(2, 20), noise(-2e-3, 2e-3);
+        MarginalizationInfo *info = new MarginalizationInfo();
+        info->sqrt_marginalization = sqrt_marginalization;
+        info->addResidualBlockInfo(new ResidualBlockInfo(new PoseConstraint<1>(pose[0], 1e3), NULL,
+            std::vector<double *>{pose[0]}, std::vector<int>{0}));
+        info->addResidualBlockInfo(new ResidualBlockInfo(new PoseConstraint<2>(1e4), NULL,
+            std::vector<double *>{pose[0], pose[1]}, std::vector<int>{0}));
+        for (int k = 0; k < LANDMARKS; k++)
+        {
+            Eigen::Vector3d pts_i(uv(rng), uv(rng), 1);
+            inv_dep[k][0] = 1 / dep(rng);
+            for (int j = 1; j < POSES; j++)
+            {
+                Eigen::Vector3d pts_j(pts_i.x() + noise(rng) + 0.01 * j, pts_i.y() + noise(rng), 1);
+                auto f = new ProjectionTwoFrameOneCamFactor(pts_i, pts_j, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), 0, 0);
+                info->addResidualBlockInfo(new ResidualBlockInfo(f, loss_function,
+                    std::vector<double *>{pose[0], pose[j], ex, inv_dep[k], td}, std::vector<int>{0, 3}));
+            }
+        }
+        info->preMarginalize();
+        return info;
+    }
+
+    //Kept blocks move one slot down, as slideWindow does
+    std::unordered_map<long, double *> addrShift()
+    {
+        std::unordered_map<long, double *> addr_shift;
+        for (int i = 1; i < POSES; i++)
+            addr_shift[reinterpret_cast<long>(pose[i])] = pose[i - 1];
+        addr_shift[reinterpret_cast<long>(ex)] = ex;
+        addr_shift[reinterpret_cast<long>(td)] = td;
+        return addr_shift;
+    }
+};
+
+class MarginalizationTest : public ::testing::TestWithParam<bool>
+{
+};
+
+//The prior computed by the async job equals the synchronous one bit for bit
+TEST_P(MarginalizationTest, AsyncPriorMatchesSync)
+{
+    Window w;
+    MarginalizationInfo *info = w.build(GetParam());
+    MarginalizationInfo *sync_info = info->shareLinearization();
+
+    auto sync_shift = w.addrShift();
+    std::vector<double *> sync_blocks = sync_info->computePrior(sync_shift);
+
+    std::vector<double *> async_blocks;
+    auto job = std::async(std::launch::async, [&w, info, &async_blocks]() {
+        auto addr_shift = w.addrShift();
+        async_blocks = info->computePrior(addr_shift);
+    });
+    job.get();
+
+    ASSERT_TRUE(info->valid);
+    EXPECT_EQ(info->n, 2 * 6 + 6 + 1);
+    EXPECT_EQ(async_blocks, sync_blocks);
+    EXPECT_TRUE(info->samePrior(*sync_info));
+
+    delete sync_info;
+    delete info;
+}
+
+//Both priors reproduce the Schur complement, J^T J and J^T r of the prior, on random systems
+//with more rows than one QR batch
+TEST_P(MarginalizationTest, PriorMatchesSchurComplement)
+{
+    std::mt19937 rng(3);
+    std::normal_distribution<double> gauss(0, 1);
+    std::uniform_int_distribution<int> pick(0, 1 << 30);
+
+    //Marginalized: 2 poses, 10 inverse depths, 1 speed bias. Kept: 3 poses, 1 speed bias, an extrinsic and td.
+    std::vector<int> sizes = {7, 7, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 9, 7, 7, 7, 9, 7, 1};
+    const int marginalized = 13;
+    std::vector<std::vector<double>> blocks;
+    for (int size : sizes)
+        blocks.emplace_back(size, 0.0);
+
+    auto random_factor = [&](const std::vector<int> &ids, int rows, double scale) {
+        std::vector<Eigen::MatrixXd> jacobians;
+        std::vector<double *> params;
+        for (int id : ids)
+        {
+            jacobians.push_back(scale * Eigen::MatrixXd::NullaryExpr(rows, sizes[id], [&]() { return gauss(rng); }));
+            params.push_back(blocks[id].data());
+        }
+        Eigen::VectorXd residual = scale * Eigen::VectorXd::NullaryExpr(rows, [&]() { return gauss(rng); });
+        std::vector<int> drop_set;
+        for (int i = 0; i < (int)ids.size(); i++)
+        {
+            if (ids[i] < marginalized)
+                drop_set.push_back(i);
+        }
+        return new ResidualBlockInfo(new LinearFactor(jacobians, residual), NULL, params, drop_set);
+    };
+
+    MarginalizationInfo *info = new MarginalizationInfo();
+    info->sqrt_marginalization = GetParam();
+    //Every marginalized block is observed on its own, so Amm is well conditioned
+    for (int id = 0; id < marginalized; id++)
+        info->addResidualBlockInfo(random_factor({id}, 12, 10));
+    for (int k = 0; k < 200; k++)
+    {
+        std::vector<int> ids;
+        int cnt = 2 + pick(rng) % 3;
+        while ((int)ids.size() < cnt)
+        {
+            int id = pick(rng) % sizes.size();
+            if (std::find(ids.begin(), ids.end(), id) == ids.end())
+                ids.push_back(id);
+        }
+        info->addResidualBlockInfo(random_factor(ids, 2 + pick(rng) % 14, 1));
+    }
+    info->preMarginalize();
+    info->marginalize();
+
+    ASSERT_TRUE(info->valid);
+    ASSERT_EQ(info->n, 3 * 6 + 9 + 6 + 1);
+    expectMatchesSchur(*info, "random");
+
+    delete info;
+}
+
+//Same on the window, where the IMU like factor has 1e8 information and the projection factors about 1e5
+TEST_P(MarginalizationTest, WindowPriorMatchesSchurComplement)
+{
+    Window w;
+    MarginalizationInfo *info = w.build(GetParam());
+    info->marginalize();
+    ASSERT_TRUE(info->valid);
+    expectMatchesSchur(*info, "window");
+    delete info;
+}
+
+INSTANTIATE_TEST_CASE_P(EigenAndSqrt, MarginalizationTest, ::testing::Values(false, true));
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <iostream>
+#include "../src/initial/solve_5pts.h"
+
+//Relative pose from synthetic bearings: 150 correspondences, 20% outliers, small noise.
+//Wide bearings all around the camera as seen by a fisheye, and pinhole style normalized points.
+
+static const int TRIALS = 100;
+static const int POINTS = 150;
+
+struct Errors
+{
+    int solved = 0;
+    double max_rot = 0, max_dir = 0;
+};
+
+static Errors run(bool wide)
+{
+    std::mt19937 rng(wide ? 1 : 2);
+    std::normal_distribution<double> noise(0, 2e-4);
+    std::uniform_real_distribution<double> uni(-1, 1);
+    auto rand_vec = [&]() { return Vector3d(uni(rng), uni(rng), uni(rng)); };
+
+    MotionEstimator estimator;
+    Errors err;
+    for (int trial = 0; trial < TRIALS; trial++)
+    {
+        Matrix3d R = AngleAxisd(0.3 * uni(rng), rand_vec().normalized()).toRotationMatrix();
+        Vector3d t = rand_vec().normalized() * 0.3;
+
+        vector<pair<Vector3d, Vector3d>> corres;
+        while ((int)corres.size() < POINTS)
+        {
+            Vector3d P(5 * uni(rng), 5 * uni(rng), 2 * uni(rng) + (wide ? 0 : 4));
+            Vector3d P2 = R * P + t;
+            if (P.norm() < 1 || (!wide && (P.z() < 0.5 || P2.z() < 0.5)))
+                continue;
+            Vector3d b1 = (P.normalized() + Vector3d(noise(rng), noise(rng), noise(rng))).normalized();
+            Vector3d b2 = (P2.normalized() + Vector3d(noise(rng), noise(rng), noise(rng))).normalized();
+            if (corres.size() % 5 == 0)
+                b2 = rand_vec().normalized();
+            if (!wide)
+            {
+                if (b1.z() < 0.1 || b2.z() < 0.1)
+                    continue;
+                b1 /= b1.z();
+                b2 /= b2.z();
+            }
+            corres.push_back(make_pair(b1, b2));
+        }
+
+        Matrix3d R_est;
+        Vector3d T_est;
+        if (!estimator.solveRelativeRT(corres, R_est, T_est))
+            continue;
+        err.solved++;
+        //solveRelativeRT returns the pose of the second frame in the first one
+        Matrix3d R_exp = R.transpose();
+        Vector3d T_exp = (-R.transpose() * t).normalized();
+        err.max_rot = std::max(err.max_rot, AngleAxisd(R_est * R_exp.transpose()).angle());
+        err.max_dir = std::max(err.max_dir, std::acos(std::min(1.0, T_est.normalized().dot(T_exp))));
+    }
+    std::cout << (wide ? "wide" : "pinhole") << " solved " << err.solved << "/" << TRIALS
+              << " max rotation error " << err.max_rot << " rad, max translation direction error "
+              << err.max_dir << " rad" << std::endl;
+    return err;
+}
+
+TEST(SolveFivePoints, WideBearingsWithOutliers)
+{
+    Errors err = run(true);
+    EXPECT_GE(err.solved, TRIALS * 98 / 100);
+    EXPECT_LT(err.max_rot, 5e-3);
+    EXPECT_LT(err.max_dir, 5e-2);
+}
+
+TEST(SolveFivePoints, NormalizedPointsWithOutliers)
+{
+    Errors err = run(false);
+    EXPECT_GE(err.solved, TRIALS * 98 / 100);
+    EXPECT_LT(err.max_rot, 5e-3);
+    EXPECT_LT(err.max_dir, 5e-2);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}